@@ -1,7 +1,9 @@
 #include "ECG.h"
 #include "Geometry/Mesh.h"
 #include "Geometry/Tet.h"
+#include "Lines/Termination.h"
 #include "Others/Utilities.h"
+#include "FileLoader/ProductCache.h"
 #include <set>
 
 ECG_EDGE::ECG_EDGE()
@@ -133,7 +135,7 @@ vector<vector<StreamLine*>> ECG::placing_random_seeds(Mesh* mesh, UL num_of_seed
 
     const double dist = 1e-5; // all randomly points are within dist to the singularity
     const double divider = 1./dist;
-    srand((unsigned)time(nullptr));
+    srand(rng_seed);
 
     // for each singularity
     for(ECG_NODE* node : this->nodes){
@@ -158,7 +160,7 @@ vector<vector<StreamLine*>> ECG::placing_random_seeds(Mesh* mesh, UL num_of_seed
                 Tet* new_cords_tet = mesh->inWhichTet(new_cords, sing_tet, ds); // find the corresponding tet
                 if(new_cords_tet == nullptr) continue;
                 // interpolate this coordinate and obtain a vertex
-                Vertex* new_vert = new_cords_tet->get_vert_at(new_cords, t, ds, false, true);
+                Vertex* new_vert = new_cords_tet->get_vert_at(new_cords, t, &mesh->field_store, ds, false, true);
                 // build the new streamline
                 StreamLine* sl = new StreamLine(new_vert, t);
                 sls.push_back(sl);
@@ -189,8 +191,12 @@ void ECG::build_ECG_NODES()
 // given the streamline seeds, we trace them,
 // at any time, if we see a streamline is really close to another singulairty while tracing,
 // we constrcuct an directed edge between two ECG nodes and stop tracing
+// otherwise the half stops like any streamline, see Lines/Termination.h. the seeds sit next to a singularity,
+// so the stagnation test starts after the first step
 void ECG::build_ECG_EDGES(Mesh *mesh, vector< vector<StreamLine *> > sls_for_all_sings)
 {
+    const double min_speed = stagnation_speed(mesh, this->t);
+    TerminationStats stats;
     for(UL i = 0; i < sls_for_all_sings.size(); i ++){
         // get the reference to the node and streamlines near it
         ECG_NODE* node = this->nodes[i];
@@ -203,17 +209,27 @@ void ECG::build_ECG_EDGES(Mesh *mesh, vector< vector<StreamLine *> > sls_for_all
             // forward tracing
             {
                 const Vertex* vert = sl->seed;
-                for(UI j = 0; j < max_num_steps; j++){
+                StreamlineTermination term(min_speed);
+                TerminationReason reason = TERM_MAX_STEPS;
+                UI j = 0;
+                for(; j < max_num_steps; j++){
+                    if(j > 0 && term.is_stagnant(length(vert->vels.at(t)))){
+                        reason = TERM_STAGNATION;
+                        break;
+                    }
                     Tet* tet = vert->tets[0];
                     Vector3d cords = vert->cords;
                     Vector3d newCords = trace_one_dist_step(cords, vert->vels.at(t)); // trace 1 time step
                     double ds[4]; // saving barycentric coordinates
                     Tet* newTet = mesh->inWhichTet(newCords, tet, ds); // find the corresponding tet
                     if(newTet == nullptr) {
+                        reason = TERM_LEFT_DOMAIN;
                         break; // newTet is nullptr means we couldn't proceed
                     }
+                    reason = term.after_step(newTet->idx, dist_step_size);
+                    if(reason == TERM_CYCLE) break;
                     // interpolate at newCords at time t
-                    Vertex* newVert = newTet->get_vert_at(newCords, t, ds); // interpolate new cords in the tet
+                    Vertex* newVert = newTet->get_vert_at(newCords, t, &mesh->field_store, ds); // interpolate new cords in the tet
                     if(newVert == nullptr) Utility::throwErrorMessage("ECG::build_ECG_EDGES: newVert is nullptr!");
 
                     newVert->add_tet(newTet);
@@ -234,9 +250,13 @@ void ECG::build_ECG_EDGES(Mesh *mesh, vector< vector<StreamLine *> > sls_for_all
                         this->add_edge(edge);
                         this->add_sl(sl);
                         found = true;
+                        reason = TERM_CONNECTED;
                         break; // stop tracing
                     }
+                    if(reason == TERM_ARC_LENGTH) break;
+                    reason = TERM_MAX_STEPS;
                 }
+                stats.add(reason, j);
             }
 
             if(found == false && show_ECG_connections){
@@ -247,7 +267,14 @@ void ECG::build_ECG_EDGES(Mesh *mesh, vector< vector<StreamLine *> > sls_for_all
             // backward tracing
             {
                 Vertex* vert = sl->seed;
-                for(UI j = 0; j < max_num_steps; j++){
+                StreamlineTermination term(min_speed);
+                TerminationReason reason = TERM_MAX_STEPS;
+                UI j = 0;
+                for(; j < max_num_steps; j++){
+                    if(j > 0 && term.is_stagnant(length(vert->vels.at(t)))){
+                        reason = TERM_STAGNATION;
+                        break;
+                    }
                     Tet* tet = vert->tets[0];
                     Vector3d vel = Vector3d( vert->vels.at(t) ) * (- 1.); // -1 means backward
                     Vector3d cords = vert->cords;
@@ -255,10 +282,13 @@ void ECG::build_ECG_EDGES(Mesh *mesh, vector< vector<StreamLine *> > sls_for_all
                     double ws[4]; // saving barycentric coordinates
                     Tet* newTet = mesh->inWhichTet(newCords, tet, ws); // find the corresponding tet
                     if(newTet == nullptr) {
+                        reason = TERM_LEFT_DOMAIN;
                         break; // newTet is nullptr means we couldn't proceed
                     }
+                    reason = term.after_step(newTet->idx, dist_step_size);
+                    if(reason == TERM_CYCLE) break;
                     // interpolate at newCords at time t
-                    Vertex* newVert = newTet->get_vert_at(newCords, t, ws); // interpolate new cords in the tet
+                    Vertex* newVert = newTet->get_vert_at(newCords, t, &mesh->field_store, ws); // interpolate new cords in the tet
                     if(newVert == nullptr) Utility::throwErrorMessage("ECG::build_ECG_EDGES: newVert is nullptr!");
 
                     newVert->add_tet(newTet);
@@ -282,9 +312,13 @@ void ECG::build_ECG_EDGES(Mesh *mesh, vector< vector<StreamLine *> > sls_for_all
                             this->add_sl(sl);
                         }
                         found = true;
+                        reason = TERM_CONNECTED;
                         break; // stop tracing
                     }
+                    if(reason == TERM_ARC_LENGTH) break;
+                    reason = TERM_MAX_STEPS;
                 }
+                stats.add(reason, j);
             }
 
             // if found
@@ -358,7 +392,10 @@ void build_ECGs(vector<Mesh *> meshes)
     for(UI i = 0; i < meshes.size(); i++){
         Mesh* mesh = meshes[i];
         qDebug() << "Building ECG for mesh" << i;
-        mesh->build_ECG_for_all_t();
+        if(!load_cached_ECGs(mesh)){
+            mesh->build_ECG_for_all_t();
+            save_cached_ECGs(mesh);
+        }
         qDebug() << "Building ECG for mesh" << i << "done";
     }
 }
@@ -90,9 +90,9 @@ public:
     UL num_sings() const;
     UL num_sls() const;
 
-    vector<Singularity*> get_sings();
-    vector<ECG_NODE*> get_nodes();
-    vector<ECG_EDGE*> get_edges();
+    vector<Singularity*> get_sings() const;
+    vector<ECG_NODE*> get_nodes() const;
+    vector<ECG_EDGE*> get_edges() const;
 
     void add_sing(Singularity* );
     void add_node(ECG_NODE* );
@@ -131,17 +131,17 @@ inline unsigned long ECG::num_sls() const
     return this->sls.size();
 }
 
-inline vector<Singularity *> ECG::get_sings()
+inline vector<Singularity *> ECG::get_sings() const
 {
     return this->sings;
 }
 
-inline vector<ECG_NODE *> ECG::get_nodes()
+inline vector<ECG_NODE *> ECG::get_nodes() const
 {
     return this->nodes;
 }
 
-inline vector<ECG_EDGE *> ECG::get_edges()
+inline vector<ECG_EDGE *> ECG::get_edges() const
 {
     return this->edges;
 }
@@ -0,0 +1,249 @@
+#include "Analysis/FTLE.h"
+#include "Lines/FlowSampler.h"
+#include "Others/Utilities.h"
+#include "Others/Parallel.h"
+#include <float.h>
+#include <QElapsedTimer>
+
+FTLEParams default_ftle_params(const double time)
+{
+    FTLEParams params;
+    params.time = time;
+    params.duration = ftle_integration_time;
+    params.step = pathline_time_step;
+    params.on_mesh_verts = ftle_on_mesh_verts;
+    params.grid_res = ftle_grid_res;
+    return params;
+}
+
+
+FTLEGrid::FTLEGrid()
+{
+    this->res[0] = this->res[1] = this->res[2] = 0;
+    this->spacing = 0.;
+}
+
+
+FTLEGrid::~FTLEGrid()
+{
+    this->ftle.clear();
+    this->valid.clear();
+}
+
+
+// trilinear interpolation over the valid corners of the cell around p
+double FTLEGrid::value_at(const Vector3d& p) const
+{
+    if(this->num_samples() == 0 || this->spacing <= 0.) return 0.;
+
+    UI base[3];
+    double frac[3];
+    for(unsigned char d = 0; d < 3; d++){
+        double x = (p.entry[d] - this->origin.entry[d]) / this->spacing;
+        if(x < 0.) x = 0.;
+        if(x > this->res[d] - 1.) x = this->res[d] - 1.;
+        base[d] = (UI) x;
+        if(base[d] + 1 >= this->res[d]) base[d] = this->res[d] > 1 ? this->res[d] - 2 : 0;
+        frac[d] = this->res[d] > 1 ? x - base[d] : 0.;
+    }
+
+    double sum = 0., weight = 0.;
+    for(unsigned char c = 0; c < 8; c++){
+        const UI i = base[0] + (c & 1), j = base[1] + ((c >> 1) & 1), k = base[2] + ((c >> 2) & 1);
+        if(i >= this->res[0] || j >= this->res[1] || k >= this->res[2]) continue;
+        const UL n = this->idx(i, j, k);
+        if(!this->valid[n]) continue;
+        const double w = ((c & 1) ? frac[0] : 1. - frac[0]) * (((c >> 1) & 1) ? frac[1] : 1. - frac[1])
+                       * (((c >> 2) & 1) ? frac[2] : 1. - frac[2]);
+        sum += w * this->ftle[n];
+        weight += w;
+    }
+    return weight > 0. ? sum / weight : 0.;
+}
+
+
+// FTLE from the flow map gradient F: log of the largest stretching, ln(sqrt(lambda_max(F^T F))) / |T|
+double ftle_of(const double F[9], const double duration)
+{
+    if(duration == 0.) return 0.;
+    // C = F^T F, upper triangle
+    double C[6];
+    const unsigned char rows[6] = {0, 0, 0, 1, 1, 2};
+    const unsigned char cols[6] = {0, 1, 2, 1, 2, 2};
+    for(unsigned char n = 0; n < 6; n++){
+        const unsigned char i = rows[n], j = cols[n];
+        C[n] = F[i]*F[j] + F[3 + i]*F[3 + j] + F[6 + i]*F[6 + j];
+    }
+    double eig[3];
+    sym3x3_eigenvalues(C, eig);
+    if(eig[2] <= 0.) return 0.;
+    return log(eig[2]) / (2. * fabs(duration));
+}
+
+
+// advect every sample from params.time for params.duration in parallel batches and compute the FTLE
+// the result is always written to vert_ftle (one value per mesh vertex). If grid is not null and
+// the samples are on a regular grid, the grid values are kept there as well.
+// return false if the run was cancelled by progress, vert_ftle is left untouched then.
+bool compute_ftle(Mesh* mesh, const FTLEParams& params, vector<double>& vert_ftle, FTLEGrid* grid, FTLEProgress progress)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const FlowSampler sampler(mesh);
+    const UL num_verts = mesh->num_verts();
+
+    // the integration is cut where the data ends
+    double end_time = params.time + params.duration;
+    if(end_time > sampler.t_max()) end_time = sampler.t_max();
+    if(end_time < sampler.t_min()) end_time = sampler.t_min();
+    const double duration = end_time - params.time;
+    const FrameHandle frames = mesh->field_store.pin_range(mesh, params.time, end_time);
+    UL num_steps = (UL) ceil(fabs(duration) / params.step);
+    if(num_steps == 0) num_steps = 1;
+    const double dt = duration / num_steps;
+
+    // step 1: sample positions and their containing tets
+    FTLEGrid local_grid;
+    FTLEGrid& g = grid != nullptr ? *grid : local_grid;
+    vector<double> pos;
+    vector<long> tets;
+    if(params.on_mesh_verts){
+        pos.resize(3 * num_verts);
+        tets.resize(num_verts);
+        for(UL i = 0; i < num_verts; i++){
+            const Vertex* v = mesh->verts[i];
+            for(unsigned char d = 0; d < 3; d++) pos[3*i + d] = v->cords.entry[d];
+            tets[i] = v->num_tets() > 0 ? (long) v->tets[0]->idx : -1;
+        }
+    }
+    else{
+        Vector3d min(DBL_MAX), max(-DBL_MAX);
+        for(const Vertex* v : mesh->verts){
+            for(unsigned char d = 0; d < 3; d++){
+                if(v->cords.entry[d] < min.entry[d]) min.entry[d] = v->cords.entry[d];
+                if(v->cords.entry[d] > max.entry[d]) max.entry[d] = v->cords.entry[d];
+            }
+        }
+        const Vector3d extent = max - min;
+        double longest = extent.x();
+        if(extent.y() > longest) longest = extent.y();
+        if(extent.z() > longest) longest = extent.z();
+        const UI res = params.grid_res < 2 ? 2 : params.grid_res;
+        g.spacing = longest / (res - 1);
+        g.origin = min;
+        for(unsigned char d = 0; d < 3; d++) g.res[d] = (UI) (extent.entry[d] / g.spacing) + 1;
+
+        const UL n = g.num_samples();
+        pos.resize(3 * n);
+        tets.assign(n, -1);
+        // locate in scanline order, each sample starts walking from the last located one
+        Utility::parallel_for(0, n, [&](const UL begin, const UL end){
+            long last = 0;
+            double bary[4];
+            for(UL s = begin; s < end; s++){
+                const UI i = s % g.res[0], j = (s / g.res[0]) % g.res[1], k = s / ((UL) g.res[0] * g.res[1]);
+                double* p = pos.data() + 3*s;
+                p[0] = min.x() + i * g.spacing;
+                p[1] = min.y() + j * g.spacing;
+                p[2] = min.z() + k * g.spacing;
+                long tet = last;
+                if(sampler.locate(p, tet, bary)){
+                    tets[s] = tet;
+                    last = tet;
+                }
+            }
+        });
+    }
+
+    // step 2: advect in batches, progress is reported and cancellation checked between them
+    // each thread runs its particles through the batched kernel, all steps at once
+    const UL num_samples = tets.size();
+    ParticleBatch particles;
+    particles.resize(num_samples);
+    for(UL s = 0; s < num_samples; s++) particles.set(s, pos.data() + 3*s, tets[s]);
+    const UL batch_size = 16384;
+    for(UL batch = 0; batch < num_samples; batch += batch_size){
+        const UL batch_end = batch + batch_size < num_samples ? batch + batch_size : num_samples;
+        Utility::parallel_for(batch, batch_end, [&](const UL begin, const UL end){
+            sampler.rk4_batch(particles, begin, end, params.time, dt, num_steps);
+        }, 64);
+
+        if(progress && !progress((double) batch_end / num_samples)){
+            qDebug() << "FTLE: cancelled at" << batch_end << "of" << num_samples << "samples";
+            return false;
+        }
+    }
+    vector<double> final_pos(3 * num_samples);
+    vector<char> valid(num_samples, 0);
+    for(UL s = 0; s < num_samples; s++){
+        final_pos[3*s] = particles.x[s];
+        final_pos[3*s + 1] = particles.y[s];
+        final_pos[3*s + 2] = particles.z[s];
+        valid[s] = particles.alive(s);
+    }
+
+    // step 3: flow map gradient and FTLE
+    vector<double> result(num_verts, 0.);
+    if(params.on_mesh_verts){
+        // constant gradient per tet, averaged over the tets whose 4 vertices all stayed inside
+        FieldStore& store = mesh->field_store;
+        const UL num_tets = mesh->num_tets();
+        vector<double> tet_F(9 * num_tets);
+        store.calc_tet_grads(final_pos.data(), tet_F.data());
+        Utility::parallel_for(0, num_verts, [&](const UL begin, const UL end){
+            for(UL i = begin; i < end; i++){
+                double F[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+                UL count = 0;
+                for(UL n = store.topology->vert_tet_starts[i]; n < store.topology->vert_tet_starts[i + 1]; n++){
+                    const UL t = store.topology->vert_tet_ids[n];
+                    const UL* tv = store.topology->tet_verts.data() + 4*t;
+                    if(!valid[tv[0]] || !valid[tv[1]] || !valid[tv[2]] || !valid[tv[3]]) continue;
+                    for(unsigned char k = 0; k < 9; k++) F[k] += tet_F[9*t + k];
+                    count++;
+                }
+                if(count == 0) continue;
+                for(unsigned char k = 0; k < 9; k++) F[k] /= count;
+                result[i] = ftle_of(F, duration);
+            }
+        });
+    }
+    else{
+        // central differences between grid neighbors, one sided where a neighbor is missing
+        g.ftle.assign(num_samples, 0.);
+        g.valid = valid;
+        Utility::parallel_for(0, num_samples, [&](const UL begin, const UL end){
+            for(UL s = begin; s < end; s++){
+                if(!valid[s]) continue;
+                const UI idx3[3] = {(UI) (s % g.res[0]), (UI) ((s / g.res[0]) % g.res[1]), (UI) (s / ((UL) g.res[0] * g.res[1]))};
+                double F[9];
+                bool ok = true;
+                for(unsigned char d = 0; d < 3 && ok; d++){
+                    UI lo[3] = {idx3[0], idx3[1], idx3[2]}, hi[3] = {idx3[0], idx3[1], idx3[2]};
+                    if(idx3[d] > 0) lo[d]--;
+                    if(idx3[d] + 1 < g.res[d]) hi[d]++;
+                    UL n_lo = g.idx(lo[0], lo[1], lo[2]), n_hi = g.idx(hi[0], hi[1], hi[2]);
+                    if(!valid[n_lo]) n_lo = s;
+                    if(!valid[n_hi]) n_hi = s;
+                    if(n_lo == n_hi){ ok = false; break; }
+                    const double dx = pos[3*n_hi + d] - pos[3*n_lo + d];
+                    for(unsigned char i = 0; i < 3; i++){
+                        F[i*3 + d] = (final_pos[3*n_hi + i] - final_pos[3*n_lo + i]) / dx;
+                    }
+                }
+                if(!ok){ g.valid[s] = 0; continue; }
+                g.ftle[s] = ftle_of(F, duration);
+            }
+        });
+        for(UL i = 0; i < num_verts; i++){
+            result[i] = g.value_at(mesh->verts[i]->cords);
+        }
+    }
+
+    vert_ftle.swap(result);
+    UL num_valid = 0;
+    for(const char v : valid) num_valid += v;
+    qDebug() << "FTLE: time" << params.time << "duration" << duration << "," << num_samples << "samples,"
+             << num_valid << "stayed inside, in" << timer.nsecsElapsed() / 1e9 << "secs";
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef FTLE_H
+#define FTLE_H
+
+#include <vector>
+#include <functional>
+#include "Others/Predefined.h"
+#include "Others/Vector3d.h"
+
+using namespace std;
+
+class Mesh;
+
+// how the flow map of an FTLE run is sampled
+struct FTLEParams{
+    double time;        // start time of the particles
+    double duration;    // integration time, negative for backward FTLE
+    double step;        // time advanced by each RK4 step
+    bool on_mesh_verts; // sample at the mesh vertices instead of a regular grid
+    UI grid_res;        // grid samples along the longest side of the bounding box
+};
+
+FTLEParams default_ftle_params(const double time);
+
+
+// FTLE sampled on a regular grid over the bounding box of the mesh
+class FTLEGrid{
+public:
+    UI res[3];
+    Vector3d origin;
+    double spacing;
+    vector<double> ftle; // x runs fastest
+    vector<char> valid;  // false if the sample is outside the mesh or left it too early
+
+    FTLEGrid();
+    ~FTLEGrid();
+
+    inline UL num_samples() const;
+    inline UL idx(const UI i, const UI j, const UI k) const;
+    double value_at(const Vector3d& p) const;
+};
+
+
+// called between batches with the fraction done, returning false cancels the run
+typedef function<bool(const double)> FTLEProgress;
+
+bool compute_ftle(Mesh* mesh, const FTLEParams& params, vector<double>& vert_ftle, FTLEGrid* grid, FTLEProgress progress);
+double ftle_of(const double F[9], const double duration);
+
+
+inline UL FTLEGrid::num_samples() const
+{
+    return (UL) this->res[0] * this->res[1] * this->res[2];
+}
+
+
+inline UL FTLEGrid::idx(const UI i, const UI j, const UI k) const
+{
+    return ((UL) k * this->res[1] + j) * this->res[0] + i;
+}
+
+#endif // FTLE_H
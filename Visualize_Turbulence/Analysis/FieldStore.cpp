@@ -0,0 +1,817 @@
+#include "Analysis/FieldStore.h"
+#include "Geometry/Topology.h"
+#include "Others/Utilities.h"
+#include "Others/Parallel.h"
+#include "FileLoader/FrameCache.h"
+#include "Analysis/QuantizedFrame.h"
+#include <QElapsedTimer>
+#include <algorithm>
+
+FrameFields::FrameFields()
+{
+    this->time = 0.;
+    this->loaded = false;
+    this->pins = 0;
+    this->last_use = 0;
+    this->packed = NULL;
+}
+
+
+FrameFields::~FrameFields()
+{
+    this->vels.clear();
+    this->vors.clear();
+    this->mus.clear();
+    this->tet_grads.clear();
+    this->vert_grads.clear();
+    this->tet_vors.clear();
+    for(unsigned char i = 0; i < NUM_SCALAR_FIELDS; i++){
+        this->vert_vals[i].clear();
+        this->tet_vals[i].clear();
+    }
+    this->drop_packed();
+}
+
+
+// heap bytes of all arrays
+UL FrameFields::num_bytes() const
+{
+    UL n = this->vels.capacity() + this->vors.capacity() + this->mus.capacity();
+    n += this->tet_grads.capacity() + this->vert_grads.capacity() + this->tet_vors.capacity();
+    for(unsigned char i = 0; i < NUM_SCALAR_FIELDS; i++){
+        n += this->vert_vals[i].capacity() + this->tet_vals[i].capacity();
+    }
+    return n * sizeof(double) + (this->packed != NULL ? this->packed->num_bytes() : 0);
+}
+
+
+// free the raw data and everything derived from it, FTLE is kept since it needs many frames to be computed again
+// and the packed copy since it is what a released frame is loaded from again
+void FrameFields::release()
+{
+    vector<double>().swap(this->vels);
+    vector<double>().swap(this->vors);
+    vector<double>().swap(this->mus);
+    vector<double>().swap(this->tet_grads);
+    vector<double>().swap(this->vert_grads);
+    vector<double>().swap(this->tet_vors);
+    for(unsigned char i = 0; i < NUM_SCALAR_FIELDS; i++){
+        if(i != FIELD_FTLE) vector<double>().swap(this->vert_vals[i]);
+        vector<double>().swap(this->tet_vals[i]);
+    }
+    this->loaded = false;
+}
+
+
+void FrameFields::drop_packed()
+{
+    delete this->packed;
+    this->packed = NULL;
+}
+
+
+FrameHandle::FrameHandle()
+{
+    this->store = NULL;
+    this->main = NULL;
+}
+
+
+FrameHandle::FrameHandle(FrameHandle&& other)
+{
+    this->store = other.store;
+    this->main = other.main;
+    this->pinned.swap(other.pinned);
+    other.store = NULL;
+    other.main = NULL;
+}
+
+
+FrameHandle& FrameHandle::operator=(FrameHandle&& other)
+{
+    if(this == &other) return *this;
+    this->release();
+    this->store = other.store;
+    this->main = other.main;
+    this->pinned.swap(other.pinned);
+    other.store = NULL;
+    other.main = NULL;
+    return *this;
+}
+
+
+FrameHandle::~FrameHandle()
+{
+    this->release();
+}
+
+
+// unpin the frames, they stay loaded until the budget of the store needs their memory
+void FrameHandle::release()
+{
+    if(this->store != NULL) this->store->unpin(this->pinned);
+    this->store = NULL;
+    this->main = NULL;
+}
+
+
+FieldStore::FieldStore()
+{
+    this->cache = NULL;
+    this->topology = NULL;
+    this->num_uses = 0;
+    for(unsigned char c = 0; c < 7; c++) this->quantization_errors[c] = 0.;
+}
+
+
+FieldStore::~FieldStore()
+{
+    this->clear();
+    delete this->cache;
+}
+
+
+void FieldStore::clear()
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    for(auto& pair : this->frames){
+        delete pair.second;
+    }
+    this->frames.clear();
+}
+
+
+FrameInputs FieldStore::inputs(const FrameFields* ff) const
+{
+    FrameInputs in;
+    in.num_verts = this->topology->vert_tet_starts.size() - 1;
+    in.num_tets = this->topology->tet_verts.size() / 4;
+    in.vels = ff->vels.data();
+    in.vors = ff->vors.data();
+    in.mus = ff->mus.data();
+    in.tet_verts = this->topology->tet_verts.data();
+    in.tet_grads = ff->tet_grads.empty() ? nullptr : ff->tet_grads.data();
+    return in;
+}
+
+
+// the inputs of field type at ff. a frame without vorticity gets it derived into derived_vors if the field needs it,
+// it is dropped again once the field is computed
+FrameInputs FieldStore::inputs(const Mesh* mesh, const FrameFields* ff, const ScalarFieldType type, vector<double>& derived_vors)
+{
+    FrameInputs in = this->inputs(ff);
+    if((raw_fields_of(type) & RAW_VORTICITY) && ff->vors.empty()){
+        derived_vors.resize(3 * in.num_verts);
+        this->derive_vert_vors(mesh, ff->vels.data(), derived_vors.data());
+        in.vors = derived_vors.data();
+    }
+    return in;
+}
+
+
+// get the flat raw data of a time step, gather it from the vertex maps on first use
+// a paged frame is loaded if it isn't, it may be released again unless a FrameHandle pins it
+FrameFields* FieldStore::frame(const Mesh* mesh, const double time)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    auto it = this->frames.find(time);
+    if(it != this->frames.end()){
+        if(!it->second->loaded) this->load(mesh, it->second);
+        return it->second;
+    }
+    if(this->cache != NULL) Utility::throwErrorMessage( QString("FieldStore::frame: %1 is not a time of the paged data").arg(time) );
+
+    // the fields that aren't in loaded_fields stay empty
+    const bool has_vel = loaded_fields & RAW_VELOCITY, has_vor = loaded_fields & RAW_VORTICITY, has_mu = loaded_fields & RAW_MU;
+    const UL num_verts = mesh->num_verts();
+    FrameFields* ff = new FrameFields();
+    ff->time = time;
+    if(has_vel) ff->vels.resize(3 * num_verts);
+    if(has_vor) ff->vors.resize(3 * num_verts);
+    if(has_mu) ff->mus.resize(num_verts);
+    for(UL i = 0; i < num_verts; i++){
+        const Vertex* v = mesh->verts[i];
+        if( (has_vel && !v->has_vel_at_t(time, NULL)) || (has_vor && !v->has_vor_at_t(time, NULL)) || (has_mu && !v->has_mu_at_t(time, NULL)) ){
+            Utility::throwErrorMessage( QString("FieldStore::frame: vertex %1 has no data at time %2").arg(i).arg(time) );
+        }
+        for(unsigned char j = 0; j < 3; j++){
+            if(has_vel) ff->vels[3*i + j] = v->vels.at(time)->entry[j];
+            if(has_vor) ff->vors[3*i + j] = v->vors.at(time)->entry[j];
+        }
+        if(has_mu) ff->mus[i] = v->mus.at(time);
+    }
+    ff->loaded = true;
+
+    this->frames[time] = ff;
+    return ff;
+}
+
+
+// the frame of time without loading it if the store is paged, its arrays are only filled while it is pinned
+// otherwise it is gathered like in frame()
+FrameFields* FieldStore::frame_slot(const Mesh* mesh, const double time)
+{
+    if(this->cache == NULL) return this->frame(mesh, time);
+    auto it = this->frames.find(time);
+    if(it == this->frames.end()) Utility::throwErrorMessage( QString("FieldStore::frame_slot: %1 is not a time of the paged data").arg(time) );
+    return it->second;
+}
+
+
+// load a frame of the paged data with the lock held, see read()
+void FieldStore::load(const Mesh* mesh, FrameFields* ff)
+{
+    const double t1 = floor(ff->time);
+    if(ff->time != t1){
+        // loading the raw frames doesn't evict anything, only pinning and unpinning does
+        this->frame(mesh, t1);
+        this->frame(mesh, t1 + 1.);
+    }
+    QuantizedFrame* made = this->fill(mesh, ff->time, ff->packed, ff);
+    if(made != NULL) this->keep_packed(ff, made);
+    ff->loaded = true;
+}
+
+
+// the raw arrays of a frame from its packed copy if there is one, otherwise from read()
+// with quantize_frames a raw frame that was read is packed and returned, its arrays are the decoded values then,
+// so a frame has the same values whether it was read or unpacked
+QuantizedFrame* FieldStore::fill(const Mesh* mesh, const double time, const QuantizedFrame* packed, FrameFields* into) const
+{
+    if(packed != NULL){
+        packed->decode(into);
+        return NULL;
+    }
+    this->read(mesh, time, into);
+    if(!quantize_frames || time != floor(time)) return NULL;
+
+    QuantizedFrame* made = new QuantizedFrame(into);
+    made->decode(into);
+    return made;
+}
+
+
+// keep the packed copy of a raw frame unless another thread was faster, call it with lock held
+// the error bound is logged whenever it grows
+void FieldStore::keep_packed(FrameFields* ff, QuantizedFrame* made)
+{
+    if(ff->packed != NULL){
+        delete made;
+        return;
+    }
+    ff->packed = made;
+
+    bool grew = false;
+    for(unsigned char c = 0; c < 7; c++){
+        if(made->max_error(c) <= this->quantization_errors[c]) continue;
+        this->quantization_errors[c] = made->max_error(c);
+        grew = true;
+    }
+    if(!grew) return;
+    const double* e = this->quantization_errors;
+    qDebug() << "Quantized frames: max error of velocity" << max(e[0], max(e[1], e[2])) << "vorticity"
+             << max(e[3], max(e[4], e[5])) << "mu" << e[6];
+}
+
+
+// read a raw frame from the frame file into the arrays of into, a frame in between two raw ones is interpolated
+// linearly from them the same way Vertex::linear_interpolate_vel() does, they have to be loaded and stay loaded
+// while it runs. only the fields in stored_fields are read, a derived vorticity stays empty and is computed when a
+// field needs it. nothing of the store is changed, so it doesn't need the lock
+void FieldStore::read(const Mesh* mesh, const double time, FrameFields* into) const
+{
+    const UL n = mesh->num_verts();
+    const bool has_vel = stored_fields & RAW_VELOCITY, has_vor = stored_fields & RAW_VORTICITY, has_mu = stored_fields & RAW_MU;
+    if(has_vel) into->vels.resize(3 * n);
+    if(has_vor) into->vors.resize(3 * n);
+    if(has_mu) into->mus.resize(n);
+
+    const double t1 = floor(time);
+    if(time == t1){
+        if(!this->cache->read_frame((UL) t1, has_vel ? into->vels.data() : NULL, has_vor ? into->vors.data() : NULL,
+                                    has_mu ? into->mus.data() : NULL)){
+            Utility::throwErrorMessage( QString("FieldStore::read: couldn't read frame %1 from %2").arg(t1).arg(this->cache->path) );
+        }
+        return;
+    }
+
+    const FrameFields* f1 = this->frames.at(t1);
+    const FrameFields* f2 = this->frames.at(t1 + 1.);
+    const double a = time - t1;
+    Utility::parallel_for(0, n, [&](const UL begin, const UL end){
+        for(UL i = begin; i < end; i++){
+            for(unsigned char j = 0; j < 3; j++){
+                if(has_vel) into->vels[3*i + j] = f1->vels[3*i + j] + (f2->vels[3*i + j] - f1->vels[3*i + j]) * a;
+                if(has_vor) into->vors[3*i + j] = f1->vors[3*i + j] + (f2->vors[3*i + j] - f1->vors[3*i + j]) * a;
+            }
+            if(has_mu) into->mus[i] = f1->mus[i] + (f2->mus[i] - f1->mus[i]) * a;
+        }
+    });
+}
+
+
+// pin a frame and load it if it isn't. a paged frame is read without the lock, so pinning a loaded frame never waits
+// for the disk. if two threads load the same frame at once both read it and the copy of the first one is kept
+FrameFields* FieldStore::pin_frame(const Mesh* mesh, FrameHandle& handle, const double time)
+{
+    FrameFields* ff;
+    const QuantizedFrame* packed = NULL;
+    {
+        lock_guard<recursive_mutex> guard(this->lock);
+        ff = this->cache == NULL ? this->frame(mesh, time) : this->frame_slot(mesh, time);
+        ff->pins++;
+        ff->last_use = ++this->num_uses;
+        handle.pinned.push_back(ff);
+        if(ff->loaded) return ff;
+        // a pinned frame keeps its packed copy
+        packed = ff->packed;
+    }
+
+    // the raw frames of an interpolated one are pinned before it
+    FrameFields fresh;
+    QuantizedFrame* made = this->fill(mesh, time, packed, &fresh);
+
+    lock_guard<recursive_mutex> guard(this->lock);
+    if(!ff->loaded){
+        ff->vels.swap(fresh.vels);
+        ff->vors.swap(fresh.vors);
+        ff->mus.swap(fresh.mus);
+        ff->loaded = true;
+    }
+    if(made != NULL) this->keep_packed(ff, made);
+    return ff;
+}
+
+
+// keep the frame of time loaded while the handle exists, together with the raw frames on both sides of it,
+// which the flow sampler interpolates between. frames of a paged store are read in here if they aren't loaded
+FrameHandle FieldStore::pin(const Mesh* mesh, const double time)
+{
+    FrameHandle handle;
+    handle.store = this;
+    const double last = mesh->num_time_steps - 1.;
+    const double t1 = floor(time);
+    for(double raw = t1; raw <= t1 + 1. && raw <= last; raw += 1.){
+        if(raw >= 0.) this->pin_frame(mesh, handle, raw);
+    }
+    handle.main = this->pin_frame(mesh, handle, time);
+    lock_guard<recursive_mutex> guard(this->lock);
+    this->evict_over_budget();
+    return handle;
+}
+
+
+// keep every raw frame a trace from begin to end samples loaded, fields() of the handle is NULL
+FrameHandle FieldStore::pin_range(const Mesh* mesh, const double begin, const double end)
+{
+    FrameHandle handle;
+    handle.store = this;
+    const double last = mesh->num_time_steps - 1.;
+    const double first = max(0., floor(min(begin, end)));
+    const double stop = min(last, ceil(max(begin, end)) + 1.);
+    for(double raw = first; raw <= stop; raw += 1.) this->pin_frame(mesh, handle, raw);
+    lock_guard<recursive_mutex> guard(this->lock);
+    this->evict_over_budget();
+    return handle;
+}
+
+
+void FieldStore::unpin(vector<FrameFields*>& pinned)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    for(FrameFields* ff : pinned) ff->pins--;
+    pinned.clear();
+    this->evict_over_budget();
+}
+
+
+// release the least recently pinned frames that aren't pinned until the loaded ones fit into field_memory_budget
+// pinned frames are never released, so the budget can be exceeded while they are in use
+// frames with a packed copy keep it while the arrays of any frame can still be released, so about 4 times as many
+// frames stay in memory as packed ones as would as doubles
+void FieldStore::evict_over_budget()
+{
+    if(this->cache == NULL) return;
+    UL bytes = 0;
+    vector<FrameFields*> unpinned;
+    for(const auto& pair : this->frames){
+        FrameFields* ff = pair.second;
+        if(!ff->loaded && ff->packed == NULL) continue;
+        bytes += ff->num_bytes();
+        if(ff->pins == 0) unpinned.push_back(ff);
+    }
+    if(bytes <= field_memory_budget) return;
+
+    sort(unpinned.begin(), unpinned.end(), [](const FrameFields* a, const FrameFields* b){
+        return a->last_use < b->last_use;
+    });
+    for(FrameFields* ff : unpinned){
+        if(bytes <= field_memory_budget) break;
+        if(!ff->loaded) continue;
+        const UL before = ff->num_bytes();
+        ff->release();
+        bytes -= before - ff->num_bytes();
+    }
+    for(FrameFields* ff : unpinned){
+        if(bytes <= field_memory_budget) break;
+        if(ff->packed == NULL) continue;
+        bytes -= ff->num_bytes();
+        ff->release();
+        ff->drop_packed();
+    }
+}
+
+
+// page the raw data from cache, which is owned by the store from now on. the vertex maps of the mesh stay empty
+// every time the mesh is analysed at gets its frame here, so frames is never changed afterwards and can be
+// searched without the lock
+void FieldStore::page_from(FrameCache* cache)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    this->clear();
+    delete this->cache;
+    this->cache = cache;
+
+    auto add = [this](const double time){
+        if(this->frames.find(time) != this->frames.end()) return;
+        FrameFields* ff = new FrameFields();
+        ff->time = time;
+        this->frames[time] = ff;
+    };
+    for(UL i = 0; i < cache->num_frames; i++) add((double) i);
+    double time = 0.;
+    while(time < cache->num_frames - 1.){
+        add(time);
+        time += time_step_size;
+    }
+}
+
+
+// true if time is a frame of the paged data, whether it is loaded or not
+bool FieldStore::has_frame(const double time) const
+{
+    return this->frames.find(time) != this->frames.end();
+}
+
+
+// true if the frame of time and the raw frames around it are loaded, so pinning it doesn't read anything
+bool FieldStore::is_loaded(const double time)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    const double t1 = floor(time);
+    for(const double t : {time, t1, t1 + 1.}){
+        auto it = this->frames.find(t);
+        if(it != this->frames.end() && !it->second->loaded) return false;
+    }
+    return this->frames.find(time) != this->frames.end();
+}
+
+
+// the loaded frame of time of a paged store, without taking the lock. the caller has to hold a FrameHandle of it
+const FrameFields* FieldStore::resident(const double time) const
+{
+    auto it = this->frames.find(time);
+    if(it == this->frames.end() || !it->second->loaded){
+        Utility::throwErrorMessage( QString("FieldStore::resident: the frame at time %1 is not pinned").arg(time) );
+    }
+    return it->second;
+}
+
+
+// heap bytes of the loaded and packed frames
+UL FieldStore::num_resident_bytes()
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    UL bytes = 0;
+    for(const auto& pair : this->frames){
+        if(pair.second->loaded || pair.second->packed != NULL) bytes += pair.second->num_bytes();
+    }
+    return bytes;
+}
+
+
+// the velocity is linear inside a tet, so its gradient is constant
+const vector<double>& FieldStore::tet_grads(const Mesh* mesh, const double time)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    FrameFields* ff = this->frame(mesh, time);
+    if(!ff->tet_grads.empty()) return ff->tet_grads;
+    if(!(loaded_fields & RAW_VELOCITY)) Utility::throwErrorMessage( "FieldStore::tet_grads: velocity is not in loaded_fields" );
+
+    ff->tet_grads.resize(9 * (this->topology->tet_verts.size() / 4));
+    this->calc_tet_grads(ff->vels.data(), ff->tet_grads.data());
+    return ff->tet_grads;
+}
+
+
+// velocity gradient at each vertex, the mean of the gradients of the tets around it
+// unlike tet_grads it varies linearly inside a tet, which the vortex core extraction relies on
+const vector<double>& FieldStore::vert_grads(const Mesh* mesh, const double time)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    FrameFields* ff = this->frame(mesh, time);
+    if(!ff->vert_grads.empty()) return ff->vert_grads;
+
+    const vector<double>& grads = this->tet_grads(mesh, time);
+    ff->vert_grads.resize(9 * (this->topology->vert_tet_starts.size() - 1));
+    this->average_tet_grads_to_verts(grads.data(), ff->vert_grads.data());
+    return ff->vert_grads;
+}
+
+
+// gradient of a vector field given at the vertices (3 doubles per vertex), 9 doubles per tet in tet_grads
+void FieldStore::calc_tet_grads(const double* vals, double* tet_grads) const
+{
+    const UL num_tets = this->topology->tet_verts.size() / 4;
+    Utility::parallel_for(0, num_tets, [&](const UL begin, const UL end){
+        for(UL t = begin; t < end; t++) this->calc_tet_grad(vals, t, tet_grads + 9*t);
+    });
+}
+
+
+// J = (D^-1 U)^T where the rows of D are the edge vectors p_k - p_0 and the rows of U are u_k - u_0
+void FieldStore::calc_tet_grad(const double* vals, const UL t, double* J) const
+{
+    const UL* tv = this->topology->tet_verts.data() + 4*t;
+    const double* inv = this->topology->tet_inv_edges.data() + 9*t;
+    const double* u0 = vals + 3*tv[0];
+    double U[3][3];
+    for(unsigned char k = 0; k < 3; k++){
+        const double* uk = vals + 3*tv[k+1];
+        for(unsigned char i = 0; i < 3; i++) U[k][i] = uk[i] - u0[i];
+    }
+
+    // G = D^-1 U, G[j][i] = du_i/dx_j, J[i][j] = G[j][i]
+    for(unsigned char j = 0; j < 3; j++){
+        for(unsigned char i = 0; i < 3; i++){
+            J[i*3 + j] = inv[j*3]*U[0][i] + inv[j*3 + 1]*U[1][i] + inv[j*3 + 2]*U[2][i];
+        }
+    }
+}
+
+
+// vorticity of every tet, the curl of the velocity is constant inside a tet like its gradient
+const vector<double>& FieldStore::tet_vors(const Mesh* mesh, const double time)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    FrameFields* ff = this->frame(mesh, time);
+    if(!ff->tet_vors.empty()) return ff->tet_vors;
+    if(!(loaded_fields & RAW_VELOCITY)) Utility::throwErrorMessage( "FieldStore::tet_vors: velocity is not in loaded_fields" );
+
+    const UL num_tets = this->topology->tet_verts.size() / 4;
+    ff->tet_vors.resize(3 * num_tets);
+    const double* grads = ff->tet_grads.empty() ? nullptr : ff->tet_grads.data();
+    Utility::parallel_for(0, num_tets, [&](const UL begin, const UL end){
+        double J[9];
+        for(UL t = begin; t < end; t++){
+            if(grads != nullptr) vorticity_of(grads + 9*t, ff->tet_vors.data() + 3*t);
+            else{
+                this->calc_tet_grad(ff->vels.data(), t, J);
+                vorticity_of(J, ff->tet_vors.data() + 3*t);
+            }
+        }
+    });
+    return ff->tet_vors;
+}
+
+
+// vorticity of vertex vert from the velocity of a frame, the mean curl of the tets around it
+// only reads the topology, so it can be called without the lock
+void FieldStore::calc_vert_vor(const double* vels, const UL vert, double* w) const
+{
+    w[0] = w[1] = w[2] = 0.;
+    const UL first = this->topology->vert_tet_starts[vert], last = this->topology->vert_tet_starts[vert + 1];
+    if(last == first) return;
+    double J[9], tet_w[3];
+    for(UL j = first; j < last; j++){
+        this->calc_tet_grad(vels, this->topology->vert_tet_ids[j], J);
+        vorticity_of(J, tet_w);
+        for(unsigned char k = 0; k < 3; k++) w[k] += tet_w[k];
+    }
+    const double inv_count = 1. / (last - first);
+    for(unsigned char k = 0; k < 3; k++) w[k] *= inv_count;
+}
+
+
+// vorticity of every vertex of mesh from its velocity (3 doubles per vertex each), see calc_vert_vor()
+void FieldStore::derive_vert_vors(const Mesh* mesh, const double* vels, double* vors)
+{
+    Utility::parallel_for(0, mesh->num_verts(), [&](const UL begin, const UL end){
+        for(UL i = begin; i < end; i++) this->calc_vert_vor(vels, i, vors + 3*i);
+    });
+}
+
+
+// mean of the tet gradients around each vertex, 9 doubles per vertex in vert_grads
+void FieldStore::average_tet_grads_to_verts(const double* tet_grads, double* vert_grads) const
+{
+    const UL num_verts = this->topology->vert_tet_starts.size() - 1;
+    Utility::parallel_for(0, num_verts, [&](const UL begin, const UL end){
+        for(UL i = begin; i < end; i++){
+            double* out = vert_grads + 9*i;
+            for(unsigned char k = 0; k < 9; k++) out[k] = 0.;
+            const UL first = this->topology->vert_tet_starts[i], last = this->topology->vert_tet_starts[i + 1];
+            if(last == first) continue;
+            for(UL j = first; j < last; j++){
+                const double* g = tet_grads + 9*this->topology->vert_tet_ids[j];
+                for(unsigned char k = 0; k < 9; k++) out[k] += g[k];
+            }
+            const double inv_count = 1. / (last - first);
+            for(unsigned char k = 0; k < 9; k++) out[k] *= inv_count;
+        }
+    });
+}
+
+
+template<class Field>
+void FieldStore::compute_vert_field(FrameFields* ff, const FrameInputs& in)
+{
+    vector<double>& out = ff->vert_vals[Field::type];
+    out.resize(in.num_verts);
+    double* out_ptr = out.data();
+    Utility::parallel_for(0, in.num_verts, [&](const UL begin, const UL end){
+        compute_scalar_field<Field>(in, out_ptr, begin, end);
+    });
+}
+
+
+template<class Field>
+void FieldStore::compute_tet_field(FrameFields* ff, const FrameInputs& in)
+{
+    vector<double>& out = ff->tet_vals[Field::type];
+    out.resize(in.num_tets);
+    double* out_ptr = out.data();
+    Utility::parallel_for(0, in.num_tets, [&](const UL begin, const UL end){
+        compute_scalar_field<Field>(in, out_ptr, begin, end);
+    });
+}
+
+
+// vertex value is the mean of the values of the tets around it
+void FieldStore::average_tet_field_to_verts(FrameFields* ff, const ScalarFieldType type)
+{
+    const UL num_verts = this->topology->vert_tet_starts.size() - 1;
+    const vector<double>& tet_vals = ff->tet_vals[type];
+    vector<double>& out = ff->vert_vals[type];
+    out.resize(num_verts);
+    Utility::parallel_for(0, num_verts, [&](const UL begin, const UL end){
+        for(UL i = begin; i < end; i++){
+            const UL first = this->topology->vert_tet_starts[i], last = this->topology->vert_tet_starts[i + 1];
+            double sum = 0.;
+            for(UL k = first; k < last; k++) sum += tet_vals[ this->topology->vert_tet_ids[k] ];
+            out[i] = last > first ? sum / (last - first) : 0.;
+        }
+    });
+}
+
+
+// a field can't be computed if a raw field it needs was skipped when the data was read
+void FieldStore::check_loaded(const ScalarFieldType type) const
+{
+    const unsigned char missing = raw_fields_of(type) & ~loaded_fields;
+    if(missing == 0) return;
+    Utility::throwErrorMessage( QString("FieldStore: %1 needs %2, which is not in loaded_fields")
+                                .arg(scalar_field_name(type)).arg(raw_field_names(missing)) );
+}
+
+
+// get the per-tet values of a derived field (Q, lambda2 or helicity) at time
+const vector<double>& FieldStore::tet_vals(const Mesh* mesh, const double time, const ScalarFieldType type)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    FrameFields* ff = this->frame(mesh, time);
+    if(ff->has_tet_field(type)) return ff->tet_vals[type];
+    this->check_loaded(type);
+    if(type == FIELD_Q || type == FIELD_LAMBDA2) this->tet_grads(mesh, time);
+    vector<double> derived_vors;
+    const FrameInputs in = this->inputs(mesh, ff, type, derived_vors);
+
+    switch(type){
+    case FIELD_Q: this->compute_tet_field<QCriterionField>(ff, in); break;
+    case FIELD_LAMBDA2: this->compute_tet_field<Lambda2Field>(ff, in); break;
+    case FIELD_HELICITY: this->compute_tet_field<TetHelicityField>(ff, in); break;
+    default:
+        Utility::throwErrorMessage( QString("FieldStore::tet_vals: %1 is not a per-tet field").arg(scalar_field_name(type)) );
+    }
+    return ff->tet_vals[type];
+}
+
+
+// get the scalar field of type at time, compute it if it is not there yet
+const vector<double>& FieldStore::vert_vals(const Mesh* mesh, const double time, const ScalarFieldType type)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    FrameFields* ff = this->frame(mesh, time);
+    if(ff->has_field(type)) return ff->vert_vals[type];
+    this->check_loaded(type);
+    vector<double> derived_vors;
+    const FrameInputs in = this->inputs(mesh, ff, type, derived_vors);
+
+    // one instantiated loop per field, the switch is only taken once per frame
+    switch(type){
+    case FIELD_VEL_MAG: this->compute_vert_field<VelMagField>(ff, in); break;
+    case FIELD_VOR_MAG: this->compute_vert_field<VorMagField>(ff, in); break;
+    case FIELD_MU: this->compute_vert_field<MuField>(ff, in); break;
+    case FIELD_HELICITY: this->compute_vert_field<HelicityField>(ff, in); break;
+    case FIELD_Q:
+    case FIELD_LAMBDA2:
+        this->tet_vals(mesh, time, type);
+        this->average_tet_field_to_verts(ff, type);
+        break;
+    case FIELD_FTLE:
+        // minutes of work, it is never run here under the lock. a frame only has FTLE after compute_ftle() was run
+        // on it and the result was handed to set_vert_vals(), the others stay empty
+        break;
+    default: Utility::throwErrorMessage( QString("FieldStore::vert_vals: unknown field %1").arg(type) );
+    }
+
+    return ff->vert_vals[type];
+}
+
+
+// a field computed outside the store, like FTLE, becomes the one of the frame at time, vals is left empty
+void FieldStore::set_vert_vals(const Mesh* mesh, const double time, const ScalarFieldType type, vector<double>& vals)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    this->frame(mesh, time)->vert_vals[type].swap(vals);
+    vector<double>().swap(vals);
+}
+
+
+// per-tet and vertex-averaged Q, lambda2 and helicity of one time step, the ones whose raw fields are loaded
+void FieldStore::compute_derived_fields(const Mesh* mesh, const double time)
+{
+    lock_guard<recursive_mutex> guard(this->lock);
+    for(const ScalarFieldType type : {FIELD_Q, FIELD_LAMBDA2, FIELD_HELICITY}){
+        if(raw_fields_of(type) & ~loaded_fields) continue;
+        this->tet_vals(mesh, time, type);
+        this->vert_vals(mesh, time, type);
+    }
+}
+
+
+// needs to be called after mesh->interpolate_vertices_for_all_t() if the in-between frames are wanted
+void compute_derived_fields_for_all_t(Mesh* mesh)
+{
+    // a paged frame loses its derived fields when it is released, they are computed when the frame is used
+    if(mesh->field_store.is_paged()) return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    UL num_frames = 0;
+    double time = 0.;
+    while(time < mesh->num_time_steps - 1.)
+    {
+        mesh->field_store.compute_derived_fields(mesh, time);
+        num_frames++;
+        time += time_step_size; // increment time
+    }
+
+    const double secs = timer.nsecsElapsed() / 1e9;
+    qDebug() << "Derived fields: Q, lambda2 and helicity for" << num_frames << "frames in" << secs << "secs,"
+             << (secs > 0 ? num_frames * mesh->num_tets() / secs : 0.) << "tets/sec on" << Utility::num_threads() << "threads";
+}
+
+
+// compare the vorticity derived from the velocity with the one of the data file at every raw frame
+// logs the RMS and largest error of the vectors and the RMS error relative to the RMS of the data file
+// vorticity has to be read from the data file for it, so derive_vorticity has to be off
+void report_vorticity_error(Mesh* mesh)
+{
+    if((stored_fields & (RAW_VELOCITY | RAW_VORTICITY)) != (RAW_VELOCITY | RAW_VORTICITY)){
+        qDebug() << "Vorticity check: velocity and vorticity have to be read from the data file";
+        return;
+    }
+
+    const UL n = mesh->num_verts();
+    vector<double> derived(3 * n);
+    double total_err2 = 0., total_ref2 = 0., total_max = 0.;
+    for(UL f = 0; f < mesh->num_time_steps; f++){
+        const FrameHandle frame = mesh->field_store.pin(mesh, (double) f);
+        const FrameFields* ff = frame.fields();
+        mesh->field_store.derive_vert_vors(mesh, ff->vels.data(), derived.data());
+
+        double err2 = 0., ref2 = 0., max_err = 0.;
+        for(UL i = 0; i < 3 * n; i += 3){
+            double e2 = 0., r2 = 0.;
+            for(unsigned char k = 0; k < 3; k++){
+                const double d = derived[i + k] - ff->vors[i + k];
+                e2 += d * d;
+                r2 += ff->vors[i + k] * ff->vors[i + k];
+            }
+            err2 += e2;
+            ref2 += r2;
+            max_err = max(max_err, sqrt(e2));
+        }
+        qDebug() << "Vorticity check: frame" << f << "RMS error" << sqrt(err2 / n) << "max error" << max_err
+                 << "relative RMS error" << (ref2 > 0. ? sqrt(err2 / ref2) : 0.);
+        total_err2 += err2;
+        total_ref2 += ref2;
+        total_max = max(total_max, max_err);
+    }
+
+    const double num_samples = (double) n * mesh->num_time_steps;
+    qDebug() << "Vorticity check:" << mesh->num_time_steps << "frames, RMS error" << sqrt(total_err2 / num_samples)
+             << "max error" << total_max << "relative RMS error" << (total_ref2 > 0. ? sqrt(total_err2 / total_ref2) : 0.);
+}
@@ -0,0 +1,162 @@
+#ifndef FIELDSTORE_H
+#define FIELDSTORE_H
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include "Analysis/ScalarFields.h"
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+class Topology;
+class FrameCache;
+class FieldStore;
+class QuantizedFrame;
+
+// flat per-vertex and per-tet arrays of one time step
+// the raw data is gathered out of the vertex maps once, every scalar field is then computed from it
+// the raw arrays of fields that aren't in loaded_fields stay empty, so does vors of a paged frame with derive_vorticity
+class FrameFields{
+public:
+    double time;
+    vector<double> vels;    // 3 doubles per vertex
+    vector<double> vors;    // 3 doubles per vertex
+    vector<double> mus;     // 1 double per vertex
+    vector<double> tet_grads; // 9 doubles per tet, empty until a field needs the velocity gradient
+    vector<double> vert_grads; // 9 doubles per vertex, mean of tet_grads around the vertex, empty until requested
+    vector<double> tet_vors;  // 3 doubles per tet, curl of the velocity, empty until requested
+    vector<double> vert_vals[NUM_SCALAR_FIELDS]; // empty until the field is requested
+    vector<double> tet_vals[NUM_SCALAR_FIELDS];  // per-tet values of the derived fields, empty until computed
+
+    // residency in a paged store, guarded by its lock
+    bool loaded;    // vels, vors and mus are filled
+    UI pins;        // FrameHandles that keep it loaded
+    UL last_use;
+    QuantizedFrame* packed; // 16-bit copy of the raw data of a raw frame with quantize_frames, kept after release()
+
+    FrameFields();
+    ~FrameFields();
+
+    inline bool has_field(const ScalarFieldType type) const;
+    inline bool has_tet_field(const ScalarFieldType type) const;
+    UL num_bytes() const;
+    void release();
+    void drop_packed();
+};
+
+
+inline bool FrameFields::has_field(const ScalarFieldType type) const
+{
+    return !this->vert_vals[type].empty();
+}
+
+
+inline bool FrameFields::has_tet_field(const ScalarFieldType type) const
+{
+    return !this->tet_vals[type].empty();
+}
+
+
+// keeps frames of a field store loaded while it exists, see FieldStore::pin()
+// the fields of a pinned frame are never released, so they can be read without the lock of the store
+class FrameHandle{
+public:
+    FrameHandle();
+    FrameHandle(FrameHandle&& other);
+    FrameHandle& operator=(FrameHandle&& other);
+    FrameHandle(const FrameHandle&) = delete;
+    FrameHandle& operator=(const FrameHandle&) = delete;
+    ~FrameHandle();
+
+    inline FrameFields* fields() const;
+    void release();
+
+private:
+    friend class FieldStore;
+    FieldStore* store;
+    FrameFields* main;          // the frame it was asked for
+    vector<FrameFields*> pinned; // main and the raw frames it needs
+};
+
+
+inline FrameFields* FrameHandle::fields() const
+{
+    return this->main;
+}
+
+
+// owns the scalar fields of every time step of a mesh, fields are computed on demand
+// the public functions may be called from the GUI and the background analysis at the same time,
+// a field is computed once under the lock and never changes afterwards
+// the raw data either comes from the vertex maps or, once page_from() is called, from a frame file. a paged store
+// only keeps the frames that are pinned or were used last, up to field_memory_budget bytes of raw and derived
+// fields. every reader of a paged mesh, including the vertex accessors, has to hold a FrameHandle of the time
+// with quantize_frames a released raw frame keeps a 16-bit copy, it is unpacked instead of read when pinned again
+class FieldStore{
+public:
+    unordered_map<double, FrameFields*> frames; // <time, fields>, has every time from the start if paged
+    FrameCache* cache; // NULL if the raw data is in the vertex maps
+
+    const Topology* topology; // of the mesh, its flat arrays are shared by all time steps
+
+    FieldStore();
+    ~FieldStore();
+
+    const vector<double>& vert_vals(const Mesh* mesh, const double time, const ScalarFieldType type);
+    void set_vert_vals(const Mesh* mesh, const double time, const ScalarFieldType type, vector<double>& vals);
+    const vector<double>& tet_vals(const Mesh* mesh, const double time, const ScalarFieldType type);
+    const vector<double>& tet_grads(const Mesh* mesh, const double time);
+    const vector<double>& vert_grads(const Mesh* mesh, const double time);
+    const vector<double>& tet_vors(const Mesh* mesh, const double time);
+    FrameFields* frame(const Mesh* mesh, const double time);
+    FrameFields* frame_slot(const Mesh* mesh, const double time);
+    FrameHandle pin(const Mesh* mesh, const double time);
+    FrameHandle pin_range(const Mesh* mesh, const double begin, const double end);
+    void page_from(FrameCache* cache);
+    inline bool is_paged() const;
+    bool has_frame(const double time) const;
+    bool is_loaded(const double time);
+    const FrameFields* resident(const double time) const;
+    UL num_resident_bytes();
+    void compute_derived_fields(const Mesh* mesh, const double time);
+    void calc_tet_grads(const double* vals, double* tet_grads) const;
+    void average_tet_grads_to_verts(const double* tet_grads, double* vert_grads) const;
+    void calc_vert_vor(const double* vels, const UL vert, double* w) const;
+    void derive_vert_vors(const Mesh* mesh, const double* vels, double* vors);
+    void clear();
+
+private:
+    friend class FrameHandle;
+    recursive_mutex lock;
+    UL num_uses;
+    double quantization_errors[7]; // largest error bound of the packed frames per component
+
+    void load(const Mesh* mesh, FrameFields* ff);
+    void read(const Mesh* mesh, const double time, FrameFields* into) const;
+    QuantizedFrame* fill(const Mesh* mesh, const double time, const QuantizedFrame* packed, FrameFields* into) const;
+    void keep_packed(FrameFields* ff, QuantizedFrame* made);
+    FrameFields* pin_frame(const Mesh* mesh, FrameHandle& handle, const double time);
+    void unpin(vector<FrameFields*>& pinned);
+    void evict_over_budget();
+    FrameInputs inputs(const FrameFields* ff) const;
+    FrameInputs inputs(const Mesh* mesh, const FrameFields* ff, const ScalarFieldType type, vector<double>& derived_vors);
+    void calc_tet_grad(const double* vals, const UL t, double* J) const;
+    template<class Field> void compute_vert_field(FrameFields* ff, const FrameInputs& in);
+    template<class Field> void compute_tet_field(FrameFields* ff, const FrameInputs& in);
+    void average_tet_field_to_verts(FrameFields* ff, const ScalarFieldType type);
+    void check_loaded(const ScalarFieldType type) const;
+};
+
+
+inline bool FieldStore::is_paged() const
+{
+    return this->cache != NULL;
+}
+
+
+void compute_derived_fields_for_all_t(Mesh* mesh);
+void report_vorticity_error(Mesh* mesh);
+
+#endif // FIELDSTORE_H
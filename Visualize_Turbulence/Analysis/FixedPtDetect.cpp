@@ -1,6 +1,7 @@
 #include "Geometry/Mesh.h"
 #include "Others/Utilities.h"
 #include "Analysis/FixedPtDetect.h"
+#include "Others/Parallel.h"
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
 #include <iostream>
@@ -16,14 +17,32 @@ unordered_map< double, vector<Singularity*> > Mesh::detect_sings()
 
     double cur_time = 0;
     while( cur_time < this->num_time_steps - 1. ){
-        // create candidate tet list at cur_time
-        // note that each tet is deep-copied from the original tet in the mesh
-        // we copied vertices and edges, remeber to free them when done
-        vector<Tet*> candidates = this->build_candidate_tets(cur_time);
-        vector<Singularity*>temp;
-        sings_for_all_t[cur_time] = temp;
-        // for each candidate tet, we try to find critical point inside it.
-        for(UI i = 0; i < candidates.size(); i++){
+        const FrameHandle frame = this->field_store.pin(this, cur_time);
+        sings_for_all_t[cur_time] = this->detect_sings_at(cur_time);
+        cur_time += time_step_size;
+    }
+
+    qDebug() << "finish detecting singularities";
+    return sings_for_all_t;
+}
+
+
+// the singularities of one time, nothing of the mesh is changed
+vector<Singularity*> Mesh::detect_sings_at(const double cur_time) const
+{
+    // create candidate tet list at cur_time
+    // note that each tet is deep-copied from the original tet in the mesh
+    // we copied vertices and edges, remeber to free them when done
+    vector<Tet*> candidates = this->build_candidate_tets(cur_time);
+    // for each candidate tet, we try to find critical point inside it.
+    // the candidates are copies, so each one is searched on its own thread, the singularities of a chunk
+    // are kept apart and joined in candidate order afterwards
+    const UL num_chunks = Utility::num_threads();
+    vector<vector<Singularity*>> found(num_chunks);
+    const UL chunk_size = (candidates.size() + num_chunks - 1) / num_chunks;
+    Utility::parallel_for(0, candidates.size(), [&](const UL begin, const UL end){
+        vector<Singularity*>& local = found[chunk_size > 0 ? begin / chunk_size : 0];
+        for(UL i = begin; i < end; i++){
             Tet* tet = candidates[i];
             Vector3d* fixed_pt_cords = nullptr;
             // try to find the critical point using tetrahedron subdivision method
@@ -34,10 +53,10 @@ unordered_map< double, vector<Singularity*> > Mesh::detect_sings()
                 // calculate the jacobian matrix on the fixed point location
                 Singularity* sing = new Singularity();
                 sing->cords = fixed_pt_cords;
-                sing->Jacobian = tet->calc_Jacobian(fixed_pt_cords, cur_time);
+                sing->Jacobian = tet->calc_Jacobian(fixed_pt_cords, cur_time, NULL);
                 sing->classify_this(); // classify the type of the singularity
                 sing->in_which_tet = this->tets[tet->idx]; // record the which tet contains this singularity
-                sings_for_all_t[cur_time].push_back( sing ); // save the singularity in a vector
+                local.push_back( sing ); // save the singularity in a vector
                 delete fixed_pt_cords;
             }
 
@@ -47,27 +66,28 @@ unordered_map< double, vector<Singularity*> > Mesh::detect_sings()
             delete tet;
             candidates[i] = nullptr;
         }
-        candidates.clear();
+    }, 1);
 
-        cur_time += time_step_size;
+    vector<Singularity*> sings;
+    for(const vector<Singularity*>& local : found){
+        sings.insert(sings.end(), local.begin(), local.end());
     }
-
-    qDebug() << "finish detecting singularities";
-    return sings_for_all_t;
+    return sings;
 }
 
 
-bool Mesh::is_candidate_tet(Tet* tet, const double time) const
+// store is the field store of the mesh of tet, NULL for a copy, see Vertex::vel_at()
+bool Mesh::is_candidate_tet(Tet* tet, const double time, const FieldStore* store) const
 {
     bool pos_x = false, neg_x = false;
     bool pos_y = false, neg_y = false;
     bool pos_z = false, neg_z = false;
 
     for(const Vertex* vert : tet->verts){
-        Vector3d* vel = vert->vels.at(time);
-        double x = vel->x();
-        double y = vel->y();
-        double z = vel->z();
+        const Vector3d vel = vert->vel_at(time, store);
+        double x = vel.x();
+        double y = vel.y();
+        double z = vel.z();
 
         if(x > 0) pos_x = true;
         if(x < 0) neg_x = true;
@@ -96,12 +116,11 @@ vector<Tet*> Mesh::build_candidate_tets( const double time ) const
         if(tet->has_boundary_tri()) continue;
 
         // check if it is a candidate tet
-        if( is_candidate_tet(tet, time) ){
-            tet->marked = true;
-            Vertex* v1 = tet->get_vert_at(tet->verts[0]->cords, time, ws, true, true);
-            Vertex* v2 = tet->get_vert_at(tet->verts[1]->cords, time, ws, true, true);
-            Vertex* v3 = tet->get_vert_at(tet->verts[2]->cords, time, ws, true, true);
-            Vertex* v4 = tet->get_vert_at(tet->verts[3]->cords, time, ws, true, true);
+        if( is_candidate_tet(tet, time, &this->field_store) ){
+            Vertex* v1 = tet->get_vert_at(tet->verts[0]->cords, time, &this->field_store, ws, true, true);
+            Vertex* v2 = tet->get_vert_at(tet->verts[1]->cords, time, &this->field_store, ws, true, true);
+            Vertex* v3 = tet->get_vert_at(tet->verts[2]->cords, time, &this->field_store, ws, true, true);
+            Vertex* v4 = tet->get_vert_at(tet->verts[3]->cords, time, &this->field_store, ws, true, true);
             Tet* new_tet = new Tet(v1, v2, v3, v4);
             new_tet->idx = tet->idx;
             new_tet->make_edges();
@@ -138,19 +157,17 @@ bool Mesh::has_fixedPt_Robust( const Tet* tet, const double time ) const {
     Vertex* vert3 = tet->verts[2];
     Vertex* vert4 = tet->verts[3];
 
-    const Vector3d* v1 = vert1->vels[time];
-    const Vector3d* v2 = vert2->vels[time];
-    const Vector3d* v3 = vert3->vels[time];
-    const Vector3d* v4 = vert4->vels[time];
-    vector<const Vector3d*> vs = {v1, v2, v3, v4};
+    const Vector3d vels[4] = {vert1->vel_at(time, &this->field_store), vert2->vel_at(time, &this->field_store),
+                              vert3->vel_at(time, &this->field_store), vert4->vel_at(time, &this->field_store)};
+    vector<const Vector3d*> vs = {&vels[0], &vels[1], &vels[2], &vels[3]};
 
     const Vector3d* zero = new Vector3d();
 
     char s = this->Positive(vs[0], vs[1], vs[2], vs[3], time);
-    for(char i=0; i<4; i++){
+    for(unsigned char i=0; i<4; i++){
         vs[i] = zero;
         char s_i = this->Positive(vs[0], vs[1], vs[2], vs[3], time);
-        vs[i] = tet->verts[i]->vels[time];
+        vs[i] = &vels[i];
         if(s != s_i) return false;
     }
 
@@ -164,22 +181,29 @@ void Mesh::find_tets_with_fixedPts()
     double cur_time = 0.;
 
     while( cur_time < this->num_time_steps - 1. ){
-        vector<Tet*> tets_with_fixed_pt;
-        tets_with_fixed_pt.reserve(100);
-        for(Tet* tet : this->tets){
-            if(tet->has_boundary_tri()) continue;
-           if( this->has_fixedPt_Robust(tet, cur_time) ){
-               // TODO: should we do a simpler candidate test first?
-               tets_with_fixed_pt.push_back(tet);
-           }
-        }
-        this->tet_with_fixed_pt_for_all_t[cur_time] = tets_with_fixed_pt;
+        const FrameHandle frame = this->field_store.pin(this, cur_time);
+        this->tet_with_fixed_pt_for_all_t[cur_time] = this->find_tets_with_fixedPts_at(cur_time);
         cur_time += time_step_size;
     }
     return;
 }
 
 
+vector<Tet*> Mesh::find_tets_with_fixedPts_at(const double cur_time) const
+{
+    vector<Tet*> tets_with_fixed_pt;
+    tets_with_fixed_pt.reserve(100);
+    for(Tet* tet : this->tets){
+        if(tet->has_boundary_tri()) continue;
+       if( this->has_fixedPt_Robust(tet, cur_time) ){
+           // TODO: should we do a simpler candidate test first?
+           tets_with_fixed_pt.push_back(tet);
+       }
+    }
+    return tets_with_fixed_pt;
+}
+
+
 /* find one fixed pt in a given tet, assume only one can exist in a tet.
  * The idea is to subdivide the tetrahedron recursively until we found the a critical point.
  * Steps:
@@ -204,7 +228,7 @@ UI Mesh::find_fixed_pt_location_TetSubd( const Tet *tet_to_be_checked, const dou
 
     // copy the tet_to_be_checked
     // only copies the vertices and velocity at time
-    Tet* tet_cp = tet_to_be_checked->clone(time);
+    Tet* tet_cp = tet_to_be_checked->clone(time, NULL);
     temp_verts.push_back(tet_cp->verts[0]);
     temp_verts.push_back(tet_cp->verts[1]);
     temp_verts.push_back(tet_cp->verts[2]);
@@ -243,13 +267,13 @@ UI Mesh::find_fixed_pt_location_TetSubd( const Tet *tet_to_be_checked, const dou
         // if we didn't find a fixed pt on vertices, we subdivide
         vector<Tet*> new_candidates;
         // subdivision will create 8 smaller tetrahedrons and those tetrahedrons also create vertices and edges
-        tet->subdivide(time, temp_verts, temp_edges, temp_tris, new_candidates);
+        tet->subdivide(time, NULL, temp_verts, temp_edges, temp_tris, new_candidates);
 
         if(new_candidates.size() != 8) Utility::throwErrorMessage( "Mesh::find_fixed_pt_location_TetSubd: Error! The size of new_candidates is not 8!");
 
         for(Tet* new_tet : new_candidates){
             // check if the new tet is a candidate
-            if( is_candidate_tet(new_tet, time) ){
+            if( is_candidate_tet(new_tet, time, NULL) ){
                 candidate_tets.push(new_tet);
                 continue;
             }
@@ -0,0 +1,100 @@
+#include "Analysis/QuantizedFrame.h"
+#include "Analysis/FieldStore.h"
+#include "Others/Parallel.h"
+#include <mutex>
+#include <cmath>
+#include <cfloat>
+
+static const double max_code = 65535.;
+
+
+// range of every component of an array with width values per vertex, low and high have width entries
+static void component_ranges(const vector<double>& vals, const UI width, double* low, double* high)
+{
+    for(UI c = 0; c < width; c++){
+        low[c] = DBL_MAX;
+        high[c] = -DBL_MAX;
+    }
+    mutex lock;
+    Utility::parallel_for(0, vals.size() / width, [&](const UL begin, const UL end){
+        double lo[3] = {DBL_MAX, DBL_MAX, DBL_MAX}, hi[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+        for(UL i = begin; i < end; i++){
+            for(UI c = 0; c < width; c++){
+                lo[c] = fmin(lo[c], vals[width*i + c]);
+                hi[c] = fmax(hi[c], vals[width*i + c]);
+            }
+        }
+        lock_guard<mutex> guard(lock);
+        for(UI c = 0; c < width; c++){
+            low[c] = fmin(low[c], lo[c]);
+            high[c] = fmax(high[c], hi[c]);
+        }
+    });
+}
+
+
+// quantize vals to codes, lows and steps are those of the first component of vals
+static void encode(const vector<double>& vals, const UI width, double* lows, double* steps, vector<uint16_t>& codes)
+{
+    if(vals.empty()) return;
+    double high[3];
+    component_ranges(vals, width, lows, high);
+    double inv_steps[3];
+    for(UI c = 0; c < width; c++){
+        steps[c] = (high[c] - lows[c]) / max_code;
+        inv_steps[c] = steps[c] > 0. ? 1. / steps[c] : 0.;
+    }
+
+    codes.resize(vals.size());
+    Utility::parallel_for(0, vals.size() / width, [&](const UL begin, const UL end){
+        for(UI c = 0; c < width; c++){
+            const double low = lows[c], inv_step = inv_steps[c];
+            #pragma omp simd
+            for(UL i = begin; i < end; i++){
+                codes[width*i + c] = (uint16_t) fmin(max_code, (vals[width*i + c] - low) * inv_step + 0.5);
+            }
+        }
+    });
+}
+
+
+// one multiply-add per value, the loop over the vertices of a component vectorizes
+static void decode(const vector<uint16_t>& codes, const UI width, const double* lows, const double* steps, vector<double>& vals)
+{
+    vals.resize(codes.size());
+    if(codes.empty()) return;
+    Utility::parallel_for(0, codes.size() / width, [&](const UL begin, const UL end){
+        for(UI c = 0; c < width; c++){
+            const double low = lows[c], step = steps[c];
+            #pragma omp simd
+            for(UL i = begin; i < end; i++) vals[width*i + c] = low + step * codes[width*i + c];
+        }
+    });
+}
+
+
+QuantizedFrame::QuantizedFrame(const FrameFields* ff)
+{
+    for(unsigned char c = 0; c < 7; c++){
+        this->lows[c] = 0.;
+        this->steps[c] = 0.;
+    }
+    encode(ff->vels, 3, this->lows, this->steps, this->vels);
+    encode(ff->vors, 3, this->lows + 3, this->steps + 3, this->vors);
+    encode(ff->mus, 1, this->lows + 6, this->steps + 6, this->mus);
+}
+
+
+// fill the raw arrays of ff, a field that wasn't in the frame stays empty
+void QuantizedFrame::decode(FrameFields* ff) const
+{
+    ::decode(this->vels, 3, this->lows, this->steps, ff->vels);
+    ::decode(this->vors, 3, this->lows + 3, this->steps + 3, ff->vors);
+    ::decode(this->mus, 1, this->lows + 6, this->steps + 6, ff->mus);
+}
+
+
+UL QuantizedFrame::num_bytes() const
+{
+    return (this->vels.capacity() + this->vors.capacity() + this->mus.capacity()) * sizeof(uint16_t);
+}
@@ -0,0 +1,37 @@
+#ifndef QUANTIZEDFRAME_H
+#define QUANTIZEDFRAME_H
+
+#include <vector>
+#include <cstdint>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class FrameFields;
+
+// the raw data of one frame in 16 bits per value, a quarter of the doubles of FrameFields
+// every component (velocity x, y, z, vorticity x, y, z and mu) of the frame is quantized on its own range:
+// value = low + step * code with step = (max - min) / 65535, so a decoded value is at most step / 2 off,
+// 7.6e-6 of the range of the component in that frame. a component that is constant in a frame is exact
+class QuantizedFrame{
+public:
+    double lows[7];
+    double steps[7];
+    vector<uint16_t> vels;  // 3 codes per vertex, empty if the frame has no velocity
+    vector<uint16_t> vors;  // 3 codes per vertex, empty if the frame has no vorticity
+    vector<uint16_t> mus;   // 1 code per vertex, empty if the frame has no mu
+
+    QuantizedFrame(const FrameFields* ff);
+
+    void decode(FrameFields* ff) const;
+    double max_error(const unsigned char component) const;
+    UL num_bytes() const;
+};
+
+
+inline double QuantizedFrame::max_error(const unsigned char component) const
+{
+    return this->steps[component] / 2.;
+}
+
+#endif // QUANTIZEDFRAME_H
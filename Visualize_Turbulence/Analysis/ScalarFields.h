@@ -0,0 +1,323 @@
+#ifndef SCALARFIELDS_H
+#define SCALARFIELDS_H
+
+#include <math.h>
+#include <QString>
+#include <QStringList>
+#include "Others/Predefined.h"
+
+// scalar fields that can be isosurfaced or used for coloring
+enum ScalarFieldType : unsigned char {
+    FIELD_VEL_MAG = 0,  // |velocity|
+    FIELD_VOR_MAG,      // |vorticity|
+    FIELD_MU,           // turbulent dynamic viscosity
+    FIELD_Q,            // Q-criterion, 0.5 * (|Omega|^2 - |S|^2)
+    FIELD_LAMBDA2,      // second eigenvalue of S^2 + Omega^2
+    FIELD_HELICITY,     // velocity dot vorticity
+    FIELD_FTLE,         // finite-time Lyapunov exponent, see Analysis/FTLE.h
+    NUM_SCALAR_FIELDS
+};
+
+
+// the columns of the data file, a bit set of them tells which ones a session reads, see loaded_fields
+enum RawField : unsigned char {
+    RAW_VELOCITY = 1,   // 3 columns per time step
+    RAW_VORTICITY = 2,  // 3 columns per time step
+    RAW_MU = 4,         // 1 column per time step
+    ALL_RAW_FIELDS = RAW_VELOCITY | RAW_VORTICITY | RAW_MU
+};
+
+
+// the raw fields a scalar field is computed from
+inline unsigned char raw_fields_of(const ScalarFieldType type)
+{
+    switch(type){
+    case FIELD_VOR_MAG: return RAW_VORTICITY;
+    case FIELD_MU: return RAW_MU;
+    case FIELD_HELICITY: return RAW_VELOCITY | RAW_VORTICITY;
+    default: return RAW_VELOCITY;
+    }
+}
+
+
+// values per vertex and time step of the raw fields in fields
+inline UI raw_field_width(const unsigned char fields)
+{
+    return (fields & RAW_VELOCITY ? 3 : 0) + (fields & RAW_VORTICITY ? 3 : 0) + (fields & RAW_MU ? 1 : 0);
+}
+
+
+// flat copies of the data at one time step
+// vertex arrays are indexed by Vertex::idx, tet arrays by Tet::idx
+// tet_grads is the constant velocity gradient J[i][j] = du_i/dx_j of each tet, stored row major,
+// 9 doubles per tet. It is null unless a field needs it.
+struct FrameInputs{
+    UL num_verts;
+    UL num_tets;
+    const double* vels; // 3 doubles per vertex
+    const double* vors; // 3 doubles per vertex
+    const double* mus;  // 1 double per vertex
+    const UL* tet_verts; // 4 vertex indices per tet
+    const double* tet_grads; // 9 doubles per tet
+};
+
+
+// eigenvalues of a symmetric 3x3 matrix, sorted in ascending order
+// m holds the upper triangle: m00, m01, m02, m11, m12, m22
+// https://en.wikipedia.org/wiki/Eigenvalue_algorithm#3%C3%973_matrices
+inline void sym3x3_eigenvalues(const double m[6], double eig[3])
+{
+    const double p1 = m[1]*m[1] + m[2]*m[2] + m[4]*m[4];
+    const double q = (m[0] + m[3] + m[5]) / 3.;
+    if(p1 == 0.){ // diagonal matrix
+        double a = m[0], b = m[3], c = m[5];
+        if(a > b) { const double t = a; a = b; b = t; }
+        if(b > c) { const double t = b; b = c; c = t; }
+        if(a > b) { const double t = a; a = b; b = t; }
+        eig[0] = a; eig[1] = b; eig[2] = c;
+        return;
+    }
+
+    const double d0 = m[0] - q, d1 = m[3] - q, d2 = m[5] - q;
+    const double p2 = d0*d0 + d1*d1 + d2*d2 + 2. * p1;
+    const double p = sqrt(p2 / 6.);
+    // B = (A - qI) / p, r = det(B) / 2
+    const double inv_p = 1. / p;
+    const double b00 = d0 * inv_p, b11 = d1 * inv_p, b22 = d2 * inv_p;
+    const double b01 = m[1] * inv_p, b02 = m[2] * inv_p, b12 = m[4] * inv_p;
+    const double det_b = b00 * (b11*b22 - b12*b12) - b01 * (b01*b22 - b12*b02) + b02 * (b01*b12 - b11*b02);
+    double r = det_b / 2.;
+    if(r < -1.) r = -1.;
+    if(r > 1.) r = 1.;
+    const double phi = acos(r) / 3.;
+
+    eig[2] = q + 2. * p * cos(phi);
+    eig[0] = q + 2. * p * cos(phi + (2. * PI / 3.));
+    eig[1] = 3. * q - eig[0] - eig[2];
+}
+
+
+// Q = 0.5 * (|Omega|^2 - |S|^2) = -0.5 * sum_ij J_ij * J_ji
+inline double q_criterion_of(const double J[9])
+{
+    double sum = 0.;
+    for(unsigned char i = 0; i < 3; i++){
+        for(unsigned char j = 0; j < 3; j++){
+            sum += J[i*3 + j] * J[j*3 + i];
+        }
+    }
+    return -0.5 * sum;
+}
+
+
+// vorticity is the curl of the velocity, w = (J21 - J12, J02 - J20, J10 - J01)
+inline void vorticity_of(const double J[9], double w[3])
+{
+    w[0] = J[7] - J[5];
+    w[1] = J[2] - J[6];
+    w[2] = J[3] - J[1];
+}
+
+
+// the middle eigenvalue of S^2 + Omega^2, S and Omega are the symmetric and antisymmetric parts of J
+inline double lambda2_of(const double J[9])
+{
+    double S[9], O[9];
+    for(unsigned char i = 0; i < 3; i++){
+        for(unsigned char j = 0; j < 3; j++){
+            S[i*3 + j] = 0.5 * (J[i*3 + j] + J[j*3 + i]);
+            O[i*3 + j] = 0.5 * (J[i*3 + j] - J[j*3 + i]);
+        }
+    }
+    // M = S*S + O*O is symmetric, only the upper triangle is needed
+    double M[6];
+    const unsigned char rows[6] = {0, 0, 0, 1, 1, 2};
+    const unsigned char cols[6] = {0, 1, 2, 1, 2, 2};
+    for(unsigned char k = 0; k < 6; k++){
+        const unsigned char i = rows[k], j = cols[k];
+        double val = 0.;
+        for(unsigned char l = 0; l < 3; l++){
+            val += S[i*3 + l] * S[l*3 + j] + O[i*3 + l] * O[l*3 + j];
+        }
+        M[k] = val;
+    }
+    double eig[3];
+    sym3x3_eigenvalues(M, eig);
+    return eig[1];
+}
+
+
+// lambda2 of n gradients at once, grads holds 9 doubles per item
+// the loops are branch free and work on structure-of-arrays blocks so the compiler can vectorize them
+inline void lambda2_batch(const double* grads, const UL n, double* out)
+{
+    const UL block = 64;
+    double m00[block], m01[block], m02[block], m11[block], m12[block], m22[block];
+
+    for(UL start = 0; start < n; start += block){
+        const UL count = n - start < block ? n - start : block;
+
+        // M = S*S + O*O = 0.5 * (J*J + J^T*J^T)
+        #pragma omp simd
+        for(UL k = 0; k < count; k++){
+            const double* J = grads + 9*(start + k);
+            double M[9];
+            for(unsigned char i = 0; i < 3; i++){
+                for(unsigned char j = 0; j < 3; j++){
+                    M[i*3 + j] = 0.5 * ( J[i*3]*J[j] + J[i*3+1]*J[3+j] + J[i*3+2]*J[6+j]
+                                       + J[i]*J[j*3] + J[3+i]*J[j*3+1] + J[6+i]*J[j*3+2] );
+                }
+            }
+            m00[k] = M[0]; m01[k] = M[1]; m02[k] = M[2];
+            m11[k] = M[4]; m12[k] = M[5]; m22[k] = M[8];
+        }
+
+        // middle eigenvalue, same closed form as sym3x3_eigenvalues without the diagonal special case
+        #pragma omp simd
+        for(UL k = 0; k < count; k++){
+            const double q = (m00[k] + m11[k] + m22[k]) / 3.;
+            const double p1 = m01[k]*m01[k] + m02[k]*m02[k] + m12[k]*m12[k];
+            const double d0 = m00[k] - q, d1 = m11[k] - q, d2 = m22[k] - q;
+            const double p2 = d0*d0 + d1*d1 + d2*d2 + 2. * p1;
+            const double p = sqrt(p2 / 6.) + 1e-300;
+            const double inv_p = 1. / p;
+            const double b00 = d0 * inv_p, b11 = d1 * inv_p, b22 = d2 * inv_p;
+            const double b01 = m01[k] * inv_p, b02 = m02[k] * inv_p, b12 = m12[k] * inv_p;
+            const double det_b = b00 * (b11*b22 - b12*b12) - b01 * (b01*b22 - b12*b02) + b02 * (b01*b12 - b11*b02);
+            const double r = fmin(1., fmax(-1., det_b / 2.));
+            const double phi = acos(r) / 3.;
+            const double eig_max = q + 2. * p * cos(phi);
+            const double eig_min = q + 2. * p * cos(phi + (2. * PI / 3.));
+            out[start + k] = 3. * q - eig_min - eig_max;
+        }
+    }
+}
+
+
+/* field selectors
+ * each selector is a functor evaluated at one vertex or one tet of the flat frame inputs.
+ * compute_scalar_field<Field> instantiates one inner loop per field, so there is no
+ * virtual call or map lookup per element.
+ * on_tets tells if the field is evaluated per tet, its vertex values are then averaged from the tets around it.
+*/
+struct VelMagField{
+    static constexpr ScalarFieldType type = FIELD_VEL_MAG;
+    static constexpr bool on_tets = false;
+    inline double operator()(const FrameInputs& in, const UL i) const {
+        const double* v = in.vels + 3*i;
+        return sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    }
+};
+
+struct VorMagField{
+    static constexpr ScalarFieldType type = FIELD_VOR_MAG;
+    static constexpr bool on_tets = false;
+    inline double operator()(const FrameInputs& in, const UL i) const {
+        const double* w = in.vors + 3*i;
+        return sqrt(w[0]*w[0] + w[1]*w[1] + w[2]*w[2]);
+    }
+};
+
+struct MuField{
+    static constexpr ScalarFieldType type = FIELD_MU;
+    static constexpr bool on_tets = false;
+    inline double operator()(const FrameInputs& in, const UL i) const {
+        return in.mus[i];
+    }
+};
+
+struct HelicityField{
+    static constexpr ScalarFieldType type = FIELD_HELICITY;
+    static constexpr bool on_tets = false;
+    inline double operator()(const FrameInputs& in, const UL i) const {
+        const double* v = in.vels + 3*i;
+        const double* w = in.vors + 3*i;
+        return v[0]*w[0] + v[1]*w[1] + v[2]*w[2];
+    }
+};
+
+struct QCriterionField{
+    static constexpr ScalarFieldType type = FIELD_Q;
+    static constexpr bool on_tets = true;
+    inline double operator()(const FrameInputs& in, const UL i) const {
+        return q_criterion_of(in.tet_grads + 9*i);
+    }
+};
+
+struct Lambda2Field{
+    static constexpr ScalarFieldType type = FIELD_LAMBDA2;
+    static constexpr bool on_tets = true;
+    inline double operator()(const FrameInputs& in, const UL i) const {
+        return lambda2_of(in.tet_grads + 9*i);
+    }
+};
+
+// helicity of a tet, velocity and vorticity are averaged from its 4 vertices
+struct TetHelicityField{
+    static constexpr ScalarFieldType type = FIELD_HELICITY;
+    static constexpr bool on_tets = true;
+    inline double operator()(const FrameInputs& in, const UL i) const {
+        double v[3] = {0., 0., 0.}, w[3] = {0., 0., 0.};
+        for(unsigned char k = 0; k < 4; k++){
+            const UL vert = in.tet_verts[4*i + k];
+            for(unsigned char j = 0; j < 3; j++){
+                v[j] += in.vels[3*vert + j];
+                w[j] += in.vors[3*vert + j];
+            }
+        }
+        return (v[0]*w[0] + v[1]*w[1] + v[2]*w[2]) / 16.;
+    }
+};
+
+
+// evaluate Field at the elements [begin, end), out is indexed by element
+template<class Field>
+inline void compute_scalar_field(const FrameInputs& in, double* out, const UL begin, const UL end)
+{
+    const Field field;
+    for(UL i = begin; i < end; i++){
+        out[i] = field(in, i);
+    }
+}
+
+
+// lambda2 goes through the batched eigenvalue code
+template<>
+inline void compute_scalar_field<Lambda2Field>(const FrameInputs& in, double* out, const UL begin, const UL end)
+{
+    if(end <= begin) return;
+    lambda2_batch(in.tet_grads + 9*begin, end - begin, out + begin);
+}
+
+
+// Q and lambda2 need the velocity gradient, so they are computed per tet
+inline bool field_on_tets(const ScalarFieldType type)
+{
+    return type == FIELD_Q || type == FIELD_LAMBDA2;
+}
+
+
+inline QString scalar_field_name(const ScalarFieldType type)
+{
+    switch(type){
+    case FIELD_VEL_MAG: return "velocity magnitude";
+    case FIELD_VOR_MAG: return "vorticity magnitude";
+    case FIELD_MU: return "turbulent dynamic viscosity";
+    case FIELD_Q: return "Q-criterion";
+    case FIELD_LAMBDA2: return "lambda2";
+    case FIELD_HELICITY: return "helicity";
+    case FIELD_FTLE: return "FTLE";
+    default: return "ERROR";
+    }
+}
+
+inline QString raw_field_names(const unsigned char fields)
+{
+    QStringList names;
+    if(fields & RAW_VELOCITY) names << "velocity";
+    if(fields & RAW_VORTICITY) names << "vorticity";
+    if(fields & RAW_MU) names << "mu";
+    return names.join(", ");
+}
+
+#endif // SCALARFIELDS_H
@@ -0,0 +1,391 @@
+#include "FileLoader/FrameCache.h"
+#include "FileLoader/FrameCodec.h"
+#include "Others/Utilities.h"
+#include "Others/Parallel.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+static const char frame_magic[8] = "VTFRAME";
+static const UL frame_header_size = sizeof(frame_magic) + 3 * sizeof(UI) + 2 * sizeof(UL);
+static const UL frame_chunk_bytes = 64UL << 20; // values of the data file buffered before they are scattered into the frames
+
+
+// values of a field in one frame, velocity and vorticity have 3 per vertex, mu has 1
+static inline UL part_values(const unsigned char part, const UL num_verts)
+{
+    return (part < 2 ? 3 : 1) * num_verts;
+}
+
+
+static inline UL num_blocks(const UL values)
+{
+    return (values + frame_block_values - 1) / frame_block_values;
+}
+
+
+static void write_header(QFile& file, const UI fields, const UI coding, const UL num_verts, const UL num_frames)
+{
+    file.write(frame_magic, sizeof(frame_magic));
+    file.write((const char*) &frame_cache_version, sizeof(UI));
+    file.write((const char*) &fields, sizeof(UI));
+    file.write((const char*) &coding, sizeof(UI));
+    file.write((const char*) &num_verts, sizeof(UL));
+    file.write((const char*) &num_frames, sizeof(UL));
+}
+
+
+QString frame_cache_path(const QByteArray& input_hash)
+{
+    if(input_hash.isEmpty()) return QString();
+    return product_cache_dir + QString::fromLatin1(input_hash.toHex()) + ".frames";
+}
+
+
+FrameCache::FrameCache(const QString& path)
+{
+    this->path = path;
+    this->fields = 0;
+    this->coding = FRAME_PLAIN;
+    this->num_verts = 0;
+    this->num_frames = 0;
+    for(unsigned char part = 0; part < 3; part++) this->chain_frame[part] = -1;
+    this->stats.frames = 0;
+    this->stats.decoded = 0;
+    this->stats.file_bytes = 0;
+    this->stats.raw_bytes = 0;
+    this->stats.read_secs = 0.;
+    this->stats.decode_secs = 0.;
+}
+
+
+FrameCache::~FrameCache()
+{
+    this->file.close();
+}
+
+
+// false if the file is missing, from another version, without a field of stored_fields or shorter than its header says
+bool FrameCache::open()
+{
+    lock_guard<mutex> guard(this->lock);
+    this->file.setFileName(this->path);
+    if(!this->file.open(QIODevice::ReadOnly)) return false;
+
+    char magic[sizeof(frame_magic)];
+    UI version = 0;
+    if(this->file.read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, frame_magic, sizeof(magic)) != 0) return false;
+    if(this->file.read((char*) &version, sizeof(UI)) != sizeof(UI) || version != frame_cache_version) return false;
+    UI fields = 0;
+    if(this->file.read((char*) &fields, sizeof(UI)) != sizeof(UI)) return false;
+    this->fields = fields & ALL_RAW_FIELDS;
+    if(this->file.read((char*) &this->coding, sizeof(UI)) != sizeof(UI)) return false;
+    if(this->file.read((char*) &this->num_verts, sizeof(UL)) != sizeof(UL)) return false;
+    if(this->file.read((char*) &this->num_frames, sizeof(UL)) != sizeof(UL)) return false;
+
+    bool whole = false;
+    if(this->coding == FRAME_PLAIN){
+        whole = (UL) this->file.size() == frame_header_size + this->num_frames * this->frame_bytes();
+    }
+    else if(this->coding == FRAME_PACKED){
+        this->offsets.resize(this->num_frames + 1);
+        const qint64 bytes = this->offsets.size() * sizeof(UL);
+        whole = this->file.read((char*) this->offsets.data(), bytes) == bytes && this->offsets.back() == (UL) this->file.size()
+                && is_sorted(this->offsets.begin(), this->offsets.end()) && this->offsets[0] == frame_header_size + bytes;
+    }
+    else return false;
+    if(!whole){
+        qDebug() << "Frame cache:" << this->path << "is truncated";
+        return false;
+    }
+    if((this->fields & stored_fields) != stored_fields){
+        qDebug() << "Frame cache:" << this->path << "only has" << raw_field_names(this->fields);
+        return false;
+    }
+    return true;
+}
+
+
+// read the raw values of one time step into arrays of 3n, 3n and n doubles, a field whose array is NULL is skipped
+bool FrameCache::read_frame(const UL frame, double* vels, double* vors, double* mus)
+{
+    if(frame >= this->num_frames) return false;
+    const UL n = this->num_verts;
+    double* parts[3] = {vels, vors, mus};
+    lock_guard<mutex> guard(this->lock);
+    qint64 offset = frame_header_size + frame * this->frame_bytes();
+    for(unsigned char part = 0; part < 3; part++){
+        const bool stored = this->fields & (1 << part);
+        if(!stored && parts[part] != NULL) return false;
+        if(!stored) continue;
+
+        if(this->coding == FRAME_PACKED){
+            if(parts[part] != NULL && !this->read_packed(frame, part, parts[part])) return false;
+            continue;
+        }
+        const qint64 bytes = part_values(part, n) * sizeof(double);
+        if(parts[part] != NULL){
+            if(!this->file.seek(offset) || this->file.read((char*) parts[part], bytes) != bytes) return false;
+        }
+        offset += bytes;
+    }
+
+    if(this->coding == FRAME_PACKED && ++this->stats.frames % 100 == 0){
+        const FrameReadStats& c = this->stats;
+        // frames served from memory neither read nor decode anything
+        qDebug() << "Frame cache:" << c.frames << "frames read," << c.decoded << "decoded,"
+                 << (c.read_secs > 0 ? c.file_bytes / 1e6 / c.read_secs : 0.) << "MB/s read from disk,"
+                 << (c.decode_secs > 0 ? c.raw_bytes / 1e6 / c.decode_secs : 0.) << "MB/s decoded,"
+                 << (c.file_bytes > 0 ? (double) c.raw_bytes / c.file_bytes : 0.) << "times smaller on disk";
+    }
+    return true;
+}
+
+
+// decode a field of a packed frame into vals, from the key frame before it or from the last frame of the field
+// decoded if that is between them
+bool FrameCache::read_packed(const UL frame, const unsigned char part, double* vals)
+{
+    const UL key = frame - frame % frame_key_interval;
+    vector<double>& last = this->chain[part];
+    long& last_frame = this->chain_frame[part];
+    UL first = key;
+    if(last_frame >= (long) key && last_frame <= (long) frame) first = last_frame + 1;
+    last.resize(part_values(part, this->num_verts));
+
+    for(UL f = first; f <= frame; f++){
+        if(!this->decode_packed(f, part, last.data(), f != key)){
+            last_frame = -1;
+            qDebug() << "Frame cache: frame" << f << "of" << this->path << "is corrupt";
+            return false;
+        }
+        this->stats.decoded++;
+    }
+    last_frame = frame;
+    memcpy(vals, last.data(), last.size() * sizeof(double));
+    return true;
+}
+
+
+// the blocks of a field are read at once and decoded in parallel, each on its own
+bool FrameCache::decode_packed(const UL frame, const unsigned char part, double* vals, const bool delta)
+{
+    QElapsedTimer timer;
+    timer.start();
+    UL first_block = 0, frame_blocks = 0;
+    for(unsigned char p = 0; p < 3; p++){
+        if(!(this->fields & (1 << p))) continue;
+        if(p < part) first_block += num_blocks(part_values(p, this->num_verts));
+        frame_blocks += num_blocks(part_values(p, this->num_verts));
+    }
+    const UL values = part_values(part, this->num_verts);
+    const UL blocks = num_blocks(values);
+
+    vector<UL> sizes(frame_blocks);
+    const qint64 table_bytes = frame_blocks * sizeof(UL);
+    if(!this->file.seek(this->offsets[frame]) || this->file.read((char*) sizes.data(), table_bytes) != table_bytes) return false;
+    vector<UL> starts(blocks + 1, 0); // of the blocks of the field in bytes
+    UL skip = 0;
+    for(UL b = 0; b < first_block; b++) skip += sizes[b];
+    for(UL b = 0; b < blocks; b++) starts[b + 1] = starts[b] + sizes[first_block + b];
+    const UL start = this->offsets[frame] + table_bytes + skip;
+    if(start + starts[blocks] > this->offsets[frame + 1]) return false;
+
+    vector<unsigned char> packed(starts[blocks]);
+    if(!this->file.seek(start) || this->file.read((char*) packed.data(), packed.size()) != (qint64) packed.size()) return false;
+    this->stats.read_secs += timer.nsecsElapsed() / 1e9;
+    this->stats.file_bytes += table_bytes + packed.size();
+
+    timer.restart();
+    atomic<bool> ok(true);
+    Utility::parallel_for(0, blocks, [&](const UL begin, const UL end){
+        for(UL b = begin; b < end && ok; b++){
+            const UL first = b * frame_block_values;
+            const UL count = min(frame_block_values, values - first);
+            if(!decode_frame_block(packed.data() + starts[b], starts[b + 1] - starts[b], vals + first, count, delta)) ok = false;
+        }
+    }, 1);
+    this->stats.decode_secs += timer.nsecsElapsed() / 1e9;
+    this->stats.raw_bytes += values * sizeof(double);
+    return ok;
+}
+
+
+FrameCacheWriter::FrameCacheWriter()
+{
+    this->fields = 0;
+    this->width = 0;
+    this->num_verts = 0;
+    this->num_frames = 0;
+    this->chunk_first = 0;
+    this->chunk_size = 0;
+    this->chunk_capacity = 0;
+    this->ok = false;
+}
+
+
+FrameCacheWriter::~FrameCacheWriter()
+{
+    if(this->file.isOpen()){
+        this->file.close();
+        this->file.remove();
+    }
+}
+
+
+// the file is written next to path and only renamed to it by finish(), a crash never leaves half a cache behind
+bool FrameCacheWriter::begin(const QString& path, const UL num_verts, const UL num_frames, const unsigned char fields)
+{
+    if(path.isEmpty() || num_verts == 0 || num_frames == 0 || raw_field_width(fields) == 0) return false;
+    if(!QDir().mkpath(product_cache_dir)){
+        qDebug() << "Frame cache: couldn't create" << product_cache_dir;
+        return false;
+    }
+
+    this->path = path;
+    this->fields = fields;
+    this->width = raw_field_width(fields);
+    this->num_verts = num_verts;
+    this->num_frames = num_frames;
+    this->file.setFileName(path + ".part");
+    if(!this->file.open(QIODevice::ReadWrite | QIODevice::Truncate)) return false;
+
+    write_header(this->file, fields, FRAME_PLAIN, num_verts, num_frames);
+    this->ok = this->file.resize(frame_header_size + num_frames * this->width * num_verts * sizeof(double));
+
+    this->chunk_capacity = max(1UL, frame_chunk_bytes / (this->width * num_frames * sizeof(double)));
+    this->chunk.resize(this->chunk_capacity * this->width * num_frames);
+    this->scratch.resize(3 * this->chunk_capacity);
+    this->chunk_first = 0;
+    this->chunk_size = 0;
+    return this->ok;
+}
+
+
+// where the width values of every frame of the next vertex go, the fields of frame i start at width*i
+// in the order velocity, vorticity, mu, without the ones that aren't written
+double* FrameCacheWriter::next_vert()
+{
+    if(this->chunk_size == this->chunk_capacity) this->flush();
+    return this->chunk.data() + (this->chunk_size++) * this->width * this->num_frames;
+}
+
+
+void FrameCacheWriter::write_at(const UL offset, const double* vals, const UL n)
+{
+    if(!this->ok) return;
+    const qint64 bytes = n * sizeof(double);
+    this->ok = this->file.seek(offset) && this->file.write((const char*) vals, bytes) == bytes;
+}
+
+
+// scatter the buffered vertices into every frame, one write per field and frame
+void FrameCacheWriter::flush()
+{
+    const UL n = this->num_verts;
+    const UL first = this->chunk_first;
+    const UL count = this->chunk_size;
+    for(UL f = 0; f < this->num_frames && this->ok; f++){
+        const UL frame_offset = frame_header_size + f * this->width * n * sizeof(double);
+        UL col = 0; // values of the fields before this one, per vertex
+        for(unsigned char part = 0; part < 3; part++){
+            if(!(this->fields & (1 << part))) continue;
+            // velocity and vorticity have 3 values per vertex, mu has 1
+            const UL width = part < 2 ? 3 : 1;
+            for(UL i = 0; i < count; i++){
+                const double* vals = this->chunk.data() + (i * this->num_frames + f) * this->width + col;
+                for(UL k = 0; k < width; k++) this->scratch[width * i + k] = vals[k];
+            }
+            this->write_at(frame_offset + (n * col + width * first) * sizeof(double), this->scratch.data(), width * count);
+            col += width;
+        }
+    }
+    this->chunk_first += count;
+    this->chunk_size = 0;
+}
+
+
+// false if a write failed or fewer vertices than num_verts were written, nothing is left on disk then
+bool FrameCacheWriter::finish()
+{
+    this->flush();
+    if(this->chunk_first != this->num_verts) this->ok = false;
+    if(!this->ok) return false;
+
+    QFile packed(this->path + ".packed.part");
+    QFile* done = &this->file;
+    if(compress_frame_cache){
+        if(!this->pack(packed)){
+            packed.close();
+            packed.remove();
+            return false;
+        }
+        this->file.close();
+        this->file.remove();
+        done = &packed;
+    }
+
+    done->close();
+    QFile::remove(this->path);
+    if(!done->rename(this->path)){
+        done->remove();
+        return false;
+    }
+    qDebug() << "Frame cache: wrote" << this->num_frames << "frames to" << this->path;
+    return true;
+}
+
+
+// code the frames of the plain file into out one after the other, the blocks of a frame in parallel
+bool FrameCacheWriter::pack(QFile& out)
+{
+    QElapsedTimer timer;
+    timer.start();
+    if(!out.open(QIODevice::ReadWrite | QIODevice::Truncate)) return false;
+    write_header(out, this->fields, FRAME_PACKED, this->num_verts, this->num_frames);
+    vector<UL> offsets(this->num_frames + 1, 0);
+    const qint64 table_bytes = offsets.size() * sizeof(UL);
+    if(out.write((const char*) offsets.data(), table_bytes) != table_bytes) return false;
+
+    // the blocks of a frame, as first value and number of values in the frame, of the fields in their order
+    vector<pair<UL, UL>> blocks;
+    UL first = 0;
+    for(unsigned char part = 0; part < 3; part++){
+        if(!(this->fields & (1 << part))) continue;
+        const UL values = part_values(part, this->num_verts);
+        for(UL b = 0; b < num_blocks(values); b++) blocks.push_back(make_pair(first + b * frame_block_values, min(frame_block_values, values - b * frame_block_values)));
+        first += values;
+    }
+
+    const qint64 frame_bytes = first * sizeof(double);
+    vector<double> cur(first), prev(first);
+    vector<vector<unsigned char>> coded(blocks.size());
+    vector<UL> sizes(blocks.size());
+    for(UL f = 0; f < this->num_frames; f++){
+        if(!this->file.seek(frame_header_size + f * frame_bytes) || this->file.read((char*) cur.data(), frame_bytes) != frame_bytes) return false;
+        const bool key = f % frame_key_interval == 0;
+        Utility::parallel_for(0, blocks.size(), [&](const UL begin, const UL end){
+            for(UL b = begin; b < end; b++){
+                const UL at = blocks[b].first;
+                encode_frame_block(cur.data() + at, key ? NULL : prev.data() + at, blocks[b].second, coded[b]);
+            }
+        }, 1);
+
+        offsets[f] = out.pos();
+        for(UL b = 0; b < blocks.size(); b++) sizes[b] = coded[b].size();
+        const qint64 sizes_bytes = sizes.size() * sizeof(UL);
+        if(out.write((const char*) sizes.data(), sizes_bytes) != sizes_bytes) return false;
+        for(const vector<unsigned char>& block : coded){
+            if(out.write((const char*) block.data(), block.size()) != (qint64) block.size()) return false;
+        }
+        cur.swap(prev);
+    }
+    offsets[this->num_frames] = out.pos();
+    if(!out.seek(frame_header_size) || out.write((const char*) offsets.data(), table_bytes) != table_bytes) return false;
+
+    qDebug() << "Frame cache: packed" << this->num_frames * frame_bytes / 1e6 << "MB of frames into" << out.size() / 1e6
+             << "MB in" << timer.elapsed() / 1000. << "secs";
+    return true;
+}
@@ -0,0 +1,116 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <vector>
+#include <mutex>
+#include "Others/Predefined.h"
+#include "Analysis/ScalarFields.h"
+
+using namespace std;
+
+// the raw field data of a data file in one binary file per input, so a single time step can be read on its own
+// it is kept in product_cache_dir under the SHA-1 of the input files and written once, the first time they are read
+// the file is the magic "VTFRAME", a UI version, a UI set of RawFields it holds, a UI FrameCoding, a UL num_verts,
+// a UL num_frames, then the raw frames in order. a frame is 3 velocity doubles per vertex, 3 vorticity doubles per
+// vertex and 1 mu double per vertex, of the fields it holds. it is written with the stored_fields of the session that
+// parsed the data file and is a miss for a session that needs more
+// FRAME_PLAIN frames follow the header as they are. FRAME_PACKED frames follow a table of num_frames + 1 UL offsets
+// in the file, the last one is the end of the file. every field of a frame is split into blocks of frame_block_values
+// values, a frame is the UL sizes of its blocks then the blocks, each coded by encode_frame_block
+// (FileLoader/FrameCodec.h) against the same values of the frame before. every frame_key_interval-th frame is coded
+// on its own, so reading a frame never decodes more than frame_key_interval frames
+// all numbers are in the byte order of the machine that wrote it
+static const UI frame_cache_version = 3;
+static const UL frame_block_values = 1UL << 16;
+static const UL frame_key_interval = 8;
+
+enum FrameCoding {FRAME_PLAIN = 0, FRAME_PACKED = 1};
+
+QString frame_cache_path(const QByteArray& input_hash);
+
+
+// how much reading packed frames took, logged every 100 frames
+struct FrameReadStats{
+    UL frames;          // frames asked for
+    UL decoded;         // frames decoded for them, more than frames if they were out of order
+    UL file_bytes;      // bytes read from the file
+    UL raw_bytes;       // bytes of doubles decoded from them
+    double read_secs;
+    double decode_secs;
+};
+
+
+// reads one frame at a time, the file stays open while the cache exists
+// of a packed file the last frame decoded of every field is kept, so frames read in order decode one frame each
+class FrameCache{
+public:
+    QString path;
+    unsigned char fields;
+    UI coding;
+    UL num_verts;
+    UL num_frames;
+
+    FrameCache(const QString& path);
+    ~FrameCache();
+
+    bool open();
+    bool read_frame(const UL frame, double* vels, double* vors, double* mus);
+    inline UL frame_bytes() const;
+
+private:
+    QFile file;
+    mutex lock; // frames may be read from several threads
+
+    // of a packed file, guarded by lock
+    vector<UL> offsets;
+    vector<double> chain[3];    // the values of a field in frame chain_frame[field], -1 if none
+    long chain_frame[3];
+    FrameReadStats stats;
+
+    bool read_packed(const UL frame, const unsigned char part, double* vals);
+    bool decode_packed(const UL frame, const unsigned char part, double* vals, const bool delta);
+};
+
+
+inline UL FrameCache::frame_bytes() const
+{
+    return raw_field_width(this->fields) * this->num_verts * sizeof(double);
+}
+
+
+// writes the frame file while the text data file is parsed vertex by vertex
+// the values of a vertex are gathered in chunks and scattered into the frames when a chunk is full,
+// so neither the whole data set nor a whole frame has to be in memory
+// with compress_frame_cache the plain file is packed frame by frame into another one when it is finished
+class FrameCacheWriter{
+public:
+    FrameCacheWriter();
+    ~FrameCacheWriter(); // a file that isn't finished is removed
+
+    bool begin(const QString& path, const UL num_verts, const UL num_frames, const unsigned char fields);
+    double* next_vert();
+    bool finish();
+
+private:
+    QString path;
+    QFile file;
+    unsigned char fields;
+    UI width;           // values per vertex and frame
+    UL num_verts;
+    UL num_frames;
+    UL chunk_first;     // the first vertex in chunk
+    UL chunk_size;      // vertices in chunk
+    UL chunk_capacity;
+    vector<double> chunk; // width values per frame per vertex, in the order of the data file
+    vector<double> scratch;
+    bool ok;
+
+    void flush();
+    void write_at(const UL offset, const double* vals, const UL n);
+    bool pack(QFile& out);
+};
+
+#endif // FRAMECACHE_H
@@ -0,0 +1,146 @@
+#include "FileLoader/FrameCodec.h"
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <algorithm>
+
+static const UI hash_bits = 14;
+static const UL min_match = 4;
+static const UL max_offset = 65535;
+
+
+static inline uint32_t read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+
+// a count that doesn't fit into its 4 bits of the token goes on in bytes of 255
+static inline void put_count(vector<unsigned char>& out, UL count)
+{
+    while(count >= 255){
+        out.push_back(255);
+        count -= 255;
+    }
+    out.push_back((unsigned char) count);
+}
+
+
+static inline bool get_count(const unsigned char* in, const UL size, UL& ip, UL& count)
+{
+    unsigned char b;
+    do{
+        if(ip >= size) return false;
+        b = in[ip++];
+        count += b;
+    } while(b == 255);
+    return true;
+}
+
+
+// one sequence, match_len is 0 for the last one
+static void put_sequence(vector<unsigned char>& out, const unsigned char* lits, const UL num_lits, const UL offset, const UL match_len)
+{
+    const UL len_code = match_len > 0 ? match_len - min_match : 0;
+    out.push_back((unsigned char) (((num_lits < 15 ? num_lits : 15) << 4) | (len_code < 15 ? len_code : 15)));
+    if(num_lits >= 15) put_count(out, num_lits - 15);
+    out.insert(out.end(), lits, lits + num_lits);
+    if(match_len == 0) return;
+    out.push_back((unsigned char) (offset & 0xff));
+    out.push_back((unsigned char) (offset >> 8));
+    if(len_code >= 15) put_count(out, len_code - 15);
+}
+
+
+static void lz_compress(const unsigned char* src, const UL n, vector<unsigned char>& out)
+{
+    out.clear();
+    out.reserve(n / 2 + 16);
+    vector<UL> table(1UL << hash_bits, ULONG_MAX);
+    UL anchor = 0, i = 0;
+    while(i + min_match <= n){
+        const uint32_t seq = read32(src + i);
+        const UL h = (seq * 2654435761u) >> (32 - hash_bits);
+        const UL cand = table[h];
+        table[h] = i;
+        if(cand == ULONG_MAX || i - cand > max_offset || read32(src + cand) != seq){
+            i++;
+            continue;
+        }
+        UL len = min_match;
+        while(i + len < n && src[cand + len] == src[i + len]) len++;
+        put_sequence(out, src + anchor, i - anchor, i - cand, len);
+        i += len;
+        anchor = i;
+    }
+    put_sequence(out, src + anchor, n - anchor, 0, 0);
+}
+
+
+static bool lz_decompress(const unsigned char* in, const UL size, unsigned char* dst, const UL dst_size)
+{
+    UL ip = 0, op = 0;
+    while(ip < size){
+        const unsigned char token = in[ip++];
+        UL num_lits = token >> 4;
+        if(num_lits == 15 && !get_count(in, size, ip, num_lits)) return false;
+        if(num_lits > size - ip || num_lits > dst_size - op) return false;
+        memcpy(dst + op, in + ip, num_lits);
+        ip += num_lits;
+        op += num_lits;
+        if(ip == size) break;
+
+        if(size - ip < 2) return false;
+        const UL offset = in[ip] | (in[ip + 1] << 8);
+        ip += 2;
+        UL len = token & 15;
+        if(len == 15 && !get_count(in, size, ip, len)) return false;
+        len += min_match;
+        if(offset == 0 || offset > op || len > dst_size - op) return false;
+        // a match may overlap what it copies, runs of zeros are matches at offset 1. what is copied repeats every
+        // offset bytes, so it is copied in pieces that double, each from the start of the match
+        for(UL copied = 0; copied < len;){
+            const UL piece = min(copied + offset, len - copied);
+            memcpy(dst + op + copied, dst + op - offset, piece);
+            copied += piece;
+        }
+        op += len;
+    }
+    return op == dst_size;
+}
+
+
+// the shuffle goes one plane at a time so both sides are read and written in order
+void encode_frame_block(const double* vals, const double* prev, const UL n, vector<unsigned char>& out)
+{
+    vector<uint64_t> bits(n);
+    memcpy(bits.data(), vals, n * sizeof(double));
+    if(prev != NULL){
+        vector<uint64_t> prev_bits(n);
+        memcpy(prev_bits.data(), prev, n * sizeof(double));
+        for(UL i = 0; i < n; i++) bits[i] ^= prev_bits[i];
+    }
+    vector<unsigned char> planes(8 * n);
+    for(unsigned char k = 0; k < 8; k++){
+        unsigned char* plane = planes.data() + k * n;
+        for(UL i = 0; i < n; i++) plane[i] = (unsigned char) (bits[i] >> (8 * k));
+    }
+    lz_compress(planes.data(), planes.size(), out);
+}
+
+
+bool decode_frame_block(const unsigned char* in, const UL size, double* vals, const UL n, const bool delta)
+{
+    vector<unsigned char> planes(8 * n);
+    if(!lz_decompress(in, size, planes.data(), planes.size())) return false;
+    vector<uint64_t> bits(n, 0);
+    if(delta) memcpy(bits.data(), vals, n * sizeof(double));
+    for(unsigned char k = 0; k < 8; k++){
+        const unsigned char* plane = planes.data() + k * n;
+        for(UL i = 0; i < n; i++) bits[i] ^= (uint64_t) plane[i] << (8 * k);
+    }
+    memcpy(vals, bits.data(), n * sizeof(double));
+    return true;
+}
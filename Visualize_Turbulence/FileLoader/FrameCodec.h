@@ -0,0 +1,20 @@
+#ifndef FRAMECODEC_H
+#define FRAMECODEC_H
+
+#include <vector>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+// lossless coding of a block of doubles of the frame file
+// every value is XORed with the value at the same place in the frame before, so values that change little become
+// mostly zero bits, then byte k of every value is put into plane k and the planes are compressed with a small LZ77
+// coder in the spirit of LZ4: a token byte with 4 bits of literal count and 4 bits of match length, the literals,
+// a 2 byte offset and the bytes the counts don't fit into, 255 at a time. the last sequence has no match
+void encode_frame_block(const double* vals, const double* prev, const UL n, vector<unsigned char>& out);
+
+// vals holds the values of the frame before if delta is true, it is overwritten with the decoded ones
+// false if the block is corrupt
+bool decode_frame_block(const unsigned char* in, const UL size, double* vals, const UL n, const bool delta);
+
+#endif // FRAMECODEC_H
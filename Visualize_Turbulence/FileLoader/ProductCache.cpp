@@ -0,0 +1,532 @@
+#include "FileLoader/ProductCache.h"
+#include "Others/Utilities.h"
+#include "Geometry/Mesh.h"
+#include "Surfaces/Isosurface.h"
+#include "Lines/StreamLine.h"
+#include "Analysis/ECG.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+static const char cache_magic[8] = "VTCACHE";
+
+
+// appends raw values to a buffer that is written in one go
+class CacheWriter{
+public:
+    QByteArray buf;
+
+    template<class T>
+    inline void put(const T& val);
+    void put_vert(const Vertex* vert, const double time);
+    void put_streamline(const StreamLine* sl);
+};
+
+
+// reads the values back in the order they were put, ok turns false once the data runs out
+class CacheReader{
+public:
+    const char* cur;
+    const char* end;
+    bool ok;
+
+    CacheReader(const QByteArray& data);
+
+    template<class T>
+    inline T get();
+    Vertex* get_vert(Mesh* mesh, const double time);
+    StreamLine* get_streamline(Mesh* mesh);
+};
+
+
+template<class T>
+inline void CacheWriter::put(const T& val)
+{
+    this->buf.append((const char*) &val, sizeof(T));
+}
+
+
+// position, velocity at time and the tet the vertex was found in, -1 if none
+void CacheWriter::put_vert(const Vertex* vert, const double time)
+{
+    const Vector3d* vel = NULL;
+    auto it = vert->vels.find(time);
+    if(it != vert->vels.end()) vel = it->second;
+    else if(!vert->vels.empty()) vel = vert->vels.begin()->second;
+
+    for(unsigned char d = 0; d < 3; d++) this->put(vert->cords.entry[d]);
+    for(unsigned char d = 0; d < 3; d++) this->put(vel != NULL ? vel->entry[d] : 0.);
+    this->put(vert->num_tets() > 0 ? (long) vert->tets[0]->idx : -1L);
+}
+
+
+void CacheWriter::put_streamline(const StreamLine* sl)
+{
+    this->put(sl->time);
+    this->put_vert(sl->seed, sl->time);
+    this->put((UL) sl->num_fw_verts());
+    for(const Vertex* vert : sl->fw_verts) this->put_vert(vert, sl->time);
+    this->put((UL) sl->num_bw_verts());
+    for(const Vertex* vert : sl->bw_verts) this->put_vert(vert, sl->time);
+}
+
+
+CacheReader::CacheReader(const QByteArray& data)
+{
+    this->cur = data.constData();
+    this->end = this->cur + data.size();
+    this->ok = true;
+}
+
+
+template<class T>
+inline T CacheReader::get()
+{
+    T val;
+    if(!this->ok || this->cur + sizeof(T) > this->end){
+        this->ok = false;
+        memset(&val, 0, sizeof(T));
+        return val;
+    }
+    memcpy(&val, this->cur, sizeof(T));
+    this->cur += sizeof(T);
+    return val;
+}
+
+
+Vertex* CacheReader::get_vert(Mesh* mesh, const double time)
+{
+    double v[6];
+    for(unsigned char d = 0; d < 6; d++) v[d] = this->get<double>();
+    const long tet_idx = this->get<long>();
+
+    Vertex* vert = new Vertex(v[0], v[1], v[2]);
+    vert->set_vel(time, v[3], v[4], v[5]);
+    if(tet_idx >= 0 && (UL) tet_idx < mesh->num_tets()) vert->add_tet(mesh->tets[tet_idx]);
+    else if(tet_idx >= 0) this->ok = false;
+    return vert;
+}
+
+
+StreamLine* CacheReader::get_streamline(Mesh* mesh)
+{
+    const double time = this->get<double>();
+    StreamLine* sl = new StreamLine(this->get_vert(mesh, time), time);
+    const UL num_fw = this->get<UL>();
+    for(UL i = 0; i < num_fw && this->ok; i++) sl->add_fw_vert(this->get_vert(mesh, time));
+    const UL num_bw = this->get<UL>();
+    for(UL i = 0; i < num_bw && this->ok; i++) sl->add_bw_vert(this->get_vert(mesh, time));
+    return sl;
+}
+
+
+// hash of the mesh file digest, see hash_mesh_file(), and the contents of the data file
+// the data file is read in blocks so the memory use stays flat
+QByteArray hash_input_files(const QByteArray& mesh_hash, const QString& data_path)
+{
+    if(mesh_hash.isEmpty()) return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(mesh_hash);
+    QFile file(data_path);
+    if(!file.open(QIODevice::ReadOnly)) return QByteArray();
+    hash.addData(&file);
+    return hash.result();
+}
+
+
+// hash of the contents of the mesh file alone, datasets with the same one can share their topology
+QByteArray hash_mesh_file(const QString& mesh_path)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QFile file(mesh_path);
+    if(!file.open(QIODevice::ReadOnly)) return QByteArray();
+    hash.addData(&file);
+    return hash.result();
+}
+
+
+// the parameters a product depends on, every one that changes the result must be here
+static QByteArray product_params(const Mesh* mesh, const CachedProduct product)
+{
+    CacheWriter w;
+    w.put(product_cache_version);
+    w.put(product);
+    w.put(mesh->num_time_steps);
+    w.put(time_step_size);
+    w.put(quantize_frames); // every product is computed from the decoded velocity and vorticity
+    w.put(derive_vorticity); // changes the vorticity magnitude isosurfaces and importance seeding are built on
+    w.put(loaded_fields); // a field that isn't read is 0 wherever it is used
+
+    switch(product){
+    case CACHED_ISOSURFACES:
+        w.put(isosurface_field);
+        w.put(surface_level_ratio);
+        break;
+    case CACHED_ECGS:
+        w.put(max_num_recursion);
+        w.put(zero_threshold);
+        w.put(show_ECG_connections); // decides which construction streamlines are kept
+        [[fallthrough]];
+    case CACHED_STREAMLINES:
+        w.put(NUM_SEEDS);
+        w.put(max_num_steps);
+        w.put(dist_step_size);
+        w.put(stagnation_speed_ratio);
+        w.put(max_streamline_arc_length);
+        w.put(cycle_window);
+        w.put(rng_seed);
+        break;
+    }
+
+    if(product == CACHED_STREAMLINES){
+        w.put(tracing_streamlines_from_seed);
+        w.put(streamline_seeding);
+        w.put(seed_importance);
+        w.put(seed_importance_falloff);
+        w.put(evenly_spaced_separation);
+        w.put(evenly_spaced_test_ratio);
+        w.put(max_evenly_spaced_seeds);
+    }
+    return w.buf;
+}
+
+
+// empty if the input files couldn't be hashed, nothing is cached then
+QString product_cache_path(const Mesh* mesh, const CachedProduct product)
+{
+    if(!use_product_cache || mesh->input_hash.isEmpty()) return QString();
+    QCryptographicHash key(QCryptographicHash::Sha1);
+    key.addData(mesh->input_hash);
+    key.addData(product_params(mesh, product));
+    return product_cache_dir + QString::fromLatin1(key.result().toHex()) + ".bin";
+}
+
+
+// the frame times of a per-time product, sorted
+template<class Map>
+static vector<double> sorted_times(const Map& map)
+{
+    vector<double> times;
+    times.reserve(map.size());
+    for(const auto& pair : map) times.push_back(pair.first);
+    sort(times.begin(), times.end());
+    return times;
+}
+
+
+static void write_product(const QString& path, const CachedProduct product, const CacheWriter& w)
+{
+    if(path.isEmpty() || QFile::exists(path)) return;
+    if(!QDir().mkpath(product_cache_dir)){
+        qDebug() << "Product cache: couldn't create" << product_cache_dir;
+        return;
+    }
+
+    // written to a temporary file and renamed, a crash never leaves half a product behind
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly)) return;
+    file.write(cache_magic, sizeof(cache_magic));
+    file.write((const char*) &product_cache_version, sizeof(UI));
+    file.write((const char*) &product, sizeof(UI));
+    file.write(w.buf);
+    if(file.commit()) qDebug() << "Product cache: saved" << w.buf.size() << "bytes to" << path;
+}
+
+
+// the payload of the product file, empty if there is none or it is from another version
+static QByteArray read_product(const QString& path, const CachedProduct product)
+{
+    if(path.isEmpty()) return QByteArray();
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) return QByteArray();
+    QByteArray data = file.readAll();
+
+    const int header_size = sizeof(cache_magic) + 2 * sizeof(UI);
+    if(data.size() < header_size || memcmp(data.constData(), cache_magic, sizeof(cache_magic)) != 0) return QByteArray();
+    UI version, stored;
+    memcpy(&version, data.constData() + sizeof(cache_magic), sizeof(UI));
+    memcpy(&stored, data.constData() + sizeof(cache_magic) + sizeof(UI), sizeof(UI));
+    if(version != product_cache_version || stored != product) return QByteArray();
+    return data.mid(header_size);
+}
+
+
+// for each frame: double time, double iso_val, UL num_verts, verts, UL num_tris, 3 UL vertex indices per triangle
+void save_cached_isosurfaces(Mesh* mesh)
+{
+    const QString path = product_cache_path(mesh, CACHED_ISOSURFACES);
+    if(path.isEmpty()) return;
+
+    CacheWriter w;
+    const vector<double> times = sorted_times(mesh->isosurfaces_for_all_t);
+    w.put((UL) times.size());
+    for(const double time : times){
+        const Isosurface* isosurf = mesh->isosurfaces_for_all_t.at(time);
+        unordered_map<const Vertex*, UL> idx_of;
+        w.put(time);
+        w.put(isosurf->iso_val);
+        w.put((UL) isosurf->verts.size());
+        for(UL i = 0; i < isosurf->verts.size(); i++){
+            idx_of[isosurf->verts[i]] = i;
+            w.put_vert(isosurf->verts[i], time);
+        }
+        w.put((UL) isosurf->num_tris());
+        for(const Triangle* tri : isosurf->tris){
+            for(unsigned char k = 0; k < 3; k++) w.put(idx_of.at(tri->verts[k]));
+        }
+    }
+    write_product(path, CACHED_ISOSURFACES, w);
+}
+
+
+// the span spaces are not cached, they are built the first time the isovalue slider moves
+bool load_cached_isosurfaces(Mesh* mesh)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray data = read_product(product_cache_path(mesh, CACHED_ISOSURFACES), CACHED_ISOSURFACES);
+    if(data.isEmpty()) return false;
+
+    CacheReader r(data);
+    unordered_map<double, Isosurface*> isosurfs;
+    const UL num_frames = r.get<UL>();
+    for(UL f = 0; f < num_frames && r.ok; f++){
+        Isosurface* isosurf = new Isosurface();
+        isosurf->time = r.get<double>();
+        isosurf->iso_val = r.get<double>();
+        isosurf->level_ratio = surface_level_ratio;
+        isosurf->field = isosurface_field;
+        isosurfs[isosurf->time] = isosurf;
+
+        const UL num_verts = r.get<UL>();
+        for(UL i = 0; i < num_verts && r.ok; i++) isosurf->verts.push_back(r.get_vert(mesh, isosurf->time));
+        const UL num_tris = r.get<UL>();
+        for(UL i = 0; i < num_tris && r.ok; i++){
+            Vertex* vs[3];
+            for(unsigned char k = 0; k < 3; k++){
+                const UL idx = r.get<UL>();
+                if(idx >= isosurf->verts.size()){
+                    r.ok = false;
+                    break;
+                }
+                vs[k] = isosurf->verts[idx];
+            }
+            if(r.ok) isosurf->add_tri(new Triangle(vs[0], vs[1], vs[2]));
+        }
+    }
+
+    if(!r.ok){
+        qDebug() << "Product cache: isosurfaces are corrupt, recomputing";
+        for(auto& pair : isosurfs) delete pair.second;
+        return false;
+    }
+
+    for(auto& pair : isosurfs){
+        auto it = mesh->isosurfaces_for_all_t.find(pair.first);
+        if(it != mesh->isosurfaces_for_all_t.end()) delete it->second;
+        mesh->isosurfaces_for_all_t[pair.first] = pair.second;
+        surface_level_vals[pair.first] = pair.second->iso_val;
+    }
+    qDebug() << "Product cache: loaded isosurfaces of" << num_frames << "frames in" << timer.nsecsElapsed() / 1e6 << "ms";
+    return true;
+}
+
+
+static void put_singularity(CacheWriter& w, const Singularity* sing)
+{
+    for(unsigned char d = 0; d < 3; d++) w.put(sing->cords.entry[d]);
+    w.put(sing->type);
+    w.put(sing->in_which_tet != NULL ? (long) sing->in_which_tet->idx : -1L);
+    for(unsigned char i = 0; i < 3; i++){
+        for(unsigned char j = 0; j < 3; j++) w.put(sing->Jacobian(i, j));
+    }
+}
+
+
+static Singularity* get_singularity(CacheReader& r, Mesh* mesh)
+{
+    Singularity* sing = new Singularity();
+    for(unsigned char d = 0; d < 3; d++) sing->cords.entry[d] = r.get<double>();
+    sing->type = r.get<unsigned short>();
+    const long tet_idx = r.get<long>();
+    if(tet_idx >= 0 && (UL) tet_idx < mesh->num_tets()) sing->in_which_tet = mesh->tets[tet_idx];
+    for(unsigned char i = 0; i < 3; i++){
+        for(unsigned char j = 0; j < 3; j++) sing->Jacobian(i, j) = r.get<double>();
+    }
+    return sing;
+}
+
+
+// for each frame: double time, the tets with fixed points, the singularities, the streamlines of the ECG
+// and its edges as (from node, to node, streamline) indices. nodes are in the order of the singularities
+void save_cached_ECGs(Mesh* mesh)
+{
+    const QString path = product_cache_path(mesh, CACHED_ECGS);
+    if(path.isEmpty()) return;
+
+    CacheWriter w;
+    const vector<double> times = sorted_times(mesh->ECG_for_all_t);
+    w.put((UL) times.size());
+    for(const double time : times){
+        ECG* ecg = mesh->ECG_for_all_t.at(time);
+        w.put(time);
+
+        auto fixed = mesh->tet_with_fixed_pt_for_all_t.find(time);
+        const UL num_fixed = fixed != mesh->tet_with_fixed_pt_for_all_t.end() ? fixed->second.size() : 0;
+        w.put(num_fixed);
+        for(UL i = 0; i < num_fixed; i++) w.put((UL) fixed->second[i]->idx);
+
+        const vector<Singularity*> sings = ecg->get_sings();
+        w.put((UL) sings.size());
+        for(const Singularity* sing : sings) put_singularity(w, sing);
+
+        unordered_map<const StreamLine*, UI> sl_idx;
+        w.put((UL) ecg->sls.size());
+        for(UI i = 0; i < ecg->sls.size(); i++){
+            sl_idx[ecg->sls[i]] = i;
+            w.put_streamline(ecg->sls[i]);
+        }
+
+        const vector<ECG_NODE*> nodes = ecg->get_nodes();
+        unordered_map<const ECG_NODE*, UI> node_idx;
+        for(UI i = 0; i < nodes.size(); i++) node_idx[nodes[i]] = i;
+        const vector<ECG_EDGE*> edges = ecg->get_edges();
+        w.put((UL) edges.size());
+        for(const ECG_EDGE* edge : edges){
+            w.put(node_idx.at(edge->nodes[0]));
+            w.put(node_idx.at(edge->nodes[1]));
+            auto it = sl_idx.find(edge->sl);
+            w.put(it != sl_idx.end() ? it->second : (UI) UINT_MAX);
+        }
+    }
+    write_product(path, CACHED_ECGS, w);
+}
+
+
+// the edges are linked into their nodes the same way ECG::build_ECG_EDGES does
+bool load_cached_ECGs(Mesh* mesh)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray data = read_product(product_cache_path(mesh, CACHED_ECGS), CACHED_ECGS);
+    if(data.isEmpty()) return false;
+
+    CacheReader r(data);
+    unordered_map<double, ECG*> ecgs;
+    unordered_map<double, vector<Tet*>> fixed_tets;
+    const UL num_frames = r.get<UL>();
+    for(UL f = 0; f < num_frames && r.ok; f++){
+        const double time = r.get<double>();
+        ECG* ecg = new ECG(time);
+        ecgs[time] = ecg;
+
+        vector<Tet*>& tets = fixed_tets[time];
+        const UL num_fixed = r.get<UL>();
+        for(UL i = 0; i < num_fixed && r.ok; i++){
+            const UL idx = r.get<UL>();
+            if(idx < mesh->num_tets()) tets.push_back(mesh->tets[idx]);
+            else r.ok = false;
+        }
+
+        const UL num_sings = r.get<UL>();
+        for(UL i = 0; i < num_sings && r.ok; i++) ecg->add_sing(get_singularity(r, mesh));
+        ecg->build_ECG_NODES();
+
+        const UL num_sls = r.get<UL>();
+        for(UL i = 0; i < num_sls && r.ok; i++) ecg->add_sl(r.get_streamline(mesh));
+
+        const vector<ECG_NODE*> nodes = ecg->get_nodes();
+        const UL num_edges = r.get<UL>();
+        for(UL i = 0; i < num_edges && r.ok; i++){
+            const UI from = r.get<UI>(), to = r.get<UI>(), sl = r.get<UI>();
+            if(from >= nodes.size() || to >= nodes.size()){
+                r.ok = false;
+                break;
+            }
+            ECG_NODE* a = nodes[from];
+            ECG_NODE* b = nodes[to];
+            ECG_EDGE* edge = new ECG_EDGE(a, b, sl < ecg->sls.size() ? ecg->sls[sl] : nullptr);
+            a->add_outNode(b);
+            a->add_outEdge(edge);
+            b->add_inNode(a);
+            b->add_inEdge(edge);
+            ecg->add_edge(edge);
+        }
+    }
+
+    if(!r.ok){
+        qDebug() << "Product cache: ECGs are corrupt, recomputing";
+        for(auto& pair : ecgs) delete pair.second;
+        return false;
+    }
+
+    for(auto& pair : ecgs){
+        auto it = mesh->ECG_for_all_t.find(pair.first);
+        if(it != mesh->ECG_for_all_t.end()) delete it->second;
+        mesh->ECG_for_all_t[pair.first] = pair.second;
+        mesh->tet_with_fixed_pt_for_all_t[pair.first] = fixed_tets[pair.first];
+    }
+    qDebug() << "Product cache: loaded ECGs of" << num_frames << "frames in" << timer.nsecsElapsed() / 1e6 << "ms";
+    return true;
+}
+
+
+// for each frame: double time, UL num_sls, the streamlines
+void save_cached_streamlines(Mesh* mesh)
+{
+    const QString path = product_cache_path(mesh, CACHED_STREAMLINES);
+    if(path.isEmpty()) return;
+
+    CacheWriter w;
+    const vector<double> times = sorted_times(mesh->streamlines_for_all_t);
+    w.put((UL) times.size());
+    for(const double time : times){
+        const vector<StreamLine*>& sls = mesh->streamlines_for_all_t.at(time);
+        w.put(time);
+        w.put((UL) sls.size());
+        for(const StreamLine* sl : sls) w.put_streamline(sl);
+    }
+    write_product(path, CACHED_STREAMLINES, w);
+}
+
+
+bool load_cached_streamlines(Mesh* mesh)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray data = read_product(product_cache_path(mesh, CACHED_STREAMLINES), CACHED_STREAMLINES);
+    if(data.isEmpty()) return false;
+
+    CacheReader r(data);
+    unordered_map<double, vector<StreamLine*>> sls_for_all_t;
+    const UL num_frames = r.get<UL>();
+    for(UL f = 0; f < num_frames && r.ok; f++){
+        const double time = r.get<double>();
+        vector<StreamLine*>& sls = sls_for_all_t[time];
+        const UL num_sls = r.get<UL>();
+        for(UL i = 0; i < num_sls && r.ok; i++) sls.push_back(r.get_streamline(mesh));
+    }
+
+    if(!r.ok){
+        qDebug() << "Product cache: streamlines are corrupt, recomputing";
+        for(auto& pair : sls_for_all_t){
+            for(StreamLine* sl : pair.second) delete sl;
+        }
+        return false;
+    }
+
+    for(auto& pair : sls_for_all_t){
+        auto it = mesh->streamlines_for_all_t.find(pair.first);
+        if(it != mesh->streamlines_for_all_t.end()){
+            for(StreamLine* sl : it->second) delete sl;
+        }
+        mesh->streamlines_for_all_t[pair.first] = pair.second;
+    }
+    qDebug() << "Product cache: loaded streamlines of" << num_frames << "frames in" << timer.nsecsElapsed() / 1e6 << "ms";
+    return true;
+}
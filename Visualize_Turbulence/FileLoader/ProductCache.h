@@ -0,0 +1,37 @@
+#ifndef PRODUCTCACHE_H
+#define PRODUCTCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+
+// derived products that are kept on disk between launches
+enum CachedProduct : UI{
+    CACHED_ISOSURFACES = 1,
+    CACHED_ECGS,            // singularities, tets with fixed points and the ECGs built on them
+    CACHED_STREAMLINES
+};
+
+// a product is stored in product_cache_dir under the SHA-1 of the input files and every parameter
+// it depends on, so a changed input or parameter is simply a miss and never overwrites another run
+// the file is the magic "VTCACHE", a UI version, a UI product, then the product's frames sorted by time
+// all numbers are in the byte order of the machine that wrote it
+static const UI product_cache_version = 2;
+
+QByteArray hash_input_files(const QByteArray& mesh_hash, const QString& data_path);
+QByteArray hash_mesh_file(const QString& mesh_path);
+QString product_cache_path(const Mesh* mesh, const CachedProduct product);
+
+// true if the product was found and loaded into mesh, the save functions overwrite nothing that exists
+bool load_cached_isosurfaces(Mesh* mesh);
+void save_cached_isosurfaces(Mesh* mesh);
+bool load_cached_ECGs(Mesh* mesh);
+void save_cached_ECGs(Mesh* mesh);
+bool load_cached_streamlines(Mesh* mesh);
+void save_cached_streamlines(Mesh* mesh);
+
+#endif // PRODUCTCACHE_H
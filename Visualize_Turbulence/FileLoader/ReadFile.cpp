@@ -4,6 +4,8 @@
 
 #include "FileLoader/ReadFile.h"
 #include "Others/Utilities.h"
+#include "FileLoader/ProductCache.h"
+#include "FileLoader/FrameCache.h"
 
 
 ReadFile::ReadFile()
@@ -28,22 +30,67 @@ ReadFile::ReadFile(const QString meshPath, const QString dataPath)
         delete this->mesh;
     }
 
-    this->mesh = new Mesh();
-
     QTime t = t.currentTime();
 
-    // assume both file has same ordering of the vertices
-    this->ReadMeshFile(this->meshPath); // read Mesh file first
-    this->ReadDataFile(this->dataPath); // then read data file
+    // the key of the derived products and the paged frames cached on disk, see FileLoader/ProductCache.h
+    // the mesh file is hashed once, its digest also tells the datasets on the same mesh file
+    const QByteArray mesh_hash = hash_mesh_file(this->meshPath);
+    QByteArray input_hash;
+    if(use_product_cache || page_field_data) input_hash = hash_input_files(mesh_hash, this->dataPath);
 
-    // calculate addition things about mesh
-    this->mesh->build_triangles();
-    this->mesh->build_edges();
-    this->mesh->build_tetNeighbors();
+    if(derive_vorticity && !(loaded_fields & RAW_VELOCITY)){
+        Utility::throwErrorMessage( "ReadFile: derive_vorticity needs velocity in loaded_fields" );
+    }
 
-    this->mesh->calc_Bounding_Sphere();
-    this->mesh->calc_normal_for_all_tris();
-    this->mesh->calc_center_for_all_tet();
+    // a dataset whose field data is paged shares the topology of a paged one read before on the same mesh file,
+    // so the vertex maps of a shared topology stay empty. assume both data files have the same ordering of the vertices
+    shared_ptr<Topology> built;
+    if(page_field_data && !mesh_hash.isEmpty()){
+        for(const Mesh* other : meshes){
+            if(other->field_store.is_paged() && other->topology->hash == mesh_hash){
+                built = other->topology;
+                break;
+            }
+        }
+    }
+
+    bool paged = false, page_failed = false;
+    if(built){
+        qDebug() << "Mesh:" << this->meshPath << "was read before, sharing its topology";
+        this->mesh = new Mesh(built);
+        this->mesh->input_hash = input_hash;
+        paged = this->PageDataFile(this->dataPath);
+        // the data goes into the vertex maps then, so this dataset needs a topology of its own
+        if(!paged){
+            page_failed = true;
+            delete this->mesh;
+            built.reset();
+        }
+    }
+
+    if(!built){
+        this->mesh = new Mesh();
+        this->mesh->input_hash = input_hash;
+        this->mesh->topology->hash = mesh_hash;
+        this->ReadMeshFile(this->meshPath); // read Mesh file first
+
+        // calculate addition things about mesh
+        this->mesh->build_triangles();
+        this->mesh->build_edges();
+        this->mesh->build_tetNeighbors();
+
+        this->mesh->calc_Bounding_Sphere();
+        this->mesh->calc_normal_for_all_tris();
+        this->mesh->calc_center_for_all_tet();
+        this->mesh->topology->build_arrays();
+    }
+
+    // then read data file, into the vertex maps unless it can be paged
+    if(page_field_data && !paged && !page_failed) paged = this->PageDataFile(this->dataPath);
+    if(!paged){
+        this->ReadDataFile(this->dataPath);
+        if(derive_vorticity && (loaded_fields & RAW_VORTICITY)) this->DeriveVorticity();
+    }
 
     // correctness check
     qDebug() << "Mesh: num of triangles:" << this->mesh->num_tris();
@@ -190,8 +237,57 @@ void ReadFile::ReadMeshFile(const QString f){
 }
 
 
+// page the field data of the mesh from its frame file, see FieldStore::page_from()
+// the text data file is only parsed if there is no frame file of it yet, it is written then
+// return false if the frames can't be kept on disk, the data file has to be read into the vertex maps then
+bool ReadFile::PageDataFile(QString f)
+{
+    const QString path = frame_cache_path(this->mesh->input_hash);
+    if(path.isEmpty()) return false;
+
+    FrameCache* cache = new FrameCache(path);
+    if(!cache->open() || cache->num_verts != this->mesh->num_verts()){
+        FrameCacheWriter writer;
+        this->ReadDataFile(f, &writer);
+        delete cache;
+        cache = new FrameCache(path);
+        if(!writer.finish() || !cache->open()){
+            qDebug() << "Frame cache: couldn't write" << path << ", the field data is kept in memory";
+            delete cache;
+            return false;
+        }
+    }
+
+    this->mesh->num_time_steps = cache->num_frames;
+    this->mesh->field_store.page_from(cache);
+    qDebug() << "Paging" << raw_field_names(stored_fields) << "of" << cache->num_frames << "frames of" << cache->frame_bytes() / 1e6
+             << "MB from" << path;
+    return true;
+}
+
+
+// fill the vorticity of the vertex maps with the one derived from their velocity, see FieldStore::calc_vert_vor()
+// a paged mesh derives it whenever it is needed instead
+void ReadFile::DeriveVorticity()
+{
+    const UL n = this->mesh->num_verts();
+    vector<double> vels(3 * n), vors(3 * n);
+    for(UL i = 0; i < this->mesh->num_time_steps; i++){
+        const double time = (double) i;
+        for(UL v = 0; v < n; v++){
+            const Vector3d* vel = this->mesh->verts[v]->vels.at(time);
+            for(unsigned char j = 0; j < 3; j++) vels[3*v + j] = vel->entry[j];
+        }
+        this->mesh->field_store.derive_vert_vors(this->mesh, vels.data(), vors.data());
+        for(UL v = 0; v < n; v++) this->mesh->verts[v]->set_vor(time, vors[3*v], vors[3*v + 1], vors[3*v + 2]);
+    }
+    qDebug() << "Derived the vorticity of" << this->mesh->num_time_steps << "time steps from the velocity";
+}
+
+
 // should only be called when ReadMeshFile() is called
-void ReadFile::ReadDataFile(QString f){
+// if writer is given, the values go into the frame file it writes instead of the vertex maps
+void ReadFile::ReadDataFile(QString f, FrameCacheWriter* writer){
     // checking if mesh has been built
     if( this->mesh->num_verts() == 0 ) return;
     if( this->mesh->num_tets() == 0 ) return;
@@ -252,31 +348,57 @@ void ReadFile::ReadDataFile(QString f){
     }
     const unsigned int num_time_steps = num_expressions / expected_num_expressions;
     this->mesh->num_time_steps = num_time_steps;
+    if(writer != NULL && !writer->begin(frame_cache_path(this->mesh->input_hash), this->mesh->num_verts(), num_time_steps, stored_fields)) return;
+
+    // only the columns of stored_fields are converted, slot is where expression k of a time step goes among the
+    // values of the fields kept, -1 if it is skipped
+    int slot[expected_num_expressions];
+    const unsigned char expression_fields[expected_num_expressions] = {
+        RAW_VELOCITY, RAW_VELOCITY, RAW_VELOCITY, RAW_VORTICITY, RAW_VORTICITY, RAW_VORTICITY, RAW_MU
+    };
+    int width = 0;
+    for(int k = 0; k < expected_num_expressions; k++) slot[k] = (stored_fields & expression_fields[k]) ? width++ : -1;
+    qDebug() << "Reading" << raw_field_names(stored_fields) << "of" << num_time_steps << "time steps";
 
     // step 4: read the data
     unsigned long vert_count = 0;
     unsigned int i;
+    vector<double> vals(num_time_steps * width);
     while ( !in.atEnd() && vert_count < this->mesh->num_verts() ) {
         line = in.readLine();
-        QStringList strings = line.split(" ", Qt::SkipEmptyParts);
-        if( strings.size() != num_expressions+3 ){
+        double* out = writer != NULL ? writer->next_vert() : vals.data();
+
+        // the first 3 columns are the coordinates which we already have
+        unsigned int col = 0;
+        for(const QStringView token : QStringView(line).tokenize(u' ', Qt::SkipEmptyParts)){
+            if(col >= 3 && col < num_expressions + 3){
+                const unsigned int e = col - 3;
+                const int k = slot[e % expected_num_expressions];
+                if(k >= 0) out[(e / expected_num_expressions) * width + k] = token.toDouble();
+            }
+            col++;
+        }
+        if( col != num_expressions+3 ){
             Utility::throwErrorMessage( "ReadFile::ReadDataFile(QString f): vert does not have correct data format" ); return;
         }
-        Vertex* cur_vert = this->mesh->verts[vert_count];
 
-        for( i = 0; i < num_time_steps; i++ ){
-            cur_vert->vors.reserve( num_time_steps ); // reserve enough space for many time steps data
-            cur_vert->vels.reserve( num_time_steps ); // reserve enough space for many time steps data
+        // velocity, vorticity and mu of every time step went into the frame file
+        if(writer != NULL){
+            vert_count ++;
+            continue;
+        }
 
-            // calculate base index for each time step
-            // first 3 indices are reserved for coordinates which we already have.
-            const int idx = 3 + i * expected_num_expressions;
+        Vertex* cur_vert = this->mesh->verts[vert_count];
+        if(stored_fields & RAW_VELOCITY) cur_vert->vels.reserve( num_time_steps ); // reserve enough space for many time steps data
+        if(stored_fields & RAW_VORTICITY) cur_vert->vors.reserve( num_time_steps ); // reserve enough space for many time steps data
+        for( i = 0; i < num_time_steps; i++ ){
+            const double* step = out + i * width;
             // read velocity vector
-            cur_vert->set_vel( (double) i, strings[idx].toDouble(), strings[idx+1].toDouble(), strings[idx+2].toDouble());
+            if(slot[0] >= 0) cur_vert->set_vel( (double) i, step[slot[0]], step[slot[0]+1], step[slot[0]+2] );
             // read vorticity vector
-            cur_vert->set_vor( (double) i, strings[idx+3].toDouble(), strings[idx+4].toDouble(), strings[idx+5].toDouble());
+            if(slot[3] >= 0) cur_vert->set_vor( (double) i, step[slot[3]], step[slot[3]+1], step[slot[3]+2] );
             // read Turbulent dynamic viscosity
-            cur_vert->set_mu( (double) i, strings[idx+6].toDouble() );
+            if(slot[6] >= 0) cur_vert->set_mu( (double) i, step[slot[6]] );
         }
 
         vert_count ++;
@@ -5,6 +5,8 @@
 #include <QFile>
 #include "Geometry/Mesh.h"
 
+class FrameCacheWriter;
+
 class ReadFile {
 public:
     // member variables
@@ -19,7 +21,9 @@ public:
     ~ReadFile();
 
     void ReadMeshFile(QString);
-    void ReadDataFile(QString);
+    void ReadDataFile(QString, FrameCacheWriter* writer = NULL);
+    bool PageDataFile(QString);
+    void DeriveVorticity();
 };
 
 #endif // READFILE_H
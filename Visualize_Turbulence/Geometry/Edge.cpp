@@ -47,7 +47,9 @@ bool Edge::has_vert(const Vertex *v) const
 
 
 // interpolate between two verts of this edge at time t
-Vertex* Edge::linear_interpolate_basedOn_vorMag(const double &t, const double &target_val)
+// val1 and val2 are the scalar values at verts[0] and verts[1], the new vertex is where the scalar equals target_val
+// store is the field store of the mesh of this edge, see Vertex::vel_at()
+Vertex* Edge::linear_interpolate_basedOn_vals(const double &t, const FieldStore* store, const double val1, const double val2, const double &target_val)
 {
     const Vertex* vert1 = verts[0];
     const Vertex* vert2 = verts[1];
@@ -55,30 +57,27 @@ Vertex* Edge::linear_interpolate_basedOn_vorMag(const double &t, const double &t
     const Vector3d cord1 = vert1->cords;
     const Vector3d cord2 = vert2->cords;
 
-    const Vector3d vel1 = Vector3d(vert1->vels.at(t));
-    const Vector3d vel2 = Vector3d(vert2->vels.at(t));
+    const Vector3d vel1 = vert1->vel_at(t, store);
+    const Vector3d vel2 = vert2->vel_at(t, store);
 
-    const Vector3d vor1 = Vector3d(vert1->vors.at(t));
-    const Vector3d vor2 = Vector3d(vert2->vors.at(t));
+    const Vector3d vor1 = vert1->vor_at(t, store);
+    const Vector3d vor2 = vert2->vor_at(t, store);
 
-    const double mu1 = vert1->mus.at(t);
-    const double mu2 = vert2->mus.at(t);
+    const double mu1 = vert1->mu_at(t, store);
+    const double mu2 = vert2->mu_at(t, store);
 
-    const double mag1 = length(vor1);
-    const double mag2 = length(vor2);
-
-    if( (target_val < mag1 || target_val > mag2) && (target_val > mag1 || target_val < mag2)  ){
-        qDebug() << "Edge::linear_interpolate_basedOn_vorMag: error!, target_val is not correct";
+    if( (target_val < val1 || target_val > val2) && (target_val > val1 || target_val < val2)  ){
+        qDebug() << "Edge::linear_interpolate_basedOn_vals: error!, target_val is not correct";
     }
 
     Vertex* newVertex = new Vertex( cord1 );
-    const double d_mag = mag2-mag1;
-    if(d_mag == 0) return newVertex;
-    const double ratio = ( target_val - mag1 ) / d_mag;
+    const double d_val = val2-val1;
+    double ratio = 0.;
+    if(d_val != 0) ratio = ( target_val - val1 ) / d_val;
 
     // interpolate new values
     Vector3d new_cord = cord1 + (cord2 - cord1) * ratio;
-    Vector3d* new_vel = new Vector3d( cord1 + (vel2 - vel1) * ratio );
+    Vector3d* new_vel = new Vector3d( vel1 + (vel2 - vel1) * ratio );
     Vector3d* new_vor = new Vector3d( vor1 + (vor2 - vor1) * ratio );
     double new_mu = mu1 + (mu2 - mu1) * ratio;
 
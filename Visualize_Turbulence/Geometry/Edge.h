@@ -8,6 +8,7 @@
 class Vertex;
 class Tet;
 class Triangle;
+class FieldStore;
 
 using namespace std;
 
@@ -39,7 +40,7 @@ public:
 
     Vector3d near_middle_pt(const double ratio) const;
 
-    Vertex* linear_interpolate_basedOn_vorMag( const double& time, const double& target_val );
+    Vertex* linear_interpolate_basedOn_vals( const double& time, const FieldStore* store, const double val1, const double val2, const double& target_val );
 };
 
 
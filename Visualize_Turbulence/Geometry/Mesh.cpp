@@ -1,55 +1,34 @@
 #include "Geometry/Mesh.h"
 #include "Others/Utilities.h"
 #include "Analysis/FixedPtDetect.h"
+#include "Lines/ParticleCloud.h"
 #include <set>
 #include <float.h>
 
-Mesh::Mesh()
+Mesh::Mesh() : Mesh(make_shared<Topology>())
+{
+}
+
+
+// a dataset on the topology of another one, the topology isn't changed by either of them after it is read
+Mesh::Mesh(shared_ptr<Topology> topology)
+    : topology(topology), verts(topology->verts), edges(topology->edges), tris(topology->tris), tets(topology->tets),
+      boundary_tris(topology->boundary_tris), rot_center(topology->rot_center)
 {
     //this->radius = 0.;
     this->num_time_steps = 0;
-    // reserve vector memories to save time
-    this->edges.reserve(100000);
-    this->tris.reserve(100000);
+    this->particle_cloud = NULL;
+    this->field_store.topology = topology.get();
 }
 
 
+// the topology is deleted with the last dataset that uses it
 Mesh::~Mesh()
 {
-    UL i, j;
-
-    // clear vertices
-    for( i=0; i<this->num_verts(); i++ ){
-        if( this->verts[i] != NULL ){
-            delete this->verts[i];
-            this->verts[i] = NULL;
-        }
-    }
-
-
-    // clear edges
-    for( i=0; i<this->num_edges(); i++ ){
-        if( this->edges[i] != NULL ){
-            delete this->edges[i];
-            this->edges[i] = NULL;
-        }
-    }
-
-    // clear tris
-    for( i=0; i<this->num_tris(); i++ ){
-        if( this->tris[i] != NULL ){
-            delete this->tris[i];
-            this->tris[i] = NULL;
-        }
-    }
-
-
-    // clear tets
-    for( i=0; i<this->num_tets(); i++ ){
-        if( this->tets[i] != NULL ){
-            delete this->tets[i];
-            this->tets[i] = NULL;
-        }
+    // stop the particle cloud first, its threads read the mesh
+    if(this->particle_cloud != NULL){
+        delete this->particle_cloud;
+        this->particle_cloud = NULL;
     }
 
     // clear memoery used by ECGs
@@ -65,6 +44,12 @@ Mesh::~Mesh()
         delete isosurf;
     }
 
+    // clear span spaces
+    for(auto& pair : span_spaces_for_all_t){
+        SpanSpace* span = pair.second;
+        delete span;
+    }
+
     // clear streamlines
     for(auto& pair : streamlines_for_all_t){
         vector<StreamLine*> sls = pair.second;
@@ -73,14 +58,24 @@ Mesh::~Mesh()
         }
     }
 
-    this->verts.clear();
-    this->edges.clear();
-    this->tris.clear();
-    this->tets.clear();
-    this->boundary_tris.clear();
+    // clear pathlines
+    for(PathLine* pl : pathlines){
+        delete pl;
+    }
+
+    // clear vortex cores
+    for(auto& pair : vortex_cores_for_all_t){
+        for(VortexCore* core : pair.second){
+            delete core;
+        }
+    }
+
     this->min_max_at_verts_for_all_t.clear();
     this->ECG_for_all_t.clear();
     this->streamlines_for_all_t.clear();
+    this->vortex_cores_for_all_t.clear();
+    this->pathlines.clear();
+    this->span_spaces_for_all_t.clear();
 }
 
 
@@ -276,7 +271,7 @@ void Mesh::max_vor_mag(const double time, double& min_vor, double& max_vor) cons
     min_vor = DBL_MAX;
     max_vor = DBL_MIN;
     for( const Vertex* v : this->verts ){
-        const Vector3d vor = v->vors.at(time);
+        const Vector3d vor = v->vor_at(time, &this->field_store);
         const double mag = length(vor);
         if(mag < min_vor) min_vor = mag;
         if(mag > max_vor) max_vor = mag;
@@ -298,7 +293,7 @@ void Mesh::max_vel_mag(const double time, double& min_vel, double& max_vel) cons
     min_vel = DBL_MAX;
     max_vel = DBL_MIN;
     for( const Vertex* v : this->verts ){
-        Vector3d vel = v->vels.at(time);
+        Vector3d vel = v->vel_at(time, &this->field_store);
         double mag = length(vel);
         if(mag < min_vel) min_vel = mag;
         if(mag > max_vel) max_vel = mag;
@@ -353,9 +348,10 @@ void Mesh::calc_vor_min_max_at_verts_for_all_t()
     double time = 0.;
     while( time < this->num_time_steps - 1. )
     {
+        const FrameHandle frame = this->field_store.pin(this, time);
         double min = DBL_MAX, max = DBL_MIN;
         for(Vertex* v : verts){
-            Vector3d* vor = v->vors.at(time);
+            const Vector3d vor = v->vor_at(time, &this->field_store);
             const double mag = length(vor);
             if(mag < min) min = mag;
             if(mag > max) max = mag;
@@ -388,41 +384,50 @@ void Mesh::build_ECG_for_all_t()
     double t = 0.;
     while( t < this->num_time_steps - 1. )
     {
-        ECG* ecg = new ECG(t);
-        // insert singularities for ecg at time t
-        vector<Singularity*> sings = map[t];
-        qDebug() << "singularity size for time" << t <<  ": " <<  sings.size();
-        for(Singularity* sing : sings){
-            ecg->add_sing(sing); // add singularity one by one
-        }
+        const FrameHandle frame = this->field_store.pin(this, t);
+        this->ECG_for_all_t[t] = this->build_ECG_at(t, map[t]);
+        t += time_step_size;
+    }
+}
 
-        qDebug() << "Build ECG nodes";
-        ecg->build_ECG_NODES();
-        qDebug() << "ECG nodes Done";
-        auto seeds = ecg->placing_random_seeds(this, NUM_SEEDS);
-        qDebug() << "Build ECG edges";
-        ecg->build_ECG_EDGES(this, seeds);
-        qDebug() << "ECG edges Done";
-        this->ECG_for_all_t[t] = ecg;
 
-        t += time_step_size;
+// the ECG of time t on the given singularities, which it takes over
+// only reads the mesh, the ECG is not inserted into ECG_for_all_t
+ECG* Mesh::build_ECG_at(const double t, const vector<Singularity*>& sings)
+{
+    ECG* ecg = new ECG(t);
+    // insert singularities for ecg at time t
+    qDebug() << "singularity size for time" << t <<  ": " <<  sings.size();
+    for(Singularity* sing : sings){
+        ecg->add_sing(sing); // add singularity one by one
     }
+
+    qDebug() << "Build ECG nodes";
+    ecg->build_ECG_NODES();
+    qDebug() << "ECG nodes Done";
+    auto seeds = ecg->placing_random_seeds(this, NUM_SEEDS);
+    qDebug() << "Build ECG edges";
+    ecg->build_ECG_EDGES(this, seeds);
+    qDebug() << "ECG edges Done";
+    return ecg;
 }
 
 
+// a paged mesh interpolates the frames in between when they are loaded, see FieldStore::load()
 void Mesh::interpolate_vertices_for_all_t()
 {
+    if(this->field_store.is_paged()) return;
     double t = 0.;
     qDebug() << "Begin interpolate vertices";
     while( t < this->num_time_steps - 1. )
     {
         for(Vertex* vert : this->verts){
 
-            vert->linear_interpolate_vel(t);
+            if(loaded_fields & RAW_VELOCITY) vert->linear_interpolate_vel(t);
 
-            vert->linear_interpolate_vor(t);
+            if(loaded_fields & RAW_VORTICITY) vert->linear_interpolate_vor(t);
 
-            vert->linear_interpolate_mu(t);
+            if(loaded_fields & RAW_MU) vert->linear_interpolate_mu(t);
         }
 
         t += time_step_size;
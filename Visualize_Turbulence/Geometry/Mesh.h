@@ -2,34 +2,44 @@
 #define MESH_H
 
 #include <vector>
+#include <memory>
 #include <QString>
 #include <QDebug>
 
 #include "Analysis/ECG.h"
+#include "Analysis/FieldStore.h"
 #include "Geometry/Vertex.h"
 #include "Geometry/Edge.h"
 #include "Geometry/Triangle.h"
 #include "Geometry/Tet.h"
+#include "Geometry/Topology.h"
+#include "Lines/PathLine.h"
 #include "Lines/StreamLine.h"
+#include "Lines/VortexCore.h"
 #include "Others/Predefined.h"
 #include "Others/Vector3d.h"
 #include "Surfaces/Isosurface.h"
 
 using namespace std;
 
+class ParticleCloud;
+
 class Mesh {
 public:
     // member variables
-    vector<Vertex*> verts;
-    vector<Edge*> edges;
-    vector<Triangle*> tris;
-    vector<Tet*> tets;
+    // the elements below belong to the topology, which other datasets on the same mesh file may share
+    shared_ptr<Topology> topology;
+    vector<Vertex*>& verts;
+    vector<Edge*>& edges;
+    vector<Triangle*>& tris;
+    vector<Tet*>& tets;
 
-    vector<Triangle*> boundary_tris;
+    vector<Triangle*>& boundary_tris;
 
-    Vector3d rot_center;
+    Vector3d& rot_center;
     //double radius;
     unsigned int num_time_steps;
+    QByteArray input_hash; // SHA-1 of the mesh and data files, part of every product cache key
 
     unordered_map<double, ECG*> ECG_for_all_t;
     unordered_map< double, vector<Tet*> > tet_with_fixed_pt_for_all_t;
@@ -38,10 +48,20 @@ public:
 
     // we calculate streamlines for each original time steps, so [0] means the strealines for the first time step
     unordered_map< double, vector<StreamLine*> > streamlines_for_all_t;
+    unordered_map< double, vector<VortexCore*> > vortex_cores_for_all_t;
+    // pathlines are seeded at t = 0 and run through all time steps
+    vector<PathLine*> pathlines;
+    // animated particles, created the first time the cloud is shown
+    ParticleCloud* particle_cloud;
     unordered_map< double, Isosurface*> isosurfaces_for_all_t;
+    unordered_map< double, SpanSpace*> span_spaces_for_all_t;
+
+    // flat per-vertex scalar fields for each time step, computed on demand
+    FieldStore field_store;
 
     // member functions
     Mesh();
+    Mesh(shared_ptr<Topology> topology);
     ~Mesh();
 
     inline unsigned long num_verts() const;
@@ -57,6 +77,7 @@ public:
     inline void add_vor_min_max_at_verts_for_all_t( const double time, const pair<double, double> min_max_pair );
 
     void calc_Bounding_Sphere();
+    inline bool same_topology(const Mesh* other) const;
     void build_triangles();
     void build_edges( );
     void build_tetNeighbors();
@@ -68,6 +89,7 @@ public:
     void calc_vor_min_max_at_verts_for_all_t();
     void calc_center_for_all_tet();
     void build_ECG_for_all_t();
+    ECG* build_ECG_at(const double t, const vector<Singularity*>& sings);
 
     // numerical procedures
     void interpolate_vertices_for_all_t();
@@ -75,13 +97,15 @@ public:
 
     // singularity detection
     unordered_map< double, vector<Singularity*> > detect_sings();
-    bool is_candidate_tet(Tet* tet, const double time) const;
+    vector<Singularity*> detect_sings_at(const double time) const;
+    bool is_candidate_tet(Tet* tet, const double time, const FieldStore* store) const;
     vector<Tet*> build_candidate_tets( const double time ) const;
     UI find_fixed_pt_location_TetSubd(  const Tet *tet, const double time, Vector3d** fixed_pt ) const;
 
     char Positive( const Vector3d* v1, const Vector3d* v2, const Vector3d* v3, const Vector3d* v4, const double time ) const;
     bool has_fixedPt_Robust(const Tet* tet, const double time) const;
     void find_tets_with_fixedPts();
+    vector<Tet*> find_tets_with_fixedPts_at(const double time) const;
 };
 
 inline unsigned long Mesh::num_verts() const
@@ -114,6 +138,13 @@ inline unsigned long Mesh::num_boundary_tris() const
 }
 
 
+// true if both meshes were read from the same mesh file, their vertices, edges, triangles and tets match by index
+inline bool Mesh::same_topology(const Mesh* other) const
+{
+    return !this->topology->hash.isEmpty() && this->topology->hash == other->topology->hash;
+}
+
+
 inline void Mesh::add_vert(Vertex* v){
     v->idx = this->num_verts();
     this->verts.push_back(v);
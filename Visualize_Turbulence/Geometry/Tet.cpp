@@ -3,6 +3,7 @@
 #include "Geometry/Triangle.h"
 #include "Geometry/Edge.h"
 #include "Others/Utilities.h"
+#include "Surfaces/MarchingTets.h"
 #include <math.h>
 #include <QDebug>
 
@@ -47,7 +48,6 @@ Tet::~Tet()
     this->edges.clear();
     this->tris.clear();
     this->tets.clear();
-    this->marching_idices.clear();
 }
 
 
@@ -93,6 +93,15 @@ bool Tet::has_edge(const Vertex *v1, const Vertex *v2) const
     return false;
 }
 
+// return the edge that connects v1 and v2, nullptr if this tet doesn't have it
+Edge* Tet::get_edge(const Vertex *v1, const Vertex *v2) const
+{
+    for(Edge* e : this->edges){
+        if( (e->verts[0] == v1 && e->verts[1] == v2) || (e->verts[0] == v2 && e->verts[1] == v1) ) return e;
+    }
+    return nullptr;
+}
+
 bool Tet::has_boundary_tri() const
 {
     for(Triangle* tri : this->tris){
@@ -105,7 +114,7 @@ bool Tet::has_boundary_tri() const
 // assume v is inside this tet
 // Using barycentric interpolation scheme, calculate the new Vertex at pt's position
 // if cal_ws is true, then we calculate the weights
-Vertex* Tet::get_vert_at(const Vector3d& v, const double time, double ws[4], bool cal_ws, bool add_this_tet)
+Vertex* Tet::get_vert_at(const Vector3d& v, const double time, const FieldStore* store, double ws[4], bool cal_ws, bool add_this_tet)
 {
     // only calculate ws if cal_ws is set to true
     if(cal_ws) this->bary_cords(ws, v);
@@ -122,18 +131,18 @@ Vertex* Tet::get_vert_at(const Vector3d& v, const double time, double ws[4], boo
 
         if(vert == NULL) Utility::throwErrorMessage( QString("Tet::interpolate: a null pointer inside vs! Current tet is %1").arg(this->idx) );
 
-        if(vert->has_vel_at_t(time)){
-            Vector3d temp_vel = vert->vels[time];
+        if(vert->has_vel_at_t(time, store)){
+            Vector3d temp_vel = vert->vel_at(time, store);
             vel =  vel + temp_vel * weight;
         }
 
-        if(vert->has_vor_at_t(time)){
-            Vector3d temp_vor = vert->vors[time];
+        if(vert->has_vor_at_t(time, store)){
+            Vector3d temp_vor = vert->vor_at(time, store);
             vor = vor + temp_vor * weight;
         }
 
-        if(vert->has_mu_at_t(time)){
-            double temp_mu = vert->mus[time];
+        if(vert->has_mu_at_t(time, store)){
+            double temp_mu = vert->mu_at(time, store);
             mu = mu + temp_mu * weight;
         }
     }
@@ -146,7 +155,7 @@ Vertex* Tet::get_vert_at(const Vector3d& v, const double time, double ws[4], boo
     return pt_vert;
 }
 
-Vertex *Tet::get_vert_at(const double time, double ws[4]) const
+Vertex *Tet::get_vert_at(const double time, const FieldStore* store, double ws[4]) const
 {
     Vector3d vel,  vor;
     double mu = 0.;
@@ -155,18 +164,18 @@ Vertex *Tet::get_vert_at(const double time, double ws[4]) const
         Vertex* vert = this->verts[i];
         double weight = ws[i];
 
-        if(vert->has_vel_at_t(time)){
-            Vector3d temp_vel = vert->vels[time];
+        if(vert->has_vel_at_t(time, store)){
+            Vector3d temp_vel = vert->vel_at(time, store);
             vel =  vel + temp_vel * weight;
         }
 
-        if(vert->has_vor_at_t(time)){
-            Vector3d temp_vor = vert->vors[time];
+        if(vert->has_vor_at_t(time, store)){
+            Vector3d temp_vor = vert->vor_at(time, store);
             vor = vor + temp_vor * weight;
         }
 
-        if(vert->has_mu_at_t(time)){
-            double temp_mu = vert->mus[time];
+        if(vert->has_mu_at_t(time, store)){
+            double temp_mu = vert->mu_at(time, store);
             mu = mu + temp_mu * weight;
         }
 
@@ -213,12 +222,12 @@ Vector3d Tet::centroid() const
 }
 
 // deep_copy the current tet's vertex and edges
-Tet *Tet::clone(const double time) const
+Tet *Tet::clone(const double time, const FieldStore* store) const
 {
-    Vertex* newV1 = this->verts[0]->clone(time, true);
-    Vertex* newV2 = this->verts[1]->clone(time, true);
-    Vertex* newV3 = this->verts[2]->clone(time, true);
-    Vertex* newV4 = this->verts[3]->clone(time, true);
+    Vertex* newV1 = this->verts[0]->clone(time, store, true);
+    Vertex* newV2 = this->verts[1]->clone(time, store, true);
+    Vertex* newV3 = this->verts[2]->clone(time, store, true);
+    Vertex* newV4 = this->verts[3]->clone(time, store, true);
     Tet* newTet = new Tet(newV1, newV2, newV3, newV4);
     return newTet;
 }
@@ -321,153 +330,39 @@ Vector3d Tet::actual_normal_of( unsigned char tri_idx ) const
 }
 
 
-// assume vertices->is_above_surface are calculated
-void Tet::calc_marching_indices(unsigned int num_time_steps)
-{
-    double time = 0.;
-    const unsigned char one = 0b01;
-    while(time < num_time_steps - 1.)
-    {
-        this->marching_idices[time] = 0;
-        for( unsigned int i = 0; i< this->verts.size(); i++ ){
-            const Vertex* vert = verts[i];
-            bool is_above = vert->is_above_surface.at(time);
-            if(is_above) // if it is above, we set the bit
-                this->marching_idices[time] = this->marching_idices.at(time) | (one << i);
-        }
-        time += time_step_size;
-    }
-}
-
-
-
-
 // http://paulbourke.net/geometry/polygonise/
-vector<Triangle *> Tet::create_isosurface_tris(const double& time)
-{
-    vector<Triangle*> new_tris;
-    // 7 cases
-    switch(this->marching_idices.at(time)){
-    case 0b0001:
-    case 0b1110:{ // the first vert is different than others
-        new_tris.push_back(create_isosurface_tris_case1234(verts[0], time));
-        break;
-    }
-    case 0b0010:
-    case 0b1101:{ // the second vert is different than others
-        new_tris.push_back(create_isosurface_tris_case1234(verts[1], time));
-        break;
-    }
-    case 0b0100:
-    case 0b1011:{ // the third vert is different than others
-        new_tris.push_back(create_isosurface_tris_case1234(verts[2], time));
-        break;
-    }
-    case 0b1000:
-    case 0b0111:{ // the forth vert is different than others
-        new_tris.push_back(create_isosurface_tris_case1234(verts[3], time));
-        break;
-    }
-    case 0b0011:
-    case 0b1100:{ // a cut between nodes 12 and 34, two triangles
-        vector<Triangle*> temp = create_isosurface_tris_case567(verts[0], verts[1], time);
-        new_tris.push_back(temp[0]); new_tris.push_back(temp[1]);
-        break;
-    }
-    case 0b0101:
-    case 0b1010:{ // a cut between nodes 13 and 24, two triangles
-        vector<Triangle*> temp = create_isosurface_tris_case567(verts[0], verts[2], time);
-        new_tris.push_back(temp[0]); new_tris.push_back(temp[1]);
-        break;
-    }
-    case 0b0110:
-    case 0b1001:{ // a cut between nodes 14 and 23,, two triangles
-        vector<Triangle*> temp = create_isosurface_tris_case567(verts[0], verts[3], time);
-        new_tris.push_back(temp[0]); new_tris.push_back(temp[1]);
-        break;
-    }
-    }
-
-    return new_tris;
-}
-
-
-// v is the one on the different level than other 3 in the tet
-Triangle *Tet::create_isosurface_tris_case1234(const Vertex *v, const double time)
-{
-    vector<Vertex*> newVerts;
-    for(Edge* e : edges){
-        if(e->has_vert(v)){
-            Vertex* newVert = e->linear_interpolate_basedOn_vorMag(time, surface_level_vals.at(time));
-            newVert->add_tet(this);
-            newVerts.push_back(newVert);
-        }
-    }
-    Triangle* new_tri = new Triangle(newVerts[0], newVerts[1], newVerts[2]);
-    return new_tri;
-}
-
-
-struct VertOnEdge{
-    Edge* edge;
-    Vertex* vert;
-};
-
-
-inline bool is_IDP_edges(Edge* e1, Edge* e2){
-    Vertex* v1 = e1->verts[0];
-    Vertex* v2 = e1->verts[1];
-    Vertex* v3 = e2->verts[0];
-    Vertex* v4 = e2->verts[1];
-    return (v1 != v3 && v1 != v4 && v2 != v3 && v2 != v4);
-}
-
-// v1v2 are the two on the different level than other 2 in the tet
-// will create two triangles in this case
-vector<Triangle *> Tet::create_isosurface_tris_case567(const Vertex *v1, const Vertex *v2, const double time)
+// marching_idx has bit i set if verts[i] is above iso_val
+// vert_vals is the scalar field of the whole mesh at time, indexed by Vertex::idx
+// newly created vertices and triangles are appended to new_verts and new_tris
+void Tet::create_isosurface_tris(const double time, const FieldStore* store, const unsigned char marching_idx, const double iso_val,
+                                 const double* vert_vals, vector<Vertex*>& new_verts, vector<Triangle*>& new_tris)
 {
-    vector<VertOnEdge> newPairs;
-    for(Edge* e : edges){
-        bool has_v1 = e->has_vert(v1);
-        bool has_v2 = e->has_vert(v2);
-        if(has_v1 && has_v2) continue;
-
-        if(has_v1 || has_v2){
-            Vertex* newVert = e->linear_interpolate_basedOn_vorMag(time, surface_level_vals.at(time));
+    const MarchingCase& mc = marching_cases[marching_idx & 0x0F];
+    if(mc.num_tris == 0) return;
+
+    // one interpolated vertex per cut edge, shared by both triangles of a quad
+    Vertex* edge_verts[6] = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+    for(unsigned char i = 0; i < mc.num_tris; i++){
+        for(unsigned char j = 0; j < 3; j++){
+            const unsigned char e_idx = mc.tri_edges[i][j];
+            if(edge_verts[e_idx] != nullptr) continue;
+
+            Edge* e = this->get_edge(verts[ tet_edge_verts[e_idx][0] ], verts[ tet_edge_verts[e_idx][1] ]);
+            if(e == nullptr) Utility::throwErrorMessage( QString("Tet::create_isosurface_tris: tet %1 is missing an edge").arg(this->idx) );
+
+            const double val1 = vert_vals[ e->verts[0]->idx ];
+            const double val2 = vert_vals[ e->verts[1]->idx ];
+            Vertex* newVert = e->linear_interpolate_basedOn_vals(time, store, val1, val2, iso_val);
             newVert->add_tet(this);
-            VertOnEdge newPair = {e, newVert};
-            newPairs.push_back(newPair);
+            new_verts.push_back(newVert);
+            edge_verts[e_idx] = newVert;
         }
     }
 
-    // looking for 'independent' verts
-    // independent := two verts do not share original verts
-    short idpVert1 = -1, idpVert2 = -1;
-    for( UI i = 0; i < newPairs.size(); i++ ){
-        VertOnEdge pair1 = newPairs[i];
-        for( UI j = 0; j < newPairs.size(); j++){
-            VertOnEdge pair2 = newPairs[j];
-            if(is_IDP_edges(pair1.edge, pair2.edge)){
-                idpVert1 = i;
-                idpVert2 = j;
-            }
-        }
-    }
-
-    short vert3 = -1, vert4 = -1;
-    for(UI i = 0; i < newPairs.size(); i++){
-        if(i != idpVert1 && i != idpVert2){
-            if(vert3 == -1) vert3 = i;
-            else{
-                vert4 = i;
-            }
-        }
+    for(unsigned char i = 0; i < mc.num_tris; i++){
+        const unsigned char* tri_edges = mc.tri_edges[i];
+        new_tris.push_back( new Triangle(edge_verts[tri_edges[0]], edge_verts[tri_edges[1]], edge_verts[tri_edges[2]]) );
     }
-
-    Triangle* new_tri1 = new Triangle(newPairs[idpVert1].vert, newPairs[idpVert2].vert, newPairs[vert3].vert);
-    Triangle* new_tri2 = new Triangle(newPairs[idpVert1].vert, newPairs[idpVert2].vert, newPairs[vert4].vert);
-    vector<Triangle*> newTris = {new_tri1, new_tri2};
-    return newTris;
 }
 
 
@@ -529,7 +424,7 @@ void Tet::make_triangles()
  * 5. separate the octahedron into 4 tetrahedrons by using the diagonal edge.
  * for newly created vertices, edges, tris, and tets, we append them to the parameter vectors.
 */
-void Tet::subdivide(const double time, vector<Vertex*>& new_verts, vector<Edge*>& new_edges, vector<Triangle*>& new_tris, vector<Tet*>& new_tets)
+void Tet::subdivide(const double time, const FieldStore* store, vector<Vertex*>& new_verts, vector<Edge*>& new_edges, vector<Triangle*>& new_tris, vector<Tet*>& new_tets)
 {
     /* check if this tet has edges
      * if not, create new edges and add these edges into new_edges
@@ -550,7 +445,7 @@ void Tet::subdivide(const double time, vector<Vertex*>& new_verts, vector<Edge*>
     // copy vertices
     double ws[4];
     unordered_map<Vertex*, Vertex*> vert_copies; vert_copies.reserve(4);
-    for(short i = 0; i < 4; i++) vert_copies[ verts[i] ] = get_vert_at(verts[i]->cords, time, ws, true, false);
+    for(short i = 0; i < 4; i++) vert_copies[ verts[i] ] = get_vert_at(verts[i]->cords, time, store, ws, true, false);
 
     // find edge middle points
     // keep track of newly created vertices
@@ -569,7 +464,7 @@ void Tet::subdivide(const double time, vector<Vertex*>& new_verts, vector<Edge*>
         Vertex* v2 = vert_copies[e->verts[1]]; // copied vertex
 
         Vector3d middle_cords = e->middle_pt();
-        Vertex* new_vert = this->get_vert_at(middle_cords, time, ws, true, false);
+        Vertex* new_vert = this->get_vert_at(middle_cords, time, store, ws, true, false);
         uniq_middle_points.push_back(new_vert);
 
         // create two new edges
@@ -720,7 +615,7 @@ void Tet::subdivide(const double time, vector<Vertex*>& new_verts, vector<Edge*>
 }
 
 
-Eigen::Matrix3d Tet::calc_Jacobian(const Vector3d& cords, const double time)
+Eigen::Matrix3d Tet::calc_Jacobian(const Vector3d& cords, const double time, const FieldStore* store)
 {
     double ws[4];
     if(!this->is_pt_inside(cords, true, ws)){
@@ -737,14 +632,14 @@ Eigen::Matrix3d Tet::calc_Jacobian(const Vector3d& cords, const double time)
 
     Vertex* v_dpx, *v_dpy, * v_dpz, *v_dnx, *v_dny, *v_dnz;
     // interpolate
-    v_dpx = this->get_vert_at(px_cords, time, ws, true, false);
-    v_dnx = this->get_vert_at(nx_cords, time, ws, true, false);
+    v_dpx = this->get_vert_at(px_cords, time, store, ws, true, false);
+    v_dnx = this->get_vert_at(nx_cords, time, store, ws, true, false);
 
-    v_dpy = this->get_vert_at(py_cords, time, ws, true, false);
-    v_dny = this->get_vert_at(ny_cords, time, ws, true, false);
+    v_dpy = this->get_vert_at(py_cords, time, store, ws, true, false);
+    v_dny = this->get_vert_at(ny_cords, time, store, ws, true, false);
 
-    v_dpz = this->get_vert_at(pz_cords, time, ws, true, false);
-    v_dnz = this->get_vert_at(nz_cords, time, ws, true, false);
+    v_dpz = this->get_vert_at(pz_cords, time, store, ws, true, false);
+    v_dnz = this->get_vert_at(nz_cords, time, store, ws, true, false);
 
     Vector3d dvx = (*v_dpx->vels[time]) - (*v_dnx->vels[time]);
     Vector3d dvy = (*v_dpy->vels[time]) - (*v_dny->vels[time]);
@@ -10,6 +10,7 @@
 class Vertex;
 class Edge;
 class Triangle;
+class FieldStore;
 
 using namespace std;
 
@@ -17,7 +18,6 @@ class Tet {
 public:
     // member variables
     unsigned long idx;
-    unordered_map<double, unsigned char> marching_idices;
     vector<Vertex*> verts;  // exact 4 verts that consists of this tetrahedron
     vector<Edge*> edges;    // exact 4 edges that consists of this tetrahedron
     vector<Triangle*> tris;    // exact 4 triangles that consists of this tetrahedron
@@ -45,15 +45,17 @@ public:
     bool has_verts(const Vertex*, const Vertex*, const Vertex*) const;
     bool has_triangle(const Vertex*, const Vertex*, const Vertex*) const;
     bool has_edge(const Vertex*, const Vertex*) const;
+    Edge* get_edge(const Vertex*, const Vertex*) const;
     bool has_boundary_tri() const;
 
 
-    Vertex* get_vert_at(const Vector3d& v, const double time, double ws[4], bool cal_ws = true, bool add_this_tet = true);
-    Vertex* get_vert_at(const double time, double ws[4]) const;
+    // store is the field store of the mesh of this tet, NULL for a tet made on its own, see Vertex::vel_at()
+    Vertex* get_vert_at(const Vector3d& v, const double time, const FieldStore* store, double ws[4], bool cal_ws = true, bool add_this_tet = true);
+    Vertex* get_vert_at(const double time, const FieldStore* store, double ws[4]) const;
     double volume() const;
     Vector3d centroid() const;
 
-    Tet* clone(const double time) const;
+    Tet* clone(const double time, const FieldStore* store) const;
 
     Vector3d actual_normal_of( unsigned char tri_idx ) const;
     Vertex* missing_vertex(Vertex* v1, Vertex*v2, Vertex* v3) const;
@@ -63,15 +65,12 @@ public:
     void bary_tet(const Vector3d & p, double ds[4]) const;
     bool is_pt_in2(const Vector3d& p, double ds[4]) const;
 
-    void calc_marching_indices(unsigned int num_time_steps);
-
-    vector<Triangle*> create_isosurface_tris(const double& time);
-    Triangle* create_isosurface_tris_case1234( const Vertex* v, const double time );
-    vector<Triangle*> create_isosurface_tris_case567( const Vertex* v1, const Vertex* v2, const double time );
+    void create_isosurface_tris(const double time, const FieldStore* store, const unsigned char marching_idx, const double iso_val,
+                                const double* vert_vals, vector<Vertex*>& new_verts, vector<Triangle*>& new_tris);
     void make_edges();
     void make_triangles();
-    void subdivide(const double time, vector<Vertex*>& new_verts, vector<Edge*>& new_edges, vector<Triangle*>& temp_tris, vector<Tet*>& new_tets);
-    Eigen::Matrix3d calc_Jacobian(const Vector3d& cords, const double time);
+    void subdivide(const double time, const FieldStore* store, vector<Vertex*>& new_verts, vector<Edge*>& new_edges, vector<Triangle*>& temp_tris, vector<Tet*>& new_tets);
+    Eigen::Matrix3d calc_Jacobian(const Vector3d& cords, const double time, const FieldStore* store);
 };
 
 bool is_same_side(const Vector3d&, const Vector3d&, const Vector3d&, const Vector3d&, const Vector3d&);
@@ -0,0 +1,88 @@
+#include "Geometry/Topology.h"
+#include "Others/Parallel.h"
+#include <cmath>
+
+Topology::Topology()
+{
+    // reserve vector memories to save time
+    this->edges.reserve(100000);
+    this->tris.reserve(100000);
+}
+
+
+Topology::~Topology()
+{
+    for(Vertex* v : this->verts) delete v;
+    for(Edge* e : this->edges) delete e;
+    for(Triangle* tri : this->tris) delete tri;
+    for(Tet* tet : this->tets) delete tet;
+    this->verts.clear();
+    this->edges.clear();
+    this->tris.clear();
+    this->tets.clear();
+    this->boundary_tris.clear();
+}
+
+
+// flatten the tet-vertex connectivity and invert the edge matrix of every tet
+// called once the tets are read, the geometry doesn't change over time
+void Topology::build_arrays()
+{
+    if(!this->tet_verts.empty()) return;
+
+    const UL num_verts = this->verts.size();
+    const UL num_tets = this->tets.size();
+    this->tet_verts.resize(4 * num_tets);
+    this->tet_inv_edges.resize(9 * num_tets);
+
+    Utility::parallel_for(0, num_tets, [&](const UL begin, const UL end){
+        for(UL t = begin; t < end; t++){
+            const Tet* tet = this->tets[t];
+            for(unsigned char k = 0; k < 4; k++) this->tet_verts[4*t + k] = tet->verts[k]->idx;
+
+            // rows of D are the edge vectors p_k - p_0
+            const Vertex* v0 = tet->verts[0];
+            double D[3][3];
+            for(unsigned char k = 0; k < 3; k++){
+                for(unsigned char j = 0; j < 3; j++){
+                    D[k][j] = tet->verts[k+1]->cords.entry[j] - v0->cords.entry[j];
+                }
+            }
+
+            // inverse of D by cofactors, a degenerated tet gets a zero gradient
+            double* inv = this->tet_inv_edges.data() + 9*t;
+            const double c00 = D[1][1]*D[2][2] - D[1][2]*D[2][1];
+            const double c01 = D[1][2]*D[2][0] - D[1][0]*D[2][2];
+            const double c02 = D[1][0]*D[2][1] - D[1][1]*D[2][0];
+            const double det = D[0][0]*c00 + D[0][1]*c01 + D[0][2]*c02;
+            if(fabs(det) < 1e-300){
+                for(unsigned char k = 0; k < 9; k++) inv[k] = 0.;
+                continue;
+            }
+            const double inv_det = 1. / det;
+            inv[0] = c00 * inv_det;
+            inv[1] = (D[0][2]*D[2][1] - D[0][1]*D[2][2]) * inv_det;
+            inv[2] = (D[0][1]*D[1][2] - D[0][2]*D[1][1]) * inv_det;
+            inv[3] = c01 * inv_det;
+            inv[4] = (D[0][0]*D[2][2] - D[0][2]*D[2][0]) * inv_det;
+            inv[5] = (D[0][2]*D[1][0] - D[0][0]*D[1][2]) * inv_det;
+            inv[6] = c02 * inv_det;
+            inv[7] = (D[0][1]*D[2][0] - D[0][0]*D[2][1]) * inv_det;
+            inv[8] = (D[0][0]*D[1][1] - D[0][1]*D[1][0]) * inv_det;
+        }
+    });
+
+    // vertex -> tets in compressed rows, so vertex averages can run in parallel without locks
+    this->vert_tet_starts.assign(num_verts + 1, 0);
+    for(UL t = 0; t < num_tets; t++){
+        for(unsigned char k = 0; k < 4; k++) this->vert_tet_starts[ this->tet_verts[4*t + k] + 1 ]++;
+    }
+    for(UL i = 0; i < num_verts; i++){
+        this->vert_tet_starts[i + 1] += this->vert_tet_starts[i];
+    }
+    this->vert_tet_ids.resize(4 * num_tets);
+    vector<UL> fill(this->vert_tet_starts.begin(), this->vert_tet_starts.end() - 1);
+    for(UL t = 0; t < num_tets; t++){
+        for(unsigned char k = 0; k < 4; k++) this->vert_tet_ids[ fill[this->tet_verts[4*t + k]]++ ] = t;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <vector>
+#include <QByteArray>
+
+#include "Geometry/Vertex.h"
+#include "Geometry/Edge.h"
+#include "Geometry/Triangle.h"
+#include "Geometry/Tet.h"
+#include "Others/Predefined.h"
+#include "Others/Vector3d.h"
+
+using namespace std;
+
+// the vertices, edges, triangles and tets of a mesh file with the links between them
+// it is built once when the file is read and doesn't change afterwards, so datasets on the same mesh file
+// can share one, see Mesh::topology. the field data of a dataset is read through its FieldStore
+class Topology {
+public:
+    vector<Vertex*> verts;
+    vector<Edge*> edges;
+    vector<Triangle*> tris;
+    vector<Tet*> tets;
+
+    vector<Triangle*> boundary_tris;
+
+    Vector3d rot_center;
+    QByteArray hash; // SHA-1 of the mesh file, empty if it wasn't hashed
+
+    // the tets in flat arrays for the FieldStore and the batched kernels, see build_arrays()
+    vector<UL> tet_verts;       // 4 vertex indices per tet
+    vector<double> tet_inv_edges; // inverse of the edge matrix of each tet, 9 doubles per tet
+    vector<UL> vert_tet_starts; // tets around vertex i are vert_tet_ids[ vert_tet_starts[i], vert_tet_starts[i+1] )
+    vector<UL> vert_tet_ids;
+
+    Topology();
+    ~Topology();
+
+    void build_arrays();
+};
+
+#endif // TOPOLOGY_H
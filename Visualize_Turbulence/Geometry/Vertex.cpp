@@ -1,6 +1,7 @@
 #include "Geometry/Vertex.h"
 #include "Geometry/Edge.h"
 #include "Others/Utilities.h"
+#include "Analysis/FieldStore.h"
 
 // destructor
 Vertex::~Vertex()
@@ -27,7 +28,7 @@ Vertex::~Vertex()
 // set vel at time t
 void Vertex::set_vel(const double time, Vector3d *vel_ptr)
 {
-    if(has_vel_at_t(time)) {
+    if(has_vel_at_t(time, NULL)) {
         qDebug() << "trying to add vel at time " << time << ", which already exists";
         return;
     }
@@ -40,7 +41,7 @@ void Vertex::set_vel(const double time, Vector3d *vel_ptr)
 // set vel at time t
 void Vertex::set_vel(const double time, const double vx, const double vy, const double vz)
 {
-    if(has_vel_at_t(time)) {
+    if(has_vel_at_t(time, NULL)) {
         qDebug() << "trying to add vel at time " << time << ", which already exists";
         return;
     }
@@ -53,7 +54,7 @@ void Vertex::set_vel(const double time, const double vx, const double vy, const
 // set vor at time t
 void Vertex::set_vor(const double time, Vector3d *vor_ptr)
 {
-    if(has_vor_at_t(time)) {
+    if(has_vor_at_t(time, NULL)) {
         qDebug() << "trying to add vor at time " << time << ", which already exists";
         return;
     }
@@ -66,7 +67,7 @@ void Vertex::set_vor(const double time, Vector3d *vor_ptr)
 // set vor at time t
 void Vertex::set_vor(const double time, const double vx, const double vy, const double vz)
 {
-    if(has_vor_at_t(time)) {
+    if(has_vor_at_t(time, NULL)) {
         qDebug() << "trying to add vor at time " << time << ", which already exists";
         return;
     }
@@ -79,7 +80,7 @@ void Vertex::set_vor(const double time, const double vx, const double vy, const
 // set mu at time t
 void Vertex::set_mu(const double time, const double mu)
 {
-    if(has_mu_at_t(time)) {
+    if(has_mu_at_t(time, NULL)) {
         qDebug() << "trying to add mu at time " << time << ", which already exists";
         return;
     }
@@ -87,13 +88,72 @@ void Vertex::set_mu(const double time, const double mu)
 }
 
 
+// return false if vel at time t does not exist
+bool Vertex::has_vel_at_t(const double time, const FieldStore* store) const
+{
+    if(store != NULL && store->is_paged()) return (loaded_fields & RAW_VELOCITY) && store->has_frame(time);
+    if(vels.find(time) == vels.end()) return false;
+    return true;
+}
+
+
+// return false if vor at time t does not exist
+bool Vertex::has_vor_at_t(const double time, const FieldStore* store) const
+{
+    if(store != NULL && store->is_paged()) return (loaded_fields & RAW_VORTICITY) && store->has_frame(time);
+    if(vors.find(time) == vors.end()) return false;
+    return true;
+}
+
+
+// return false if mu at time t does not exist
+bool Vertex::has_mu_at_t(const double time, const FieldStore* store) const
+{
+    if(store != NULL && store->is_paged()) return (loaded_fields & RAW_MU) && store->has_frame(time);
+    if(mus.find(time) == mus.end()) return false;
+    return true;
+}
+
+
+// the velocity at time, from the pinned frame of store if the data is paged
+// a field that isn't in loaded_fields is 0, so vertices made from others can still copy all of their fields
+Vector3d Vertex::vel_at(const double time, const FieldStore* store) const
+{
+    if(!(loaded_fields & RAW_VELOCITY)) return Vector3d(0., 0., 0.);
+    if(store == NULL || !store->is_paged()) return Vector3d(this->vels.at(time));
+    return Vector3d(store->resident(time)->vels.data() + 3*this->idx);
+}
+
+
+Vector3d Vertex::vor_at(const double time, const FieldStore* store) const
+{
+    if(!(loaded_fields & RAW_VORTICITY)) return Vector3d(0., 0., 0.);
+    if(store == NULL || !store->is_paged()) return Vector3d(this->vors.at(time));
+    const FrameFields* ff = store->resident(time);
+    if(!ff->vors.empty()) return Vector3d(ff->vors.data() + 3*this->idx);
+
+    // derived from the velocity around the vertex, see derive_vorticity
+    double w[3];
+    store->calc_vert_vor(ff->vels.data(), this->idx, w);
+    return Vector3d(w);
+}
+
+
+double Vertex::mu_at(const double time, const FieldStore* store) const
+{
+    if(!(loaded_fields & RAW_MU)) return 0.;
+    if(store == NULL || !store->is_paged()) return this->mus.at(time);
+    return store->resident(time)->mus[this->idx];
+}
+
+
 // copy th following properties:
 // 1. the coordinates
 // 2. the velocity at time
-Vertex *Vertex::clone(const double time, const bool copy_vel = true) const
+Vertex *Vertex::clone(const double time, const FieldStore* store, const bool copy_vel = true) const
 {
     Vertex* new_v = new Vertex(this->x(), this->y(), this->z());
-    if(copy_vel) new_v->vels[time] = new Vector3d( this->vels.at(time) );
+    if(copy_vel) new_v->vels[time] = new Vector3d( this->vel_at(time, store) );
 
     return new_v;
 }
@@ -119,16 +179,16 @@ Vector3d* Vertex::linear_interpolate_vel(const double target_t)
 
     if(target_t < t1 || target_t > t2 || t1 > t2) return NULL;
     if(target_t == t1) {
-        if ( this->has_vel_at_t(t1) ) return this->vels.at(t1);
+        if ( this->has_vel_at_t(t1, NULL) ) return this->vels.at(t1);
         else return NULL;
     }
 
     if(target_t == t2) {
-        if ( this->has_vel_at_t(t2) ) return this->vels.at(t2);
+        if ( this->has_vel_at_t(t2, NULL) ) return this->vels.at(t2);
         else return NULL;
     }
 
-    if(this->has_vel_at_t(target_t)) return this->vels.at(target_t); // return the velocity vector if exists
+    if(this->has_vel_at_t(target_t, NULL)) return this->vels.at(target_t); // return the velocity vector if exists
 
     // at this point we know that the target_t is never calculated and is somewhere between t1 and t2, exclusively.
     const Vector3d& v1 = Vector3d(vels.at(t1));
@@ -155,7 +215,7 @@ Vector3d* Vertex::linear_interpolate_vor(const double target_t)
     if(target_t < t1 || target_t > t2 || t1 > t2) return NULL;
     if(target_t == t1) return this->vors.at(t1);
     if(target_t == t2) return this->vors.at(t2);
-    if(this->has_vor_at_t(target_t)) return this->vors.at(target_t); // return the vorticity vector if exists
+    if(this->has_vor_at_t(target_t, NULL)) return this->vors.at(target_t); // return the vorticity vector if exists
 
     // at this point we know that the target_t is never calculated and is somewhere between t1 and t2, exclusively.
     const Vector3d& v1 = Vector3d(vors.at(t1));
@@ -182,7 +242,7 @@ double Vertex::linear_interpolate_mu(const double target_t)
     if(target_t < t1 || target_t > t2 || t1 > t2) return 0.0;
     if(target_t == t1) return this->mus.at(t1);
     if(target_t == t2) return this->mus.at(t2);
-    if(this->has_mu_at_t(target_t)) return this->mus.at(target_t); // return the velocity vector if exist
+    if(this->has_mu_at_t(target_t, NULL)) return this->mus.at(target_t); // return the velocity vector if exist
 
     // at this point we know that the target_t is never calculated and is somewhere between t1 and t2, exclusively.
     const double mu1 = mus.at(t1);
@@ -203,20 +263,20 @@ double Vertex::linear_interpolate_mu(const double target_t)
 
 QString Vertex::vel_str( const double time ) const
 {
-    if(vels.find(time) == vels.end()) return "time does not exist!";
+    if(!this->has_vel_at_t(time, NULL)) return "time does not exist!";
 
-    Vector3d* vel = vels.at(time);
-    QString str = QString( "%1, %2, %3" ).arg(vel->entry[0]).arg(vel->entry[1]).arg(vel->entry[2]);
+    const Vector3d vel = this->vel_at(time, NULL);
+    QString str = QString( "%1, %2, %3" ).arg(vel.entry[0]).arg(vel.entry[1]).arg(vel.entry[2]);
     return str;
 }
 
 
 QString Vertex::vor_str( const double time ) const
 {
-    if(vors.find(time) == vors.end()) return "time does not exist!";
+    if(!this->has_vor_at_t(time, NULL)) return "time does not exist!";
 
-    Vector3d* vor = vors.at(time);
-    QString str = QString( "%1, %2, %3" ).arg(vor->entry[0]).arg(vor->entry[1]).arg(vor->entry[2]);
+    const Vector3d vor = this->vor_at(time, NULL);
+    QString str = QString( "%1, %2, %3" ).arg(vor.entry[0]).arg(vor.entry[1]).arg(vor.entry[2]);
     return str;
 }
 
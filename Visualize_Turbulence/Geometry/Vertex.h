@@ -6,11 +6,13 @@
 #include <unordered_map>
 
 #include "Others/Vector3d.h"
+#include "Analysis/ScalarFields.h"
 
 // forward class declarations
 class Edge;
 class Triangle;
 class Tet;
+class FieldStore;
 
 using namespace std;
 
@@ -21,9 +23,6 @@ public:
     unsigned long idx;
     Vector3d cords;
 
-    // at each time step, is this vertex above the surface level
-    unordered_map<double, bool> is_above_surface;
-
     // velocity vectors
     unordered_map<double, Vector3d*> vels; // <time, velocity>
     // vorticity vectors
@@ -65,11 +64,16 @@ public:
     inline double x() const;
     inline double y() const;
     inline double z() const;
-    inline bool has_vel_at_t(const double time) const;
-    inline bool has_vor_at_t(const double time) const;
-    inline bool has_mu_at_t(const double time) const;
-
-    Vertex* clone(const double time, const bool copy_vel) const;
+    // store is the field store of the mesh the vertex belongs to, NULL for one made on its own
+    // the maps above are read unless the store is paged, the vertex may be shared by datasets then
+    bool has_vel_at_t(const double time, const FieldStore* store) const;
+    bool has_vor_at_t(const double time, const FieldStore* store) const;
+    bool has_mu_at_t(const double time, const FieldStore* store) const;
+    Vector3d vel_at(const double time, const FieldStore* store) const;
+    Vector3d vor_at(const double time, const FieldStore* store) const;
+    double mu_at(const double time, const FieldStore* store) const;
+
+    Vertex* clone(const double time, const FieldStore* store, const bool copy_vel) const;
     bool is_connected_to(const Vertex* vert) const;
 
     Vector3d* linear_interpolate_vel(const double target_t);
@@ -163,30 +167,6 @@ inline void Vertex::set_cords(const double x, const double y, const double z)
 }
 
 
-// return false if vel at time t does not exist
-inline bool Vertex::has_vel_at_t(const double time) const
-{
-    if(vels.find(time) == vels.end()) return false;
-    return true;
-}
-
-
-// return false if vor at time t does not exist
-inline bool Vertex::has_vor_at_t(const double time) const
-{
-    if(vors.find(time) == vors.end()) return false;
-    return true;
-}
-
-
-// return false if mu at time t does not exist
-inline bool Vertex::has_mu_at_t(const double time) const
-{
-    if(mus.find(time) == mus.end()) return false;
-    return true;
-}
-
-
 inline double Vertex::x() const
 {
     return this->cords.x();
@@ -0,0 +1,31 @@
+#ifndef FLOWKERNELS_H
+#define FLOWKERNELS_H
+
+#include "Others/Predefined.h"
+
+class FlowSampler;
+class ParticleBatch;
+
+// the batched kernels of FlowSampler built for one instruction set, see Lines/FlowKernels.inc
+// they are built once per instruction set, scalar in FlowKernelsScalar.cpp, AVX2 in FlowKernelsAvx2.cpp and
+// AVX-512 in FlowKernelsAvx512.cpp, each with target attributes, so nothing else is built for a newer cpu
+struct FlowKernels{
+    UI width;               // particles advanced at once
+    const char* isa_name;
+    void (*rk4_batch)(const FlowSampler& sampler, ParticleBatch& batch, const UL begin, const UL end, const double t,
+                      const double dt, const UI num_steps);
+    void (*euler_batch)(const FlowSampler& sampler, ParticleBatch& batch, const UL begin, const UL end, const double t,
+                        const double ds, double* speeds);
+    void (*speed_batch)(const FlowSampler& sampler, ParticleBatch& batch, const UL begin, const UL end, const double t,
+                        double* speeds);
+};
+
+// NULL where the instruction set can't be built, off x86 or with MSVC
+extern const FlowKernels* const scalar_flow_kernels;
+extern const FlowKernels* const avx2_flow_kernels;
+extern const FlowKernels* const avx512_flow_kernels;
+
+// the widest kernels the cpu runs, picked the first time it is called
+const FlowKernels& flow_kernels();
+
+#endif // FLOWKERNELS_H
@@ -0,0 +1,4 @@
+// the batched kernels built for AVX2 and FMA, see Lines/FlowKernels.h
+#define SIMD_AVX2
+#define SIMD_KERNELS avx2_flow_kernels
+#include "Lines/FlowKernels.inc"
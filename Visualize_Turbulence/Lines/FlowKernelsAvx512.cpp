@@ -0,0 +1,4 @@
+// the batched kernels built for AVX-512, see Lines/FlowKernels.h
+#define SIMD_AVX512
+#define SIMD_KERNELS avx512_flow_kernels
+#include "Lines/FlowKernels.inc"
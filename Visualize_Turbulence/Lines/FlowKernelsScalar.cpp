@@ -0,0 +1,3 @@
+// the batched kernels built for a single scalar lane, see Lines/FlowKernels.h
+#define SIMD_KERNELS scalar_flow_kernels
+#include "Lines/FlowKernels.inc"
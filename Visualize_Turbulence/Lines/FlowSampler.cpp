@@ -0,0 +1,257 @@
+#include "Lines/FlowSampler.h"
+#include "Others/Utilities.h"
+#include "Others/Parallel.h"
+#include "Lines/FlowKernels.h"
+#include "Others/Simd.h"
+#include <QElapsedTimer>
+
+// a point counts as inside a tet down to this barycentric coordinate
+static const double inside_eps = -1e-10;
+
+// gather every raw frame once, the flat arrays are shared with the mesh field store
+// the frames of a paged mesh are only looked up, they are loaded when they are pinned
+FlowSampler::FlowSampler(Mesh* mesh)
+{
+    this->num_frames = mesh->num_time_steps;
+    this->num_tets = mesh->num_tets();
+
+    this->frames.resize(this->num_frames);
+    for(UL i = 0; i < this->num_frames; i++){
+        this->frames[i] = mesh->field_store.frame_slot(mesh, (double) i);
+    }
+    this->tet_verts = mesh->topology->tet_verts.data();
+    this->tet_inv_edges = mesh->topology->tet_inv_edges.data();
+
+    const UL num_verts = mesh->num_verts();
+    this->cords.resize(3 * num_verts);
+    for(UL i = 0; i < num_verts; i++){
+        for(unsigned char j = 0; j < 3; j++) this->cords[3*i + j] = mesh->verts[i]->cords.entry[j];
+    }
+
+    // neighbor across the face opposite to each local vertex
+    this->tet_nbrs.assign(4 * this->num_tets, -1);
+    for(UL t = 0; t < this->num_tets; t++){
+        const Tet* tet = mesh->tets[t];
+        for(unsigned char k = 0; k < 4; k++){
+            for(const Triangle* tri : tet->tris){
+                if(tri->has_vert(tet->verts[k])) continue;
+                if(tri->is_boundary) break;
+                for(const Tet* other : tri->tets){
+                    if(other != tet) this->tet_nbrs[4*t + k] = other->idx;
+                }
+                break;
+            }
+        }
+    }
+}
+
+
+FlowSampler::~FlowSampler()
+{
+    this->cords.clear();
+    this->tet_nbrs.clear();
+    this->frames.clear();
+}
+
+
+// barycentric coordinates of p in tet, bary[k] belongs to local vertex k
+// p - p0 = D^T * l, so l = D^-T * (p - p0) with the inverse edge matrix kept by the field store
+void FlowSampler::bary_of(const long tet, const double p[3], double bary[4]) const
+{
+    const UL* tv = this->tet_verts + 4*tet;
+    const double* inv = this->tet_inv_edges + 9*tet;
+    const double* p0 = this->cords.data() + 3*tv[0];
+    const double d0 = p[0] - p0[0], d1 = p[1] - p0[1], d2 = p[2] - p0[2];
+    bary[1] = inv[0]*d0 + inv[3]*d1 + inv[6]*d2;
+    bary[2] = inv[1]*d0 + inv[4]*d1 + inv[7]*d2;
+    bary[3] = inv[2]*d0 + inv[5]*d1 + inv[8]*d2;
+    bary[0] = 1. - bary[1] - bary[2] - bary[3];
+}
+
+
+// walk from tet towards p through the neighbor opposite to the most negative barycentric coordinate
+// tet is updated to the containing tet. return false if p leaves the mesh or the walk doesn't end.
+bool FlowSampler::locate(const double p[3], long& tet, double bary[4]) const
+{
+    if(tet < 0) return false;
+    const unsigned int max_walk = 1000;
+    const double eps = inside_eps;
+    for(unsigned int step = 0; step < max_walk; step++){
+        this->bary_of(tet, p, bary);
+        unsigned char min_k = 0;
+        for(unsigned char k = 1; k < 4; k++){
+            if(bary[k] < bary[min_k]) min_k = k;
+        }
+        if(bary[min_k] >= eps) return true;
+
+        const long next = this->tet_nbrs[4*tet + min_k];
+        if(next < 0) return false; // left through a boundary face
+        tet = next;
+    }
+    return false;
+}
+
+
+// velocity at p and time t, linear in space inside the tet and linear in time between two raw frames
+bool FlowSampler::velocity_at(const double p[3], const double t, long& tet, double vel[3]) const
+{
+    if(t < this->t_min() || t > this->t_max()) return false;
+    double bary[4];
+    if(!this->locate(p, tet, bary)) return false;
+
+    UL frame = (UL) t;
+    if(frame >= this->num_frames - 1) frame = this->num_frames > 1 ? this->num_frames - 2 : 0;
+    const double a = this->num_frames > 1 ? t - frame : 0.;
+    const double* v0 = this->frames[frame]->vels.data();
+    const double* v1 = this->num_frames > 1 ? this->frames[frame + 1]->vels.data() : v0;
+
+    const UL* tv = this->tet_verts + 4*tet;
+    vel[0] = vel[1] = vel[2] = 0.;
+    for(unsigned char k = 0; k < 4; k++){
+        const double w0 = bary[k] * (1. - a), w1 = bary[k] * a;
+        for(unsigned char j = 0; j < 3; j++){
+            vel[j] += w0 * v0[3*tv[k] + j] + w1 * v1[3*tv[k] + j];
+        }
+    }
+    return true;
+}
+
+
+// one classical Runge-Kutta step in space-time, p is advanced by dt from time t
+// tet is the containing tet of p before and after the step
+bool FlowSampler::rk4_step(double p[3], const double t, const double dt, long& tet) const
+{
+    double k1[3], k2[3], k3[3], k4[3], q[3];
+    long cur = tet;
+    if(!this->velocity_at(p, t, cur, k1)) return false;
+
+    for(unsigned char j = 0; j < 3; j++) q[j] = p[j] + 0.5 * dt * k1[j];
+    if(!this->velocity_at(q, t + 0.5 * dt, cur, k2)) return false;
+
+    for(unsigned char j = 0; j < 3; j++) q[j] = p[j] + 0.5 * dt * k2[j];
+    if(!this->velocity_at(q, t + 0.5 * dt, cur, k3)) return false;
+
+    for(unsigned char j = 0; j < 3; j++) q[j] = p[j] + dt * k3[j];
+    if(!this->velocity_at(q, t + dt, cur, k4)) return false;
+
+    for(unsigned char j = 0; j < 3; j++) q[j] = p[j] + dt / 6. * (k1[j] + 2.*k2[j] + 2.*k3[j] + k4[j]);
+    double bary[4];
+    if(!this->locate(q, cur, bary)) return false;
+
+    p[0] = q[0]; p[1] = q[1]; p[2] = q[2];
+    tet = cur;
+    return true;
+}
+
+
+
+
+// the kernels of the widest instruction set the cpu supports, AVX needs the os to save its registers too,
+// which __builtin_cpu_supports checks
+static const FlowKernels* pick_flow_kernels()
+{
+#if SIMD_X86_TARGETS
+    __builtin_cpu_init();
+    if(avx512_flow_kernels != NULL && __builtin_cpu_supports("avx512f")) return avx512_flow_kernels;
+    if(avx2_flow_kernels != NULL && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return avx2_flow_kernels;
+#endif
+    return scalar_flow_kernels;
+}
+
+
+const FlowKernels& flow_kernels()
+{
+    static const FlowKernels* const kernels = pick_flow_kernels();
+    return *kernels;
+}
+
+
+// the batched kernels run flow_kernels().width particles at a time, see Lines/FlowKernels.h
+void FlowSampler::rk4_batch(ParticleBatch& batch, const UL begin, const UL end, const double t, const double dt,
+                            const UI num_steps) const
+{
+    flow_kernels().rk4_batch(*this, batch, begin, end, t, dt, num_steps);
+}
+
+
+void FlowSampler::euler_batch(ParticleBatch& batch, const UL begin, const UL end, const double t, const double ds,
+                              double* speeds) const
+{
+    flow_kernels().euler_batch(*this, batch, begin, end, t, ds, speeds);
+}
+
+
+void FlowSampler::speed_batch(ParticleBatch& batch, const UL begin, const UL end, const double t, double* speeds) const
+{
+    flow_kernels().speed_batch(*this, batch, begin, end, t, speeds);
+}
+
+
+// particle-steps per second of the scalar RK4 step against the batched kernel
+// both run on all cores from the same seeds, the largest position difference is reported as a check
+void benchmark_advection(Mesh* mesh)
+{
+    const FlowSampler sampler(mesh);
+    const UL num_particles = mesh->num_tets() < 65536 ? mesh->num_tets() : 65536;
+    const UI num_steps = 100;
+    const double dt = pathline_time_step * num_steps <= sampler.t_max() ? pathline_time_step : sampler.t_max() / num_steps;
+    if(num_particles == 0 || dt <= 0.) return;
+    const FrameHandle frames = mesh->field_store.pin_range(mesh, 0., dt * num_steps);
+
+    // seeds at tet centers spread over the whole mesh
+    ParticleBatch seeds;
+    seeds.resize(num_particles);
+    const UL stride = mesh->num_tets() / num_particles;
+    for(UL i = 0; i < num_particles; i++){
+        const UL t = i * stride;
+        const Vector3d& c = mesh->tets[t]->center;
+        const double p[3] = {c.x(), c.y(), c.z()};
+        seeds.set(i, p, (long) t);
+    }
+
+    // scalar
+    ParticleBatch scalar = seeds;
+    QElapsedTimer timer;
+    timer.start();
+    Utility::parallel_for(0, num_particles, [&](const UL begin, const UL end){
+        for(UL i = begin; i < end; i++){
+            double p[3] = {scalar.x[i], scalar.y[i], scalar.z[i]};
+            long tet = scalar.tets[i];
+            for(UI step = 0; step < num_steps; step++){
+                if(!sampler.rk4_step(p, step * dt, dt, tet)){
+                    tet = -1;
+                    break;
+                }
+            }
+            scalar.set(i, p, tet);
+        }
+    }, 256);
+    const double scalar_secs = timer.nsecsElapsed() / 1e9;
+
+    // batched
+    ParticleBatch batched = seeds;
+    timer.restart();
+    Utility::parallel_for(0, num_particles, [&](const UL begin, const UL end){
+        sampler.rk4_batch(batched, begin, end, 0., dt, num_steps);
+    }, 256);
+    const double batched_secs = timer.nsecsElapsed() / 1e9;
+
+    double max_diff = 0.;
+    UL num_alive = 0, num_mismatch = 0;
+    for(UL i = 0; i < num_particles; i++){
+        if(scalar.alive(i) != batched.alive(i)){
+            num_mismatch++;
+            continue;
+        }
+        if(!scalar.alive(i)) continue;
+        num_alive++;
+        const double d = fabs(scalar.x[i] - batched.x[i]) + fabs(scalar.y[i] - batched.y[i]) + fabs(scalar.z[i] - batched.z[i]);
+        if(d > max_diff) max_diff = d;
+    }
+
+    const double particle_steps = (double) num_particles * num_steps;
+    qDebug() << "Advection benchmark:" << num_particles << "particles," << num_steps << "RK4 steps," << Utility::num_threads() << "threads";
+    qDebug() << "  scalar :" << particle_steps / scalar_secs << "particle-steps/sec";
+    qDebug() << "  batched:" << particle_steps / batched_secs << "particle-steps/sec (" << flow_kernels().isa_name << "," << flow_kernels().width << "lanes )";
+    qDebug() << "  " << num_alive << "particles stayed inside," << num_mismatch << "ended differently, max position difference" << max_diff;
+}
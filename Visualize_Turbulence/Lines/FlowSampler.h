@@ -0,0 +1,104 @@
+#ifndef FLOWSAMPLER_H
+#define FLOWSAMPLER_H
+
+#include <vector>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+class FrameFields;
+
+// particles in structure of arrays layout, the batched kernels advance them flow_kernels().width at a time
+// a particle whose tet is -1 has left the mesh (or the time range) and is skipped by the kernels
+class ParticleBatch{
+public:
+    vector<double> x, y, z;
+    vector<long> tets;
+
+    inline UL size() const;
+    inline void resize(const UL n);
+    inline void set(const UL i, const double p[3], const long tet);
+    inline bool alive(const UL i) const;
+};
+
+
+// read-only, flat view of a mesh and its velocity frames for particle tracing
+// it is built once on the main thread and is then safe to query from any number of threads.
+// the velocity of each raw frame (t = 0, 1, ..., num_frames-1) comes from the mesh field store,
+// in between two frames it is interpolated linearly in time. if the field data of the mesh is paged,
+// the frames a query touches have to be pinned, see FieldStore::pin() and pin_range().
+class FlowSampler{
+public:
+    UL num_frames;
+    UL num_tets;
+    vector<double> cords;   // 3 doubles per vertex
+    vector<long> tet_nbrs;  // 4 per tet, the neighbor across the face opposite to local vertex k, -1 on the boundary
+    const UL* tet_verts;    // 4 vertex indices per tet, owned by the mesh topology
+    const double* tet_inv_edges; // inverse edge matrix of each tet, owned by the mesh topology
+    vector<const FrameFields*> frames; // each raw frame, owned by the mesh field store
+
+    FlowSampler(Mesh* mesh);
+    ~FlowSampler();
+
+    inline double t_min() const;
+    inline double t_max() const;
+
+    void bary_of(const long tet, const double p[3], double bary[4]) const;
+    bool locate(const double p[3], long& tet, double bary[4]) const;
+    bool velocity_at(const double p[3], const double t, long& tet, double vel[3]) const;
+    bool rk4_step(double p[3], const double t, const double dt, long& tet) const;
+
+    // batched kernels of the widest instruction set of the cpu, see Lines/FlowKernels.h
+    void rk4_batch(ParticleBatch& batch, const UL begin, const UL end, const double t, const double dt,
+                   const UI num_steps = 1) const;
+    void euler_batch(ParticleBatch& batch, const UL begin, const UL end, const double t, const double ds,
+                     double* speeds = nullptr) const;
+    void speed_batch(ParticleBatch& batch, const UL begin, const UL end, const double t, double* speeds) const;
+};
+
+void benchmark_advection(Mesh* mesh);
+
+
+inline UL ParticleBatch::size() const
+{
+    return this->tets.size();
+}
+
+
+inline void ParticleBatch::resize(const UL n)
+{
+    this->x.resize(n);
+    this->y.resize(n);
+    this->z.resize(n);
+    this->tets.resize(n, -1);
+}
+
+
+inline void ParticleBatch::set(const UL i, const double p[3], const long tet)
+{
+    this->x[i] = p[0];
+    this->y[i] = p[1];
+    this->z[i] = p[2];
+    this->tets[i] = tet;
+}
+
+
+inline bool ParticleBatch::alive(const UL i) const
+{
+    return this->tets[i] >= 0;
+}
+
+
+inline double FlowSampler::t_min() const
+{
+    return 0.;
+}
+
+
+inline double FlowSampler::t_max() const
+{
+    return this->num_frames > 0 ? (double) (this->num_frames - 1) : 0.;
+}
+
+#endif // FLOWSAMPLER_H
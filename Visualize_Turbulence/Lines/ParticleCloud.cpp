@@ -0,0 +1,327 @@
+#include "Lines/ParticleCloud.h"
+#include "Others/Utilities.h"
+#include <algorithm>
+#include <random>
+#include <float.h>
+#include <QElapsedTimer>
+
+// the cloud is seeded at t = 0 and the driver thread waits for the first request
+ParticleCloud::ParticleCloud(Mesh* mesh, const UL num_particles) : mesh(mesh), sampler(mesh)
+{
+    this->sim_time = 0.;
+    this->num_frames_done = 0;
+    this->requested_time = 0.;
+    this->has_request = false;
+    this->stopping = false;
+
+    this->particles.resize(num_particles);
+    this->speeds.resize(num_particles);
+    for(CloudFrame& frame : this->frames){
+        frame.pts.assign(3 * num_particles, 0.f);
+        frame.colors.assign(3 * num_particles, 0);
+        frame.time = 0.;
+        frame.min_speed = frame.max_speed = 0.;
+    }
+    this->front = &this->frames[0];
+    this->back = &this->frames[1];
+
+    // tets are picked in proportion to their volume when seeding inside
+    this->tet_volume_cdf.resize(mesh->num_tets());
+    double sum = 0.;
+    for(UL i = 0; i < mesh->num_tets(); i++){
+        sum += mesh->tets[i]->volume();
+        this->tet_volume_cdf[i] = sum;
+    }
+
+    for(const Triangle* tri : mesh->boundary_tris){
+        if(tri->num_verts() < 3 || tri->num_tets() == 0) continue;
+        BoundaryFace face;
+        for(unsigned char k = 0; k < 3; k++){
+            for(unsigned char j = 0; j < 3; j++) face.pts[3*k + j] = tri->verts[k]->cords.entry[j];
+        }
+        const Vector3d e1 = tri->verts[1]->cords - tri->verts[0]->cords;
+        const Vector3d e2 = tri->verts[2]->cords - tri->verts[0]->cords;
+        Vector3d n = cross(e1, e2);
+        face.area = 0.5 * length(n);
+        if(face.area <= zero_threshold) continue;
+        normalize(n);
+        // orient the normal towards the tet behind the face
+        const Vector3d to_tet = tri->tets[0]->center - tri->verts[0]->cords;
+        if(dot(n, to_tet) < 0.) n = n * -1.;
+        for(unsigned char j = 0; j < 3; j++) face.inward[j] = n.entry[j];
+        face.tet = tri->tets[0]->idx;
+        this->faces.push_back(face);
+    }
+
+    for(UI i = 0; i < 256; i++){
+        const Vector3d color = CT.lookUp(i / 255.);
+        for(unsigned char j = 0; j < 3; j++){
+            double c = color.entry[j];
+            c = c < 0. ? 0. : (c > 1. ? 1. : c);
+            this->color_lut[3*i + j] = (unsigned char) (c * 255. + 0.5);
+        }
+    }
+
+    // the driver thread pins the frames it reads, the first frame is filled here
+    {
+        const FrameHandle frames = mesh->field_store.pin(mesh, 0.);
+        this->seed_all(0.);
+        this->fill_back();
+    }
+    this->swap_frames();
+
+    this->driver = thread(&ParticleCloud::run, this);
+    qDebug() << "Particle cloud:" << num_particles << "particles," << this->faces.size() << "boundary faces," << this->pool.size() << "threads";
+}
+
+
+ParticleCloud::~ParticleCloud()
+{
+    {
+        lock_guard<mutex> lock(this->request_mutex);
+        this->stopping = true;
+    }
+    this->request_cv.notify_all();
+    if(this->driver.joinable()) this->driver.join();
+}
+
+
+// ask for the particles at time, returns at once. the driver picks up only the newest request,
+// so if it falls behind the animation it skips frames instead of queueing them
+void ParticleCloud::request_time(const double time)
+{
+    {
+        lock_guard<mutex> lock(this->request_mutex);
+        this->requested_time = time;
+        this->has_request = true;
+    }
+    this->request_cv.notify_one();
+}
+
+
+// the front frame can't be swapped until unlock_front is called
+const CloudFrame* ParticleCloud::lock_front()
+{
+    this->front_mutex.lock();
+    return this->front;
+}
+
+
+void ParticleCloud::unlock_front()
+{
+    this->front_mutex.unlock();
+}
+
+
+void ParticleCloud::run()
+{
+    while(true){
+        double time;
+        {
+            unique_lock<mutex> lock(this->request_mutex);
+            this->request_cv.wait(lock, [this](){ return this->stopping || this->has_request; });
+            if(this->stopping) return;
+            time = this->requested_time;
+            this->has_request = false;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        // every frame the particles pass on the way, a paged mesh loads them here. going back or past the data
+        // reseeds at time, only that frame is needed then and not every frame from 0
+        const bool reseed = time < this->sim_time || time > this->sampler.t_max();
+        const FrameHandle frames = reseed ? this->mesh->field_store.pin(this->mesh, time)
+                                          : this->mesh->field_store.pin_range(this->mesh, this->sim_time, time);
+        this->advance_to(time);
+        this->fill_back();
+        this->swap_frames();
+        this->num_frames_done++;
+        if(this->num_frames_done % 100 == 1){
+            qDebug() << "Particle cloud: time" << time << "took" << timer.nsecsElapsed() / 1e6 << "ms";
+        }
+    }
+}
+
+
+// put every particle at a random point inside the mesh
+void ParticleCloud::seed_all(const double time)
+{
+    const UL seed = this->num_frames_done;
+    this->pool.parallel_for(0, this->num_particles(), [this, seed](const UL begin, const UL end){
+        mt19937_64 rng(seed * 0x9E3779B97F4A7C15ull + begin);
+        uniform_real_distribution<double> uniform(0., 1.);
+        double u[5];
+        for(UL i = begin; i < end; i++){
+            for(double& r : u) r = uniform(rng);
+            this->spawn_in_volume(i, u);
+        }
+    }, 4096);
+    this->sim_time = time;
+}
+
+
+// advect from sim_time to time in RK4 steps no longer than pathline_time_step
+// going back in time (the animation looped) or past the data starts over with fresh seeds
+void ParticleCloud::advance_to(const double time)
+{
+    if(time < this->sim_time || time > this->sampler.t_max()){
+        this->seed_all(time);
+        return;
+    }
+    const double duration = time - this->sim_time;
+    if(duration <= 0.) return;
+
+    const UI num_steps = (UI) ceil(duration / pathline_time_step);
+    const double dt = duration / num_steps;
+    const double start = this->sim_time;
+    this->pool.parallel_for(0, this->num_particles(), [this, start, dt, num_steps](const UL begin, const UL end){
+        this->sampler.rk4_batch(this->particles, begin, end, start, dt, num_steps);
+    }, 4096);
+    this->sim_time = time;
+
+    this->respawn_dead();
+}
+
+
+// inflow through each boundary face at time, velocity sampled just inside the face center
+void ParticleCloud::build_inflow_cdf(const double time)
+{
+    const UL n = this->faces.size();
+    vector<double> flux(n, 0.);
+    this->pool.parallel_for(0, n, [this, time, &flux](const UL begin, const UL end){
+        for(UL f = begin; f < end; f++){
+            const BoundaryFace& face = this->faces[f];
+            double c[3], vel[3];
+            const double nudge = 1e-3 * sqrt(face.area);
+            for(unsigned char j = 0; j < 3; j++){
+                c[j] = (face.pts[j] + face.pts[3 + j] + face.pts[6 + j]) / 3. + nudge * face.inward[j];
+            }
+            long tet = face.tet;
+            if(!this->sampler.velocity_at(c, time, tet, vel)) continue;
+            const double inflow = vel[0]*face.inward[0] + vel[1]*face.inward[1] + vel[2]*face.inward[2];
+            if(inflow > 0.) flux[f] = inflow * face.area;
+        }
+    }, 1024);
+
+    this->inflow_cdf.resize(n);
+    double sum = 0.;
+    for(UL f = 0; f < n; f++){
+        sum += flux[f];
+        this->inflow_cdf[f] = sum;
+    }
+}
+
+
+void ParticleCloud::respawn_dead()
+{
+    UL num_dead = 0;
+    for(const long tet : this->particles.tets) num_dead += tet < 0;
+    if(num_dead == 0) return;
+
+    this->build_inflow_cdf(this->sim_time);
+    const bool has_inflow = !this->inflow_cdf.empty() && this->inflow_cdf.back() > 0.;
+    const UL seed = this->num_frames_done;
+    this->pool.parallel_for(0, this->num_particles(), [this, seed, has_inflow](const UL begin, const UL end){
+        mt19937_64 rng(seed * 0x9E3779B97F4A7C15ull + begin);
+        uniform_real_distribution<double> uniform(0., 1.);
+        double u[5];
+        for(UL i = begin; i < end; i++){
+            if(this->particles.alive(i)) continue;
+            for(double& r : u) r = uniform(rng);
+            if(has_inflow && this->spawn_on_boundary(i, u)) continue;
+            this->spawn_in_volume(i, u);
+        }
+    }, 4096);
+}
+
+
+// u[0] picks the tet by volume, u[1..4] give uniform barycentric coordinates inside it
+void ParticleCloud::spawn_in_volume(const UL i, const double u[5])
+{
+    const double target = u[0] * this->tet_volume_cdf.back();
+    UL tet = lower_bound(this->tet_volume_cdf.begin(), this->tet_volume_cdf.end(), target) - this->tet_volume_cdf.begin();
+    if(tet >= this->tet_volume_cdf.size()) tet = this->tet_volume_cdf.size() - 1;
+
+    double bary[4], sum = 0.;
+    for(unsigned char k = 0; k < 4; k++){
+        bary[k] = -log(1. - u[1 + k]);
+        sum += bary[k];
+    }
+    double p[3] = {0., 0., 0.};
+    const UL* tv = this->sampler.tet_verts + 4*tet;
+    for(unsigned char k = 0; k < 4; k++){
+        const double w = sum > 0. ? bary[k] / sum : 0.25;
+        for(unsigned char j = 0; j < 3; j++) p[j] += w * this->sampler.cords[3*tv[k] + j];
+    }
+    this->particles.set(i, p, (long) tet);
+}
+
+
+// u[0] picks the face by inflow, u[1..2] a uniform point on it, nudged into the domain
+bool ParticleCloud::spawn_on_boundary(const UL i, const double u[3])
+{
+    const double target = u[0] * this->inflow_cdf.back();
+    UL f = lower_bound(this->inflow_cdf.begin(), this->inflow_cdf.end(), target) - this->inflow_cdf.begin();
+    if(f >= this->faces.size()) f = this->faces.size() - 1;
+    const BoundaryFace& face = this->faces[f];
+
+    const double r = sqrt(u[1]);
+    const double w[3] = {1. - r, r * (1. - u[2]), r * u[2]};
+    const double nudge = 1e-3 * sqrt(face.area);
+    double p[3];
+    for(unsigned char j = 0; j < 3; j++){
+        p[j] = w[0]*face.pts[j] + w[1]*face.pts[3 + j] + w[2]*face.pts[6 + j] + nudge * face.inward[j];
+    }
+    long tet = face.tet;
+    double bary[4];
+    if(!this->sampler.locate(p, tet, bary)) return false;
+    this->particles.set(i, p, tet);
+    return true;
+}
+
+
+// positions and speed colors of the current particles into the back frame
+void ParticleCloud::fill_back()
+{
+    const UL n = this->num_particles();
+    const double time = this->sim_time;
+    this->pool.parallel_for(0, n, [this, time](const UL begin, const UL end){
+        this->sampler.speed_batch(this->particles, begin, end, time, this->speeds.data() + begin);
+    }, 4096);
+
+    double min = DBL_MAX, max = -DBL_MAX;
+    for(UL i = 0; i < n; i++){
+        if(!this->particles.alive(i)) continue;
+        if(this->speeds[i] < min) min = this->speeds[i];
+        if(this->speeds[i] > max) max = this->speeds[i];
+    }
+    if(min > max) min = max = 0.;
+    const double dmag = max - min > zero_threshold ? max - min : 1.;
+
+    CloudFrame* frame = this->back;
+    this->pool.parallel_for(0, n, [this, frame, min, dmag](const UL begin, const UL end){
+        for(UL i = begin; i < end; i++){
+            frame->pts[3*i] = (float) this->particles.x[i];
+            frame->pts[3*i + 1] = (float) this->particles.y[i];
+            frame->pts[3*i + 2] = (float) this->particles.z[i];
+            double s = (this->speeds[i] - min) / dmag;
+            s = s < 0. ? 0. : (s > 1. ? 1. : s);
+            const unsigned char* c = this->color_lut + 3 * (UI) (s * 255. + 0.5);
+            frame->colors[3*i] = c[0];
+            frame->colors[3*i + 1] = c[1];
+            frame->colors[3*i + 2] = c[2];
+        }
+    }, 4096);
+    frame->time = time;
+    frame->min_speed = min;
+    frame->max_speed = max;
+}
+
+
+void ParticleCloud::swap_frames()
+{
+    lock_guard<mutex> lock(this->front_mutex);
+    CloudFrame* tmp = this->front;
+    this->front = this->back;
+    this->back = tmp;
+}
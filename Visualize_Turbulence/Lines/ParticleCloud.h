@@ -0,0 +1,102 @@
+#ifndef PARTICLECLOUD_H
+#define PARTICLECLOUD_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Lines/FlowSampler.h"
+#include "Others/ThreadPool.h"
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+
+// what the render thread draws: the position and speed color of every particle at one time
+class CloudFrame{
+public:
+    vector<float> pts;              // 3 floats per particle
+    vector<unsigned char> colors;   // rgb per particle, from the color table by speed
+    double time;
+    double min_speed, max_speed;
+
+    inline UL num_particles() const;
+};
+
+
+// a dense set of particles advected through the time-varying field, one advection per animation frame
+// the advection runs on a background thread with its own thread pool and fills the back frame,
+// the render thread draws the front frame, the two are swapped when a frame is done.
+// every particle carries the tet it was found in last, so locating it again only walks a few tets.
+// particles that leave the domain are respawned on the boundary triangles where the flow comes in,
+// in proportion to the inflow through each one. without inflow they are respawned inside the volume.
+class ParticleCloud{
+public:
+    ParticleCloud(Mesh* mesh, const UL num_particles);
+    ~ParticleCloud();
+
+    inline UL num_particles() const;
+    void request_time(const double time);
+    const CloudFrame* lock_front();
+    void unlock_front();
+
+private:
+    // a boundary triangle particles can be respawned on
+    struct BoundaryFace{
+        double pts[9];
+        double inward[3]; // unit normal pointing into the domain
+        double area;
+        long tet;
+    };
+
+    Mesh* mesh;
+    const FlowSampler sampler;
+    ThreadPool pool;
+
+    // simulation state, only touched by the driver thread
+    ParticleBatch particles;
+    vector<double> speeds;
+    double sim_time;
+    UL num_frames_done;
+    vector<double> tet_volume_cdf;
+    vector<BoundaryFace> faces;
+    vector<double> inflow_cdf;
+    unsigned char color_lut[3 * 256];
+
+    CloudFrame frames[2];
+    CloudFrame* front;
+    CloudFrame* back;
+    mutex front_mutex;
+
+    thread driver;
+    mutex request_mutex;
+    condition_variable request_cv;
+    double requested_time;
+    bool has_request;
+    bool stopping;
+
+    void run();
+    void seed_all(const double time);
+    void advance_to(const double time);
+    void build_inflow_cdf(const double time);
+    void respawn_dead();
+    void spawn_in_volume(const UL i, const double u[5]);
+    bool spawn_on_boundary(const UL i, const double u[3]);
+    void fill_back();
+    void swap_frames();
+};
+
+
+inline UL CloudFrame::num_particles() const
+{
+    return this->pts.size() / 3;
+}
+
+
+inline UL ParticleCloud::num_particles() const
+{
+    return this->particles.size();
+}
+
+#endif // PARTICLECLOUD_H
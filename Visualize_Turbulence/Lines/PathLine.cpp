@@ -1,42 +1,122 @@
 #include "Lines/PathLine.h"
+#include "Lines/FlowSampler.h"
 #include "Others/Predefined.h"
 #include "Others/Utilities.h"
+#include "Others/Parallel.h"
+#include <QElapsedTimer>
+
+// raw frames a tracing thread keeps pinned ahead of its pathlines, see trace_pathlines()
+static const double pinned_frames_ahead = 2.;
 
 PathLine::PathLine()
 {
-
+    this->seed_tet = 0;
 }
 
-PathLine::PathLine(vector<Vertex*> vs)
+
+PathLine::~PathLine()
 {
-    this->verts.reserve(vs.size());
+    this->pts.clear();
+    this->times.clear();
+    this->speeds.clear();
+}
 
-    for(auto& v : vs){
-        this->verts.push_back(v);
+
+void tracing_pathlines()
+{
+    for(unsigned int i = 0; i < meshes.size(); i++){
+        auto& mesh = meshes[i];
+        qDebug()<< "Tracing pathlines for mesh"<< i;
+        build_pathlines_from_seeds(mesh);
+        qDebug()<< "Tracing pathlines for mesh"<< i << "done";
     }
 }
 
-PathLine::~PathLine()
+
+// one pathline seeded at the center of each random tet at t = 0
+void place_seeds(Mesh* mesh, vector<PathLine*>& pls)
 {
-    for(UL i = 0; i < this->num_verts(); i++){
-        if(this->verts[i] != NULL) delete this->verts[i];
+    vector<UL> seeds = Utility::generate_unique_random_Tet_idx(mesh);
+    pls.reserve(seeds.size());
+    for(UL tet_idx : seeds){
+        PathLine* pl = new PathLine();
+        pl->pts.reserve(max_num_steps + 1);
+        pl->times.reserve(max_num_steps + 1);
+        pl->speeds.reserve(max_num_steps + 1);
+        pl->seed_tet = tet_idx;
+        pl->add_pt(mesh->tets[tet_idx]->center, 0., 0.);
+        pls.push_back(pl);
     }
-
-    this->verts.clear();
 }
 
 
-// now every pathline has a seed point, we want to calculate their path individually
+// place the seeds and trace every pathline forward in time, all seeds run in parallel
+// the pathlines replace the ones the mesh had
 void build_pathlines_from_seeds(Mesh* mesh){
-    // for each pathline, we calculate their trajectories
+    for(PathLine* pl : mesh->pathlines) delete pl;
+    mesh->pathlines.clear();
+    place_seeds(mesh, mesh->pathlines);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // the sampler gathers the flat frames on this thread, the tracing threads only read it
+    const FlowSampler sampler(mesh);
+    vector<PathLine*>& pls = mesh->pathlines;
+    Utility::parallel_for(0, pls.size(), [&](const UL begin, const UL end){
+        trace_pathlines(mesh, sampler, pls, begin, end);
+    }, 16);
 
+    UL num_pts = 0;
+    for(const PathLine* pl : pls) num_pts += pl->num_verts();
+    qDebug() << "Pathlines:" << pls.size() << "pathlines," << num_pts << "points in" << timer.nsecsElapsed() / 1e9 << "secs";
 }
 
 
-// tracing the start_cords one time step
-// vel is the velocity vector
-// return the resultant cords
-Vector3d trace_one_time_step(const Vector3d& start_cords, const Vector3d& vel)
+// trace pls[begin, end) from their seeds with RK4 in space-time until they leave the mesh,
+// reach the last frame or take max_num_steps steps
+// all pathlines share the time stamps, so they advance together through the batched kernel
+// one step at a time and the containing tets are carried from step to step
+// only the frames of the next few steps are pinned, the window moves on with t so a paged mesh
+// keeps to field_memory_budget however long the pathlines are
+void trace_pathlines(Mesh* mesh, const FlowSampler& sampler, vector<PathLine*>& pls, const UL begin, const UL end)
 {
-    return start_cords + vel*time_step_size;
+    const UL n = end - begin;
+    ParticleBatch batch;
+    batch.resize(n);
+    for(UL i = 0; i < n; i++){
+        const PathLine* pl = pls[begin + i];
+        if(pl->num_verts() == 0) continue;
+        const double p[3] = {pl->pts[0].x(), pl->pts[0].y(), pl->pts[0].z()};
+        batch.set(i, p, pl->seed_tet);
+    }
+
+    vector<double> speeds(n);
+    double t = pls[begin]->num_verts() > 0 ? pls[begin]->times[0] : 0.;
+    double pinned_until = t + pinned_frames_ahead;
+    FrameHandle frames = mesh->field_store.pin_range(mesh, t, pinned_until);
+    sampler.speed_batch(batch, 0, n, t, speeds.data());
+    for(UL i = 0; i < n; i++){
+        if(batch.alive(i)) pls[begin + i]->speeds[0] = speeds[i];
+    }
+
+    for(UI step = 0; step < max_num_steps; step++){
+        const double dt = t + pathline_time_step > sampler.t_max() ? sampler.t_max() - t : pathline_time_step;
+        if(dt <= 0.) break;
+        if(t + dt > pinned_until){
+            pinned_until = t + dt + pinned_frames_ahead;
+            frames = mesh->field_store.pin_range(mesh, t, pinned_until);
+        }
+        sampler.rk4_batch(batch, 0, n, t, dt);
+        t += dt;
+        sampler.speed_batch(batch, 0, n, t, speeds.data());
+
+        bool any_alive = false;
+        for(UL i = 0; i < n; i++){
+            if(!batch.alive(i)) continue;
+            pls[begin + i]->add_pt(Vector3d(batch.x[i], batch.y[i], batch.z[i]), t, speeds[i]);
+            any_alive = true;
+        }
+        if(!any_alive) break;
+    }
 }
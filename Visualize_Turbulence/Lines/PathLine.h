@@ -2,30 +2,46 @@
 #define PATHLINE_H
 
 #include <vector>
-#include "Geometry/Vertex.h"
+#include "Others/Vector3d.h"
+#include "Others/Predefined.h"
+
+using namespace std;
 
 class Mesh;
-// the pathline traced from a single seed
+class FlowSampler;
+
+// the pathline traced from a single seed through the time-varying field
+// points are kept in flat arrays, the first point is the seed
 class PathLine{
 public:
-    // first vertex saved in Vertex is the seed
-    // and the first vertex is the pathline at t=0
-    vector<Vertex*> verts;
+    vector<Vector3d> pts;   // positions along the pathline
+    vector<double> times;   // time stamp of each point, increasing
+    vector<double> speeds;  // velocity magnitude at each point, used for coloring
+    UL seed_tet;            // the tet that contains the seed
 
     PathLine();
-    PathLine(vector<Vertex*> vs);
     ~PathLine();
 
-    inline unsigned long num_verts();
+    inline UL num_verts() const;
+    inline void add_pt(const Vector3d& p, const double time, const double speed);
 };
 
-void place_seeds(vector<PathLine*>& pls);
+void tracing_pathlines();
+void place_seeds(Mesh* mesh, vector<PathLine*>& pls);
 void build_pathlines_from_seeds(Mesh* mesh);
-Vector3d trace_one_time_step(const Vector3d& start_cords, const Vector3d& vel);
+void trace_pathlines(Mesh* mesh, const FlowSampler& sampler, vector<PathLine*>& pls, const UL begin, const UL end);
+
+inline UL PathLine::num_verts() const
+{
+    return this->pts.size();
+}
+
 
-inline unsigned long PathLine::num_verts()
+inline void PathLine::add_pt(const Vector3d& p, const double time, const double speed)
 {
-    return this->verts.size();
+    this->pts.push_back(p);
+    this->times.push_back(time);
+    this->speeds.push_back(speed);
 }
 
 #endif // PATHLINE_H
@@ -0,0 +1,360 @@
+#include "Lines/Seeding.h"
+#include "Lines/FlowSampler.h"
+#include "Lines/StreamLine.h"
+#include "Others/Utilities.h"
+#include "Others/Parallel.h"
+#include "Others/AliasTable.h"
+#include "Analysis/FixedPtDetect.h"
+#include <random>
+#include <float.h>
+#include <QElapsedTimer>
+
+// a streamline traced on the flat sampler, turned into a StreamLine once all lines of a time are done
+struct TracedLine{
+    double seed[3];
+    long seed_tet;
+    vector<double> pts[2]; // forward and backward, 3 doubles per point
+    vector<long> tets[2];
+};
+
+
+// the cell centers are located in scanline order, each one starts walking from the last center found
+OccupancyGrid::OccupancyGrid(const FlowSampler& sampler, const double cell_size)
+{
+    Vector3d min(DBL_MAX), max(-DBL_MAX);
+    for(UL i = 0; i < sampler.cords.size(); i += 3){
+        for(unsigned char d = 0; d < 3; d++){
+            if(sampler.cords[i + d] < min.entry[d]) min.entry[d] = sampler.cords[i + d];
+            if(sampler.cords[i + d] > max.entry[d]) max.entry[d] = sampler.cords[i + d];
+        }
+    }
+    this->origin = min;
+    this->cell_size = cell_size;
+    for(unsigned char d = 0; d < 3; d++){
+        this->res[d] = (UI) ((max.entry[d] - min.entry[d]) / cell_size) + 1;
+    }
+    const UL n = (UL) this->res[0] * this->res[1] * this->res[2];
+    this->cells.resize(n);
+    this->cell_tets.assign(n, -1);
+
+    Utility::parallel_for(0, n, [&](const UL begin, const UL end){
+        long last = 0;
+        double p[3], bary[4];
+        for(UL c = begin; c < end; c++){
+            this->cell_center(c, p);
+            long tet = last;
+            if(sampler.locate(p, tet, bary)){
+                this->cell_tets[c] = tet;
+                last = tet;
+            }
+        }
+    });
+}
+
+
+OccupancyGrid::~OccupancyGrid()
+{
+    this->cells.clear();
+    this->pts.clear();
+    this->cell_tets.clear();
+}
+
+
+void OccupancyGrid::cell_center(const UL cell, double p[3]) const
+{
+    const UL idx[3] = {cell % this->res[0], (cell / this->res[0]) % this->res[1], cell / ((UL) this->res[0] * this->res[1])};
+    for(unsigned char d = 0; d < 3; d++){
+        p[d] = this->origin.entry[d] + (idx[d] + 0.5) * this->cell_size;
+    }
+}
+
+
+bool OccupancyGrid::is_near(const double p[3], const double dist) const
+{
+    long idx[3];
+    for(unsigned char d = 0; d < 3; d++){
+        idx[d] = (long) floor((p[d] - this->origin.entry[d]) / this->cell_size);
+    }
+    const double dist2 = dist * dist;
+    for(long k = idx[2] - 1; k <= idx[2] + 1; k++){
+        if(k < 0 || k >= (long) this->res[2]) continue;
+        for(long j = idx[1] - 1; j <= idx[1] + 1; j++){
+            if(j < 0 || j >= (long) this->res[1]) continue;
+            for(long i = idx[0] - 1; i <= idx[0] + 1; i++){
+                if(i < 0 || i >= (long) this->res[0]) continue;
+                const UL cell = ((UL) k * this->res[1] + j) * this->res[0] + i;
+                for(const UL n : this->cells[cell]){
+                    const double* q = this->pts.data() + 3*n;
+                    const double dx = p[0] - q[0], dy = p[1] - q[1], dz = p[2] - q[2];
+                    if(dx*dx + dy*dy + dz*dz < dist2) return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+
+void OccupancyGrid::insert(const double p[3])
+{
+    const UL n = this->num_pts();
+    this->pts.insert(this->pts.end(), p, p + 3);
+    this->cells[this->cell_of(p)].push_back(n);
+}
+
+
+// normalized Euler steps of ds from the seed, stopping at the mesh boundary, a stagnation point,
+// max_num_steps or as soon as the next point comes within d_test of a line already in the grid
+static UL trace_until_near(const FlowSampler& sampler, const OccupancyGrid& grid, const double time, const double d_test,
+                           const double ds, const double seed[3], long tet, vector<double>& pts, vector<long>& tets)
+{
+    double p[3] = {seed[0], seed[1], seed[2]};
+    double vel[3], bary[4];
+    UL num_steps = 0;
+    for(UI i = 0; i < max_num_steps; i++){
+        num_steps++;
+        if(!sampler.velocity_at(p, time, tet, vel)) break;
+        const double len = sqrt(vel[0]*vel[0] + vel[1]*vel[1] + vel[2]*vel[2]);
+        if(len < zero_threshold) break;
+        double q[3];
+        for(unsigned char j = 0; j < 3; j++) q[j] = p[j] + ds * vel[j] / len;
+        if(!sampler.locate(q, tet, bary)) break;
+        if(grid.is_near(q, d_test)) break;
+        pts.insert(pts.end(), q, q + 3);
+        tets.push_back(tet);
+        for(unsigned char j = 0; j < 3; j++) p[j] = q[j];
+    }
+    return num_steps;
+}
+
+
+// Jobard-Lefer in 3D for one time: the next seed is the center of the next empty cell (in scan order)
+// that lies in the mesh and is at least evenly_spaced_separation away from every line so far.
+// a line is only added to the grid once both halves are done, so it never stops on its own points.
+static UL trace_evenly_spaced(const FlowSampler& sampler, OccupancyGrid& grid, const double time, vector<TracedLine>& lines)
+{
+    const double d_sep = evenly_spaced_separation;
+    const double d_test = evenly_spaced_separation * evenly_spaced_test_ratio;
+    UL num_steps = 0;
+    UL cursor = 0;
+    while(lines.size() < max_evenly_spaced_seeds){
+        TracedLine line;
+        line.seed_tet = -1;
+        for(; cursor < grid.num_cells(); cursor++){
+            if(grid.cell_tets[cursor] < 0 || !grid.cells[cursor].empty()) continue;
+            grid.cell_center(cursor, line.seed);
+            if(grid.is_near(line.seed, d_sep)) continue;
+            line.seed_tet = grid.cell_tets[cursor];
+            break;
+        }
+        if(line.seed_tet < 0) break; // every cell in the mesh is covered
+        cursor++;
+
+        num_steps += trace_until_near(sampler, grid, time, d_test, dist_step_size, line.seed, line.seed_tet, line.pts[0], line.tets[0]);
+        num_steps += trace_until_near(sampler, grid, time, d_test, -dist_step_size, line.seed, line.seed_tet, line.pts[1], line.tets[1]);
+
+        grid.insert(line.seed);
+        for(unsigned char d = 0; d < 2; d++){
+            for(UL i = 0; i < line.pts[d].size(); i += 3) grid.insert(line.pts[d].data() + i);
+        }
+        lines.push_back(std::move(line));
+    }
+    return num_steps;
+}
+
+
+// turn the traced lines of time t into StreamLines
+static vector<StreamLine*> build_traced_lines(Mesh* mesh, const FlowSampler& sampler, const double t,
+                                              const vector<TracedLine>& lines)
+{
+    vector<StreamLine*> sls;
+    sls.reserve(lines.size());
+    for(const TracedLine& line : lines){
+        StreamLine* sl = new StreamLine();
+        sl->time = t;
+        double ws[4];
+        Tet* seed_tet = mesh->tets[line.seed_tet];
+        sl->set_seed(seed_tet->get_vert_at(Vector3d(line.seed[0], line.seed[1], line.seed[2]), t, &mesh->field_store, ws, true));
+        add_traced_verts(mesh, sampler, sl, line.pts[0], line.tets[0], true);
+        add_traced_verts(mesh, sampler, sl, line.pts[1], line.tets[1], false);
+        sls.push_back(sl);
+    }
+    return sls;
+}
+
+
+// replace the streamlines of every time with evenly spaced ones
+// the times are traced in parallel on the sampler, one time per thread, the streamline vertices are built on this
+// thread. the frames of the times traced together are pinned together, so a paged mesh keeps only those loaded
+void build_evenly_spaced_streamlines(Mesh* mesh)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const FlowSampler sampler(mesh);
+    const OccupancyGrid empty_grid(sampler, evenly_spaced_separation);
+
+    vector<double> times;
+    double time = 0.;
+    while(time < mesh->num_time_steps - 1.){
+        times.push_back(time);
+        time += time_step_size;
+    }
+
+    vector<vector<TracedLine>> lines(times.size());
+    vector<UL> num_steps(times.size(), 0);
+    UL total_lines = 0, total_steps = 0;
+    const UL group_size = Utility::num_threads();
+    for(UL first = 0; first < times.size(); first += group_size){
+        const UL last = min((UL) times.size(), first + group_size);
+        vector<FrameHandle> frames;
+        for(UL i = first; i < last; i++) frames.push_back(mesh->field_store.pin(mesh, times[i]));
+
+        Utility::parallel_for(first, last, [&](const UL begin, const UL end){
+            for(UL i = begin; i < end; i++){
+                OccupancyGrid grid = empty_grid;
+                num_steps[i] = trace_evenly_spaced(sampler, grid, times[i], lines[i]);
+            }
+        }, 1);
+
+        for(UL i = first; i < last; i++){
+            const double t = times[i];
+            if(mesh->streamlines_for_all_t.find(t) != mesh->streamlines_for_all_t.end()){
+                for(StreamLine* sl : mesh->streamlines_for_all_t.at(t)) delete sl;
+            }
+            const vector<StreamLine*> sls = build_traced_lines(mesh, sampler, t, lines[i]);
+            mesh->streamlines_for_all_t[t] = sls;
+            total_lines += sls.size();
+            total_steps += num_steps[i];
+            vector<TracedLine>().swap(lines[i]);
+        }
+    }
+
+    qDebug() << "Evenly spaced streamlines:" << total_lines << "lines," << total_steps << "integration steps over"
+             << times.size() << "times, grid" << empty_grid.res[0] << "x" << empty_grid.res[1] << "x" << empty_grid.res[2]
+             << "in" << timer.nsecsElapsed() / 1e9 << "secs";
+}
+
+
+// the evenly spaced streamlines of one time, empty_grid is the grid of the sampler without any line
+// the mesh is not changed
+vector<StreamLine*> evenly_spaced_streamlines_at(Mesh* mesh, const FlowSampler& sampler, const OccupancyGrid& empty_grid,
+                                                 const double time)
+{
+    OccupancyGrid grid = empty_grid;
+    vector<TracedLine> lines;
+    trace_evenly_spaced(sampler, grid, time, lines);
+    return build_traced_lines(mesh, sampler, time, lines);
+}
+
+
+// seeding weight of every tet at time, computed in parallel from the field store
+// falls back to the tet volumes if the field is zero everywhere (or there are no singularities)
+// ecg is the ECG of the time, only used by IMPORTANCE_SINGULARITIES and may be null
+void importance_weights(Mesh* mesh, const double time, const ImportanceField field, const ECG* ecg, vector<double>& weights)
+{
+    const UL num_tets = mesh->num_tets();
+    FieldStore& store = mesh->field_store;
+    vector<double> volumes(num_tets);
+    Utility::parallel_for(0, num_tets, [&](const UL begin, const UL end){
+        for(UL i = begin; i < end; i++) volumes[i] = mesh->tets[i]->volume();
+    });
+
+    weights.assign(num_tets, 0.);
+    if(field == IMPORTANCE_VOR_MAG){
+        const vector<double>& vor_mag = store.vert_vals(mesh, time, FIELD_VOR_MAG);
+        Utility::parallel_for(0, num_tets, [&](const UL begin, const UL end){
+            for(UL i = begin; i < end; i++){
+                const UL* tv = store.topology->tet_verts.data() + 4*i;
+                weights[i] = 0.25 * (vor_mag[tv[0]] + vor_mag[tv[1]] + vor_mag[tv[2]] + vor_mag[tv[3]]) * volumes[i];
+            }
+        });
+    }
+    else if(field == IMPORTANCE_Q){
+        const vector<double>& q = store.tet_vals(mesh, time, FIELD_Q);
+        Utility::parallel_for(0, num_tets, [&](const UL begin, const UL end){
+            for(UL i = begin; i < end; i++) weights[i] = q[i] > 0. ? q[i] * volumes[i] : 0.;
+        });
+    }
+    else if(field == IMPORTANCE_SINGULARITIES && ecg != nullptr){
+        // falls off with the squared distance, seed_importance_falloff away the weight is halved
+        const vector<Singularity*> sings = ecg->get_sings();
+        const double falloff2 = seed_importance_falloff * seed_importance_falloff;
+        if(!sings.empty()){
+            Utility::parallel_for(0, num_tets, [&](const UL begin, const UL end){
+                for(UL i = begin; i < end; i++){
+                    const Vector3d& c = mesh->tets[i]->center;
+                    double min_d2 = DBL_MAX;
+                    for(const Singularity* sing : sings){
+                        const Vector3d d = c - sing->cords;
+                        const double d2 = dot(d, d);
+                        if(d2 < min_d2) min_d2 = d2;
+                    }
+                    weights[i] = volumes[i] / (1. + min_d2 / falloff2);
+                }
+            }, 256);
+        }
+    }
+
+    double sum = 0.;
+    for(const double w : weights) sum += w;
+    if(sum <= 0.) weights.swap(volumes);
+}
+
+
+// NUM_SEEDS streamline seeds for every time, each at a uniform random point of a tet drawn by importance
+void place_importance_seeds(Mesh* mesh)
+{
+    mesh->streamlines_for_all_t.reserve(mesh->num_time_steps * frames_per_sec);
+    double time = 0.;
+    while(time < mesh->num_time_steps - 1.){
+        if(mesh->streamlines_for_all_t.find(time) != mesh->streamlines_for_all_t.end()){
+            for(StreamLine* sl : mesh->streamlines_for_all_t.at(time)) delete sl;
+        }
+        auto it = mesh->ECG_for_all_t.find(time);
+        const FrameHandle frame = mesh->field_store.pin(mesh, time);
+        mesh->streamlines_for_all_t[time] = place_importance_seeds_at(mesh, time, it != mesh->ECG_for_all_t.end() ? it->second : nullptr);
+
+        time += time_step_size;
+    }
+}
+
+
+// the seeds of one time, the alias table is built once, after that every seed costs O(1)
+// every time has its own random sequence, so a time gets the same seeds whatever order the times are seeded in
+vector<StreamLine*> place_importance_seeds_at(Mesh* mesh, const double time, const ECG* ecg)
+{
+    mt19937_64 rng(rng_seed + (unsigned long) llround(time / time_step_size));
+    uniform_real_distribution<double> uniform(0., 1.);
+
+    vector<double> weights;
+    importance_weights(mesh, time, seed_importance, ecg, weights);
+    AliasTable table;
+    table.build(weights);
+
+    vector<StreamLine*> sls;
+    sls.reserve(NUM_SEEDS);
+    for(UI n = 0; n < NUM_SEEDS; n++){
+        const double u1 = uniform(rng), u2 = uniform(rng);
+        Tet* tet = mesh->tets[table.sample(u1, u2)];
+
+        // uniform barycentric coordinates
+        double ws[4], sum = 0.;
+        for(unsigned char k = 0; k < 4; k++){
+            ws[k] = -log(1. - uniform(rng));
+            sum += ws[k];
+        }
+        Vector3d p;
+        for(unsigned char k = 0; k < 4; k++){
+            ws[k] = sum > 0. ? ws[k] / sum : 0.25;
+            p = p + tet->verts[k]->cords * ws[k];
+        }
+
+        StreamLine* sl = new StreamLine();
+        sl->fw_verts.reserve(max_num_steps);
+        sl->bw_verts.reserve(max_num_steps);
+        sl->time = time;
+        sl->set_seed(tet->get_vert_at(p, time, &mesh->field_store, ws, false));
+        sls.push_back(sl);
+    }
+    return sls;
+}
@@ -0,0 +1,86 @@
+#ifndef SEEDING_H
+#define SEEDING_H
+
+#include <vector>
+#include "Others/Vector3d.h"
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+class FlowSampler;
+class StreamLine;
+class ECG;
+
+// how the streamline seeds of each time step are placed
+enum SeedingStrategy : unsigned char{
+    SEED_RANDOM = 0,        // NUM_SEEDS random tet centers, the same tets for every time
+    SEED_EVENLY_SPACED,     // Jobard-Lefer, seeds from the empty cells of an occupancy grid
+    SEED_IMPORTANCE         // NUM_SEEDS tets drawn per time in proportion to seed_importance
+};
+
+// what makes a tet worth seeding in SEED_IMPORTANCE, always times the tet volume
+enum ImportanceField : unsigned char{
+    IMPORTANCE_VOR_MAG = 0,     // vorticity magnitude
+    IMPORTANCE_Q,               // positive part of the Q criterion
+    IMPORTANCE_SINGULARITIES    // closeness to the nearest fixed point of the ECG
+};
+
+
+// uniform grid of cubic cells over the bounding box of the mesh, each cell lists the streamline points inside it
+// a point is near the existing lines if any point in the 27 cells around it is closer than the given distance,
+// so the cell size has to be at least that distance
+class OccupancyGrid{
+public:
+    Vector3d origin;
+    double cell_size;
+    UI res[3];
+    vector<vector<UL>> cells;  // point indices per cell, x runs fastest
+    vector<double> pts;        // 3 doubles per point
+    vector<long> cell_tets;    // tet containing each cell center, -1 if the center is outside the mesh
+
+    OccupancyGrid(const FlowSampler& sampler, const double cell_size);
+    ~OccupancyGrid();
+
+    inline UL num_cells() const;
+    inline UL num_pts() const;
+    inline UL cell_of(const double p[3]) const;
+    void cell_center(const UL cell, double p[3]) const;
+    bool is_near(const double p[3], const double dist) const;
+    void insert(const double p[3]);
+};
+
+
+void build_evenly_spaced_streamlines(Mesh* mesh);
+vector<StreamLine*> evenly_spaced_streamlines_at(Mesh* mesh, const FlowSampler& sampler, const OccupancyGrid& empty_grid,
+                                                 const double time);
+void importance_weights(Mesh* mesh, const double time, const ImportanceField field, const ECG* ecg, vector<double>& weights);
+void place_importance_seeds(Mesh* mesh);
+vector<StreamLine*> place_importance_seeds_at(Mesh* mesh, const double time, const ECG* ecg);
+
+
+inline UL OccupancyGrid::num_cells() const
+{
+    return this->cells.size();
+}
+
+
+inline UL OccupancyGrid::num_pts() const
+{
+    return this->pts.size() / 3;
+}
+
+
+// cell containing p, points outside the box go to the nearest cell
+inline UL OccupancyGrid::cell_of(const double p[3]) const
+{
+    UL idx[3];
+    for(unsigned char d = 0; d < 3; d++){
+        const double x = (p[d] - this->origin.entry[d]) / this->cell_size;
+        idx[d] = x <= 0. ? 0 : (UL) x;
+        if(idx[d] >= this->res[d]) idx[d] = this->res[d] - 1;
+    }
+    return (idx[2] * this->res[1] + idx[1]) * this->res[0] + idx[0];
+}
+
+#endif // SEEDING_H
@@ -1,16 +1,25 @@
 #include "Lines/StreamLine.h"
+#include "Lines/FlowSampler.h"
+#include "Lines/Seeding.h"
+#include "Lines/StreamLineLOD.h"
+#include "Lines/Termination.h"
 #include "Others/Utilities.h"
+#include "Others/Parallel.h"
+#include "FileLoader/ProductCache.h"
+#include <QElapsedTimer>
 
 StreamLine::StreamLine()
 {
     this->time = 0.;
     this->seed = NULL;
+    this->lod = NULL;
 }
 
 // set the seed
 StreamLine::StreamLine(Vertex *seed)
 {
     this->time = 0.;
+    this->lod = NULL;
     this->set_seed(seed);
 }
 
@@ -18,6 +27,7 @@ StreamLine::StreamLine(Vertex *seed)
 StreamLine::StreamLine(Vertex *seed, double time)
 {
     this->time = time;
+    this->lod = NULL;
     this->set_seed(seed);
 }
 
@@ -26,6 +36,7 @@ StreamLine::~StreamLine()
 {
     UL i;
 
+    this->clear_lod();
     if(seed != NULL) {
         delete seed;
         seed = NULL;
@@ -49,6 +60,7 @@ void StreamLine::clear_fw_verts()
         if(this->fw_verts[w] != NULL) delete this->fw_verts[w];
     }
     this->fw_verts.clear();
+    this->clear_lod();
 }
 
 // clear all vertices in bw verts
@@ -58,6 +70,22 @@ void StreamLine::clear_bw_verts()
         if(this->bw_verts[w] != NULL) delete this->bw_verts[w];
     }
     this->bw_verts.clear();
+    this->clear_lod();
+}
+
+
+// levels of detail for drawing, built from the vertices the line has now
+const StreamLineLOD* StreamLine::get_lod()
+{
+    if(this->lod == NULL) this->lod = new StreamLineLOD(this);
+    return this->lod;
+}
+
+
+void StreamLine::clear_lod()
+{
+    if(this->lod != NULL) delete this->lod;
+    this->lod = NULL;
 }
 
 
@@ -68,12 +96,24 @@ void tracing_streamlines()
         qDebug()<< "Tracing streamlines for mesh"<< i;
         mesh->interpolate_vertices_for_all_t();
 
+        if(tracing_streamlines_from_seed && load_cached_streamlines(mesh)) continue;
+
         // trace seeds and form pathlines
         // mainwindow.cpp will clear the memory of pathlines and streamlines
         if(tracing_streamlines_from_seed){
-            // place inital seeds
-            place_seeds(mesh);
-            build_streamlines_from_seeds(mesh);
+            if(streamline_seeding == SEED_EVENLY_SPACED){
+                build_evenly_spaced_streamlines(mesh);
+            }
+            else if(streamline_seeding == SEED_IMPORTANCE){
+                place_importance_seeds(mesh);
+                build_streamlines_from_seeds(mesh);
+            }
+            else{
+                // place inital seeds
+                place_seeds(mesh);
+                build_streamlines_from_seeds(mesh);
+            }
+            save_cached_streamlines(mesh);
         }
 
         qDebug()<< "Tracing streamlines for mesh"<< i << "done";
@@ -82,62 +122,125 @@ void tracing_streamlines()
 
 
 // now every streamline at any time has a seed point as a starting point, we want to calculate their trajectory individually
+// the forward and backward halves of all streamlines of a time are traced together by the batched kernel in parallel,
+// the interpolated vertices are then built on this thread from the recorded points
+// a half stops when it leaves the mesh, stagnates, runs in a cycle or gets too long, see Lines/Termination.h
 void build_streamlines_from_seeds( Mesh* mesh )
 {
+    QElapsedTimer timer;
+    timer.start();
+    const FlowSampler sampler(mesh);
+    TerminationStats stats;
+    UL num_pts = 0;
+
     // for each time step
     double cur_time = 0;
     while( cur_time < mesh->num_time_steps - 1. ){
         qDebug() << "Tracing streamline for time " << cur_time;
-        vector<StreamLine*> sls = mesh->streamlines_for_all_t.at(cur_time);
-        // for each (the beginning of) trajectory
-        for( StreamLine* sl : sls ){
-            // forward tracing
-            {
-                Vertex* vert = sl->seed;
-                Tet* tet = vert->tets[0];
-                for(UI i = 0; i < max_num_steps; i++){
-                    Vector3d cords = vert->cords;
-                    Vector3d newCords = trace_one_dist_step(cords, vert->vels.at(cur_time)); // trace 1 time step
-                    double ds[4]; // saving barycentric coordinates
-                    Tet* newTet = mesh->inWhichTet(newCords, tet, ds); // find the corresponding tet
-                    if(newTet == NULL) {
-                        break; // newTet is null means we are not able to find the tet
-                    }
-                    // interpolate at newCords at time t
-                    Vertex* newVert = newTet->get_vert_at(newCords, cur_time, ds); // interpolate new cords in the tet
-                    if(newVert == NULL) Utility::throwErrorMessage("build_pathlines_from_seeds: newVert is NULL!");
-                    newVert->add_tet(newTet);
-                    sl->fw_verts.push_back(newVert); // new vert into the streamline
-                    vert = newVert;
-                }
+        const FrameHandle frame = mesh->field_store.pin(mesh, cur_time);
+        num_pts += trace_streamlines_at(mesh, sampler, cur_time, mesh->streamlines_for_all_t.at(cur_time), stats);
+        cur_time += time_step_size;
+    }
+    qDebug() << "Streamlines:" << num_pts << "points in" << timer.nsecsElapsed() / 1e9 << "secs";
+    stats.log("Streamline termination");
+}
+
+
+// trace the seeded streamlines of one time, returns the number of points added
+// only the streamlines are changed, so this can run off the GUI thread on lines that aren't in the mesh yet
+UL trace_streamlines_at(Mesh* mesh, const FlowSampler& sampler, const double cur_time, const vector<StreamLine*>& sls,
+                        TerminationStats& stats)
+{
+    const UL num_sls = sls.size();
+    const double min_speed = stagnation_speed(mesh, cur_time);
+
+    // points and tets of every step, entry 2i is the forward half of streamline i, 2i+1 the backward half
+    vector<vector<double>> pts(2 * num_sls);
+    vector<vector<long>> tets(2 * num_sls);
+    Utility::parallel_for(0, num_sls, [&](const UL begin, const UL end){
+        const UL m = end - begin;
+        ParticleBatch dir[2];
+        for(unsigned char d = 0; d < 2; d++){
+            dir[d].resize(m);
+            for(UL i = begin; i < end; i++){
+                const Vertex* seed = sls[i]->seed;
+                const double p[3] = {seed->x(), seed->y(), seed->z()};
+                dir[d].set(i - begin, p, seed->tets[0]->idx);
             }
+        }
+        vector<StreamlineTermination> terms(2 * m, StreamlineTermination(min_speed));
+        vector<bool> done(2 * m, false);
+        vector<double> speeds(m);
+        TerminationStats local;
 
-            // backward tracing
-            {
-                Vertex* vert = sl->seed;
-                Tet* tet = vert->tets[0];
-                for(UI i = 0; i < max_num_steps; i++){
-                    Vector3d vel = Vector3d( vert->vels.at(cur_time) ) * (- 1.); // -1 means backward
-                    Vector3d cords = vert->cords;
-                    Vector3d newCords = trace_one_dist_step(cords, vel); // trace 1 time step
-                    double ws[4]; // saving barycentric coordinates
-                    Tet* newTet = mesh->inWhichTet(newCords, tet, ws); // find the corresponding tet
-                    if(newTet == NULL) {
-                        break; // newTet is null means we couldn't proceed
+        for(UI step = 0; step < max_num_steps; step++){
+            bool any_alive = false;
+            for(unsigned char d = 0; d < 2; d++){
+                // -1 means backward
+                sampler.euler_batch(dir[d], 0, m, cur_time, d == 0 ? dist_step_size : -dist_step_size, speeds.data());
+                for(UL i = begin; i < end; i++){
+                    const UL k = i - begin, n = 2*i + d;
+                    if(done[2*k + d]) continue;
+
+                    // the step from a stagnant point and a step closing a cycle are dropped
+                    TerminationReason reason = TERM_NONE;
+                    if(terms[2*k + d].is_stagnant(speeds[k])) reason = TERM_STAGNATION;
+                    else if(!dir[d].alive(k)) reason = TERM_LEFT_DOMAIN;
+                    else reason = terms[2*k + d].after_step(dir[d].tets[k], dist_step_size);
+
+                    if(reason == TERM_NONE || reason == TERM_ARC_LENGTH){
+                        pts[n].push_back(dir[d].x[k]);
+                        pts[n].push_back(dir[d].y[k]);
+                        pts[n].push_back(dir[d].z[k]);
+                        tets[n].push_back(dir[d].tets[k]);
+                    }
+                    if(reason == TERM_NONE){
+                        any_alive = true;
+                        continue;
                     }
-                    // interpolate at newCords at time t
-                    Vertex* newVert = newTet->get_vert_at(newCords, cur_time, ws); // interpolate new cords in the tet
-                    if(newVert == NULL) Utility::throwErrorMessage("build_pathlines_from_seeds: newVert is NULL!");
-                    newVert->add_tet(newTet);
-                    sl->bw_verts.push_back(newVert); // new vert into the streamline
-                    vert = newVert;
+                    done[2*k + d] = true;
+                    dir[d].tets[k] = -1;
+                    local.add(reason, step + 1);
                 }
             }
+            if(!any_alive) break;
         }
-        cur_time += time_step_size;
+        for(UL k = 0; k < 2 * m; k++){
+            if(!done[k]) local.add(TERM_MAX_STEPS, max_num_steps);
+        }
+        stats.merge(local);
+    }, 4);
+
+    // interpolate at the new cords at time t
+    UL num_pts = 0;
+    for(UL i = 0; i < num_sls; i++){
+        add_traced_verts(mesh, sampler, sls[i], pts[2*i], tets[2*i], true);
+        add_traced_verts(mesh, sampler, sls[i], pts[2*i + 1], tets[2*i + 1], false);
+        num_pts += tets[2*i].size() + tets[2*i + 1].size();
+    }
+    return num_pts;
+}
+
+
+// interpolate a vertex at each traced point at the time of sl and append it to the forward or backward half
+// pts holds 3 doubles per point, tets the tet each point was located in
+void add_traced_verts(Mesh* mesh, const FlowSampler& sampler, StreamLine* sl, const vector<double>& pts,
+                      const vector<long>& tets, const bool forward)
+{
+    for(UL j = 0; j < tets.size(); j++){
+        const double* p = pts.data() + 3*j;
+        double ws[4]; // saving barycentric coordinates
+        sampler.bary_of(tets[j], p, ws);
+        Tet* newTet = mesh->tets[tets[j]];
+        Vertex* newVert = newTet->get_vert_at(Vector3d(p[0], p[1], p[2]), sl->time, &mesh->field_store, ws, false, false); // interpolate new cords in the tet
+        if(newVert == NULL) Utility::throwErrorMessage("add_traced_verts: newVert is NULL!");
+        newVert->add_tet(newTet);
+        if(forward) sl->add_fw_vert(newVert); // new vert into the streamline
+        else sl->add_bw_vert(newVert);
     }
 }
 
+
 inline Vector3d trace_one_dist_step(const Vector3d& start_cords, const Vector3d& vel)
 {
     Vector3d v = Vector3d(vel);
@@ -156,28 +259,35 @@ inline void place_seeds(Mesh* mesh)
     double time = 0.;
     while(time < mesh->num_time_steps - 1.)
     {
-        vector<StreamLine*> sls; // create a vector of streamlines to store seeds
-        sls.reserve(NUM_SEEDS); // we have num_seeds streamlines for each time step
-
-        unsigned int cur_num_seeds = 0;
-        while(cur_num_seeds < NUM_SEEDS)
-        {
-            // set up the streamline
-            StreamLine* SL = new StreamLine();
-            SL->fw_verts.reserve(max_num_steps);
-            SL->bw_verts.reserve(max_num_steps);
-            SL->time = (double) time;
-
-            UL tet_idx = seeds[cur_num_seeds];
-            Tet* rdm_tet = mesh->tets[tet_idx];
-            double ws[4];
-            Vertex* center_vert = rdm_tet->get_vert_at(rdm_tet->center, (double)time, ws, true);
-            SL->set_seed( center_vert );
-            cur_num_seeds ++;
-            sls.push_back(SL);
-        }
-        mesh->streamlines_for_all_t[time] = sls;
-
+        const FrameHandle frame = mesh->field_store.pin(mesh, time);
+        mesh->streamlines_for_all_t[time] = place_seeds_at(mesh, seeds, time);
         time += time_step_size; // increment time
     }
 }
+
+
+// one streamline seeded at the center of each of the given tets
+vector<StreamLine*> place_seeds_at(Mesh* mesh, const vector<UL>& seeds, const double time)
+{
+    vector<StreamLine*> sls; // create a vector of streamlines to store seeds
+    sls.reserve(NUM_SEEDS); // we have num_seeds streamlines for each time step
+
+    unsigned int cur_num_seeds = 0;
+    while(cur_num_seeds < NUM_SEEDS)
+    {
+        // set up the streamline
+        StreamLine* SL = new StreamLine();
+        SL->fw_verts.reserve(max_num_steps);
+        SL->bw_verts.reserve(max_num_steps);
+        SL->time = (double) time;
+
+        UL tet_idx = seeds[cur_num_seeds];
+        Tet* rdm_tet = mesh->tets[tet_idx];
+        double ws[4];
+        Vertex* center_vert = rdm_tet->get_vert_at(rdm_tet->center, (double)time, &mesh->field_store, ws, true);
+        SL->set_seed( center_vert );
+        cur_num_seeds ++;
+        sls.push_back(SL);
+    }
+    return sls;
+}
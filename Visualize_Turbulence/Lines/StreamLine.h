@@ -8,6 +8,9 @@
 using namespace std;
 
 class Mesh;
+class FlowSampler;
+class StreamLineLOD;
+class TerminationStats;
 
 class StreamLine
 {
@@ -16,6 +19,7 @@ public:
     Vertex* seed;
     vector<Vertex*> fw_verts; // first vertex is connected to the seed
     vector<Vertex*> bw_verts; // first vertex is connected to the seed
+    StreamLineLOD* lod; // built on the first draw after tracing, NULL until then
 
     StreamLine();
     StreamLine(Vertex* seed);
@@ -32,12 +36,20 @@ public:
 
     void clear_fw_verts();
     void clear_bw_verts();
+
+    const StreamLineLOD* get_lod();
+    void clear_lod();
 };
 
 void tracing_streamlines();
 void build_streamlines_from_seeds(Mesh* mesh);
+UL trace_streamlines_at(Mesh* mesh, const FlowSampler& sampler, const double time, const vector<StreamLine*>& sls,
+                        TerminationStats& stats);
+void add_traced_verts(Mesh* mesh, const FlowSampler& sampler, StreamLine* sl, const vector<double>& pts,
+                      const vector<long>& tets, const bool forward);
 Vector3d trace_one_dist_step(const Vector3d& start_cords, const Vector3d& vel);
 void place_seeds(Mesh* mesh);
+vector<StreamLine*> place_seeds_at(Mesh* mesh, const vector<UL>& seeds, const double time);
 void place_sings_as_seeds(Mesh* mesh);
 
 inline void StreamLine::set_seed(Vertex *seed_vert)
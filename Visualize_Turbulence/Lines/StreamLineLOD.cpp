@@ -0,0 +1,118 @@
+#include "Lines/StreamLineLOD.h"
+#include "Lines/StreamLine.h"
+#include "Others/Utilities.h"
+#include <cfloat>
+
+// flatten the streamline, run Douglas-Peucker once and keep the index list of every level
+StreamLineLOD::StreamLineLOD(const StreamLine* sl)
+{
+    const UL n = sl->num_verts();
+    this->pts.reserve(3 * n);
+    this->speeds.reserve(n);
+
+    vector<const Vertex*> verts;
+    verts.reserve(n);
+    for(long i = sl->num_bw_verts() - 1; i >= 0; i--) verts.push_back(sl->bw_verts[i]);
+    this->seed_idx = verts.size();
+    verts.push_back(sl->seed);
+    for(const Vertex* vert : sl->fw_verts) verts.push_back(vert);
+
+    double lo[3] = {DBL_MAX, DBL_MAX, DBL_MAX}, hi[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    for(const Vertex* vert : verts){
+        for(unsigned char d = 0; d < 3; d++){
+            const double x = vert->cords.entry[d];
+            this->pts.push_back(x);
+            if(x < lo[d]) lo[d] = x;
+            if(x > hi[d]) hi[d] = x;
+        }
+        this->speeds.push_back(length(vert->vels.begin()->second));
+    }
+    this->extent = sqrt((hi[0]-lo[0])*(hi[0]-lo[0]) + (hi[1]-lo[1])*(hi[1]-lo[1]) + (hi[2]-lo[2])*(hi[2]-lo[2]));
+
+    vector<double> errs;
+    this->simplify(errs);
+
+    this->levels.resize(num_lod_levels);
+    for(UI k = 0; k < num_lod_levels; k++){
+        const double tol = level_tolerance(k);
+        for(UI i = 0; i < n; i++){
+            if(errs[i] >= tol) this->levels[k].push_back(i);
+        }
+    }
+}
+
+
+// level 0 is the full line, every level after it doubles the tolerance
+double StreamLineLOD::level_tolerance(const UI level)
+{
+    if(level == 0) return 0.;
+    return lod_base_tolerance * (double) (1u << (level - 1));
+}
+
+
+// the coarsest level whose tolerance is within lod_pixel_error on screen
+// a line shorter than that is drawn with its coarsest level, which is at least the two end points
+UI StreamLineLOD::pick_level(const double pixels_per_unit) const
+{
+    const UI coarsest = this->levels.size() - 1;
+    if(this->extent * pixels_per_unit < lod_pixel_error) return coarsest;
+    UI level = 0;
+    while(level < coarsest && level_tolerance(level + 1) * pixels_per_unit <= lod_pixel_error) level++;
+    return level;
+}
+
+
+// deviation at which each point is dropped, the end points and the seed are always kept
+void StreamLineLOD::simplify(vector<double>& errs) const
+{
+    const UI n = this->num_pts();
+    errs.assign(n, 0.);
+    if(n == 0) return;
+    errs[0] = errs[n - 1] = errs[this->seed_idx] = DBL_MAX;
+
+    struct Segment{ UI a, b; double parent_err; };
+    vector<Segment> stack;
+    // the seed splits the line first so both halves are simplified on their own
+    if(this->seed_idx > 0) stack.push_back({0, this->seed_idx, DBL_MAX});
+    if(this->seed_idx < n - 1) stack.push_back({this->seed_idx, n - 1, DBL_MAX});
+
+    const float* p = this->pts.data();
+    while(!stack.empty()){
+        const Segment seg = stack.back();
+        stack.pop_back();
+        if(seg.b - seg.a < 2) continue;
+
+        // point farthest from the chord a-b splits the segment
+        double ab[3], len2 = 0.;
+        for(unsigned char d = 0; d < 3; d++){
+            ab[d] = p[3*seg.b + d] - p[3*seg.a + d];
+            len2 += ab[d] * ab[d];
+        }
+        UI split = seg.a + 1;
+        double split_d2 = -1.;
+        for(UI i = seg.a + 1; i < seg.b; i++){
+            double ap[3], t = 0.;
+            for(unsigned char d = 0; d < 3; d++){
+                ap[d] = p[3*i + d] - p[3*seg.a + d];
+                t += ap[d] * ab[d];
+            }
+            t = len2 > 0. ? t / len2 : 0.;
+            if(t < 0.) t = 0.;
+            else if(t > 1.) t = 1.;
+            double d2 = 0.;
+            for(unsigned char d = 0; d < 3; d++){
+                const double e = ap[d] - t * ab[d];
+                d2 += e * e;
+            }
+            if(d2 > split_d2){
+                split_d2 = d2;
+                split = i;
+            }
+        }
+
+        const double err = min(sqrt(split_d2), seg.parent_err);
+        errs[split] = err;
+        stack.push_back({seg.a, split, err});
+        stack.push_back({split, seg.b, err});
+    }
+}
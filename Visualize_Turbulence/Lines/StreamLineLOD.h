@@ -0,0 +1,39 @@
+#ifndef STREAMLINELOD_H
+#define STREAMLINELOD_H
+
+#include <vector>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class StreamLine;
+
+// multi-resolution polyline of a streamline for drawing
+// Douglas-Peucker gives every point the deviation at which it would be dropped, clamped so that a point never
+// outlives the point that split its segment. level k keeps the points whose deviation is at least
+// level_tolerance(k), so the levels are nested and level 0 holds every point
+class StreamLineLOD{
+public:
+    vector<float> pts;          // 3 floats per point, backward half reversed, seed, forward half
+    vector<float> speeds;       // velocity magnitude per point
+    vector<vector<UI>> levels;  // point indices of each level in line order
+    UI seed_idx;                // index of the seed in pts
+    double extent;              // diagonal of the bounding box
+
+    StreamLineLOD(const StreamLine* sl);
+
+    inline UL num_pts() const;
+    static double level_tolerance(const UI level);
+    UI pick_level(const double pixels_per_unit) const;
+
+private:
+    void simplify(vector<double>& errs) const;
+};
+
+
+inline UL StreamLineLOD::num_pts() const
+{
+    return this->speeds.size();
+}
+
+#endif // STREAMLINELOD_H
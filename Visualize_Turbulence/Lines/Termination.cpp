@@ -0,0 +1,125 @@
+#include "Lines/Termination.h"
+#include "Others/Utilities.h"
+
+RecentTets::RecentTets()
+{
+    for(UI i = 0; i < num_slots; i++){
+        this->tets[i] = -1;
+        this->stamps[i] = 0;
+    }
+    this->num_entered = 0;
+}
+
+
+// record that the line entered tet, return true if it was already entered within the window
+bool RecentTets::visit(const long tet)
+{
+    this->num_entered++;
+    const UL oldest = this->num_entered > cycle_window ? this->num_entered - cycle_window : 0;
+    const UI home = (UI) (((unsigned long long) tet * 0x9E3779B97F4A7C15ull) >> 59); // top 5 bits, 32 slots
+
+    UI free_slot = num_slots;
+    for(UI probe = 0; probe < max_probes; probe++){
+        const UI s = (home + probe) % num_slots;
+        const bool stale = this->tets[s] < 0 || this->stamps[s] < oldest;
+        if(this->tets[s] == tet && !stale) return true;
+        if(stale && free_slot == num_slots) free_slot = s;
+    }
+    // no free slot among the probes: evict the home slot, the table only has to catch short cycles
+    const UI s = free_slot == num_slots ? home : free_slot;
+    this->tets[s] = tet;
+    this->stamps[s] = this->num_entered;
+    return false;
+}
+
+
+StreamlineTermination::StreamlineTermination(const double min_speed)
+{
+    this->min_speed = min_speed;
+    this->arc_length = 0.;
+    this->last_tet = -1;
+}
+
+
+// tet contains the point the step just reached
+// a cycle is a line coming back into a recently left tet, which is what the normalized step does
+// when it oscillates around a sink or circles a closed orbit
+TerminationReason StreamlineTermination::after_step(const long tet, const double step_length)
+{
+    this->arc_length += step_length;
+    if(tet != this->last_tet){
+        if(this->last_tet >= 0 && this->recent.visit(tet)) return TERM_CYCLE;
+        if(this->last_tet < 0) this->recent.visit(tet);
+        this->last_tet = tet;
+    }
+    if(this->arc_length > max_streamline_arc_length) return TERM_ARC_LENGTH;
+    return TERM_NONE;
+}
+
+
+TerminationStats::TerminationStats()
+{
+    for(UI i = 0; i < NUM_TERMINATION_REASONS; i++) this->counts[i] = 0;
+    this->num_steps = 0;
+}
+
+
+void TerminationStats::add(const TerminationReason reason, const UL steps)
+{
+    lock_guard<mutex> lock(this->stats_mutex);
+    this->counts[reason]++;
+    this->num_steps += steps;
+}
+
+
+void TerminationStats::merge(const TerminationStats& other)
+{
+    lock_guard<mutex> lock(this->stats_mutex);
+    for(UI i = 0; i < NUM_TERMINATION_REASONS; i++) this->counts[i] += other.counts[i];
+    this->num_steps += other.num_steps;
+}
+
+
+// the steps saved are counted against every half running max_num_steps
+void TerminationStats::log(const char* what) const
+{
+    UL num_halves = 0;
+    for(UI i = 1; i < NUM_TERMINATION_REASONS; i++) num_halves += this->counts[i];
+    const double budget = (double) num_halves * max_num_steps;
+    qDebug() << what << ":" << num_halves << "halves," << this->num_steps << "steps,"
+             << (budget > 0. ? 100. * (1. - this->num_steps / budget) : 0.) << "% of the step budget saved";
+    for(UI i = 1; i < NUM_TERMINATION_REASONS; i++){
+        if(this->counts[i] == 0) continue;
+        qDebug() << "   " << termination_reason_name((TerminationReason) i) << ":" << this->counts[i];
+    }
+}
+
+
+// lines slower than stagnation_speed_ratio of the fastest vertex of the frame are stopped
+// safe from any thread, the AnalysisQueue worker calls it: the speeds are computed and cached in the frame under
+// the store lock by vert_vals(), and the pin keeps them from being released while they are scanned
+double stagnation_speed(Mesh* mesh, const double time)
+{
+    const FrameHandle frame = mesh->field_store.pin(mesh, time);
+    const vector<double>& speeds = mesh->field_store.vert_vals(mesh, time, FIELD_VEL_MAG);
+    double max = 0.;
+    for(const double s : speeds){
+        if(s > max) max = s;
+    }
+    return stagnation_speed_ratio * max;
+}
+
+
+const char* termination_reason_name(const TerminationReason reason)
+{
+    switch(reason){
+        case TERM_NONE: return "none";
+        case TERM_LEFT_DOMAIN: return "left domain";
+        case TERM_STAGNATION: return "stagnation";
+        case TERM_CYCLE: return "cycle";
+        case TERM_ARC_LENGTH: return "max arc length";
+        case TERM_MAX_STEPS: return "max steps";
+        case TERM_CONNECTED: return "connected";
+        default: return "unknown";
+    }
+}
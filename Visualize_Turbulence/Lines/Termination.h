@@ -0,0 +1,80 @@
+#ifndef TERMINATION_H
+#define TERMINATION_H
+
+#include <mutex>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+
+// why a streamline half stopped
+enum TerminationReason : unsigned char{
+    TERM_NONE = 0,
+    TERM_LEFT_DOMAIN,   // the next point is outside the mesh
+    TERM_STAGNATION,    // speed below the stagnation speed of the frame
+    TERM_CYCLE,         // re-entered a tet it visited a few tets ago
+    TERM_ARC_LENGTH,    // longer than max_streamline_arc_length
+    TERM_MAX_STEPS,     // ran all max_num_steps steps
+    TERM_CONNECTED,     // reached another singularity (ECG edges only)
+    NUM_TERMINATION_REASONS
+};
+
+
+// the last cycle_window tets a line entered, in a 32 slot open addressing table keyed by tet index
+// entries older than the window are treated as empty, so nothing ever has to be removed
+class RecentTets{
+public:
+    RecentTets();
+    bool visit(const long tet);
+
+private:
+    static const UI num_slots = 32;
+    static const UI max_probes = 8;
+    long tets[num_slots];
+    UL stamps[num_slots];
+    UL num_entered;
+};
+
+
+// cheap stop criteria of one streamline half, evaluated once per integration step
+class StreamlineTermination{
+public:
+    StreamlineTermination(const double min_speed);
+
+    inline bool is_stagnant(const double speed) const;
+    TerminationReason after_step(const long tet, const double step_length);
+
+private:
+    double min_speed;
+    double arc_length;
+    long last_tet;
+    RecentTets recent;
+};
+
+
+// how many halves stopped for each reason and how many steps they took, shared by the tracing threads
+class TerminationStats{
+public:
+    UL counts[NUM_TERMINATION_REASONS];
+    UL num_steps;
+
+    TerminationStats();
+    void add(const TerminationReason reason, const UL steps);
+    void merge(const TerminationStats& other);
+    void log(const char* what) const;
+
+private:
+    mutex stats_mutex;
+};
+
+double stagnation_speed(Mesh* mesh, const double time);
+const char* termination_reason_name(const TerminationReason reason);
+
+
+inline bool StreamlineTermination::is_stagnant(const double speed) const
+{
+    return speed < this->min_speed;
+}
+
+#endif // TERMINATION_H
@@ -0,0 +1,217 @@
+#include "Lines/VortexCore.h"
+#include "Others/Utilities.h"
+#include "Others/Parallel.h"
+#include <QElapsedTimer>
+
+VortexCore::VortexCore()
+{
+    this->time = 0.;
+    this->is_closed = false;
+}
+
+
+VortexCore::VortexCore(double time)
+{
+    this->time = time;
+    this->is_closed = false;
+}
+
+
+VortexCore::~VortexCore()
+{
+    for(UL i = 0; i < this->num_verts(); i++){
+        if(this->verts[i] != NULL) delete this->verts[i];
+    }
+    this->verts.clear();
+}
+
+
+// extract and cache the vortex core lines of all time steps
+void extract_vortex_cores_for_all_t(Mesh* mesh)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    UL num_lines = 0;
+    double time = 0.;
+    while(time < mesh->num_time_steps - 1.)
+    {
+        const FrameHandle frame = mesh->field_store.pin(mesh, time);
+        num_lines += get_vortex_cores(mesh, time).size();
+        time += time_step_size; // increment time
+    }
+
+    qDebug() << "Vortex cores:" << num_lines << "core lines in" << timer.nsecsElapsed() / 1e9 << "secs";
+}
+
+
+// return the cached vortex core lines at time, extract them on first use
+const vector<VortexCore*>& get_vortex_cores(Mesh* mesh, const double time)
+{
+    auto it = mesh->vortex_cores_for_all_t.find(time);
+    if(it != mesh->vortex_cores_for_all_t.end()) return it->second;
+
+    mesh->vortex_cores_for_all_t[time] = extract_vortex_cores(mesh, time);
+    return mesh->vortex_cores_for_all_t.at(time);
+}
+
+
+// Sujudi-Haimes vortex cores with the parallel vectors operator
+// https://doi.org/10.1109/VISUAL.1999.809896
+// a core is where the velocity v is parallel to the acceleration J*v and J has complex eigenvalues.
+// J is averaged to the vertices so v and J*v are both linear on a face and every face is tested once,
+// no matter which tet it is reached from. Faces are tested in parallel, then the hits of each tet that
+// has exactly two hit faces are linked through the shared faces into polylines.
+vector<VortexCore*> extract_vortex_cores(Mesh* mesh, const double time)
+{
+    const FrameFields* ff = mesh->field_store.frame(mesh, time);
+    const vector<double>& grads = mesh->field_store.vert_grads(mesh, time);
+    const double* vels = ff->vels.data();
+    const UL num_verts = mesh->num_verts();
+    const UL num_tris = mesh->num_tris();
+
+    // step 1: acceleration J*v at every vertex
+    vector<double> accs(3 * num_verts);
+    Utility::parallel_for(0, num_verts, [&](const UL begin, const UL end){
+        for(UL i = begin; i < end; i++){
+            const double* J = grads.data() + 9*i;
+            const double* v = vels + 3*i;
+            for(unsigned char r = 0; r < 3; r++){
+                accs[3*i + r] = J[r*3]*v[0] + J[r*3 + 1]*v[1] + J[r*3 + 2]*v[2];
+            }
+        }
+    });
+
+    // step 2: at most one swirling parallel vectors point on each face
+    vector<char> has_hit(num_tris, 0);
+    vector<double> hit_barys(3 * num_tris);
+    Utility::parallel_for(0, num_tris, [&](const UL begin, const UL end){
+        for(UL f = begin; f < end; f++){
+            const Triangle* tri = mesh->tris[f];
+            const double* face_vels[3];
+            const double* face_accs[3];
+            for(unsigned char k = 0; k < 3; k++){
+                face_vels[k] = vels + 3*tri->verts[k]->idx;
+                face_accs[k] = accs.data() + 3*tri->verts[k]->idx;
+            }
+            double* bary = hit_barys.data() + 3*f;
+            if(!parallel_vectors_on_face(face_vels, face_accs, bary)) continue;
+
+            double J[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+            for(unsigned char k = 0; k < 3; k++){
+                const double* g = grads.data() + 9*tri->verts[k]->idx;
+                for(unsigned char j = 0; j < 9; j++) J[j] += bary[k] * g[j];
+            }
+            if(is_swirling(J)) has_hit[f] = 1;
+        }
+    }, 256);
+
+    // step 3: link the two hit faces of a tet, a face is shared by at most two tets
+    const long none = -1;
+    vector<long> links(2 * num_tris, none);
+    for(const Tet* tet : mesh->tets){
+        long hit_faces[4];
+        unsigned char num_hits = 0;
+        for(const Triangle* tri : tet->tris){
+            if(has_hit[tri->idx]) hit_faces[num_hits++] = tri->idx;
+        }
+        if(num_hits != 2) continue; // no core, or a branching we don't resolve
+
+        for(unsigned char k = 0; k < 2; k++){
+            const long f = hit_faces[k], other = hit_faces[1 - k];
+            if(links[2*f] == none) links[2*f] = other;
+            else if(links[2*f + 1] == none) links[2*f + 1] = other;
+        }
+    }
+
+    // step 4: walk the chains, open ones start at a face with a single link
+    vector<char> visited(num_tris, 0);
+    vector<VortexCore*> cores;
+    auto make_vertex = [&](const long f) -> Vertex* {
+        const Triangle* tri = mesh->tris[f];
+        const double* bary = hit_barys.data() + 3*f;
+        Vector3d cords(0.), vel(0.);
+        for(unsigned char k = 0; k < 3; k++){
+            const Vertex* v = tri->verts[k];
+            cords += v->cords * bary[k];
+            vel += Vector3d(vels + 3*v->idx) * bary[k];
+        }
+        Vertex* vert = new Vertex(cords);
+        vert->vels[time] = new Vector3d(vel);
+        return vert;
+    };
+    auto walk = [&](const long start, const bool closed){
+        vector<long> faces;
+        long prev = none, cur = start;
+        while(cur != none && !visited[cur]){
+            visited[cur] = 1;
+            faces.push_back(cur);
+            const long next = links[2*cur] != prev ? links[2*cur] : links[2*cur + 1];
+            prev = cur;
+            cur = next;
+        }
+        if(faces.size() < min_vortex_core_verts) return;
+
+        VortexCore* core = new VortexCore(time);
+        core->is_closed = closed;
+        core->verts.reserve(faces.size());
+        for(const long f : faces) core->verts.push_back(make_vertex(f));
+        cores.push_back(core);
+    };
+
+    for(UL f = 0; f < num_tris; f++){
+        if(has_hit[f] && !visited[f] && links[2*f] != none && links[2*f + 1] == none) walk(f, false);
+    }
+    for(UL f = 0; f < num_tris; f++){
+        if(has_hit[f] && !visited[f] && links[2*f] != none) walk(f, true);
+    }
+
+    return cores;
+}
+
+
+// Peikert and Roth's parallel vectors on a triangle
+// with v = V*b and w = W*b linear in the barycentric coordinates b, v || w means W*b = s*V*b,
+// so b is a real eigenvector of V^-1 * W. The point is on the face if all of b are non negative.
+bool parallel_vectors_on_face(const double* vels[3], const double* accs[3], double bary[3])
+{
+    Eigen::Matrix3d V, W;
+    for(unsigned char k = 0; k < 3; k++){
+        for(unsigned char r = 0; r < 3; r++){
+            V(r, k) = vels[k][r];
+            W(r, k) = accs[k][r];
+        }
+    }
+    const double det = V.determinant();
+    if(fabs(det) < zero_threshold) return false;
+
+    Eigen::EigenSolver<Eigen::Matrix3d> es(V.inverse() * W);
+    for(unsigned char k = 0; k < 3; k++){
+        const complex<double> eig = es.eigenvalues()[k];
+        if(fabs(eig.imag()) > 1e-9 * (1. + fabs(eig.real()))) continue;
+
+        const Eigen::Vector3d b = es.eigenvectors().col(k).real();
+        const double sum = b.sum();
+        if(fabs(sum) < zero_threshold) continue;
+
+        const Eigen::Vector3d nb = b / sum;
+        if(nb[0] < 0. || nb[1] < 0. || nb[2] < 0.) continue;
+        bary[0] = nb[0];
+        bary[1] = nb[1];
+        bary[2] = nb[2];
+        return true;
+    }
+    return false;
+}
+
+
+// J has a pair of complex eigenvalues if the discriminant of its characteristic polynomial is negative
+// characteristic polynomial: x^3 + a*x^2 + b*x + c
+bool is_swirling(const double J[9])
+{
+    const double a = -(J[0] + J[4] + J[8]);
+    const double b = J[0]*J[4] - J[1]*J[3] + J[0]*J[8] - J[2]*J[6] + J[4]*J[8] - J[5]*J[7];
+    const double c = -( J[0] * (J[4]*J[8] - J[5]*J[7]) - J[1] * (J[3]*J[8] - J[5]*J[6]) + J[2] * (J[3]*J[7] - J[4]*J[6]) );
+    const double disc = 18.*a*b*c - 4.*a*a*a*c + a*a*b*b - 4.*b*b*b - 27.*c*c;
+    return disc < 0.;
+}
@@ -0,0 +1,39 @@
+#ifndef VORTEXCORE_H
+#define VORTEXCORE_H
+
+#include <vector>
+#include "Geometry/Vertex.h"
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+
+// a vortex core line, one vertex where the line crosses a tet face
+class VortexCore
+{
+public:
+    double time; // indicates which time this core line is for
+    vector<Vertex*> verts; // in order along the line, owned by this core line
+    bool is_closed; // the last vertex connects back to the first one
+
+    VortexCore();
+    VortexCore(double time);
+    ~VortexCore();
+
+    inline UL num_verts() const;
+};
+
+void extract_vortex_cores_for_all_t(Mesh* mesh);
+const vector<VortexCore*>& get_vortex_cores(Mesh* mesh, const double time);
+vector<VortexCore*> extract_vortex_cores(Mesh* mesh, const double time);
+bool parallel_vectors_on_face(const double* vels[3], const double* accs[3], double bary[3]);
+bool is_swirling(const double J[9]);
+
+
+inline UL VortexCore::num_verts() const
+{
+    return this->verts.size();
+}
+
+#endif // VORTEXCORE_H
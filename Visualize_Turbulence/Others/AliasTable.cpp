@@ -0,0 +1,46 @@
+#include "Others/AliasTable.h"
+
+AliasTable::AliasTable()
+{
+    this->total = 0.;
+}
+
+
+// negative weights count as 0
+void AliasTable::build(const vector<double>& weights)
+{
+    const UL n = weights.size();
+    this->prob.assign(n, 1.);
+    this->alias.resize(n);
+    this->total = 0.;
+    for(const double w : weights){
+        if(w > 0.) this->total += w;
+    }
+    if(n == 0 || this->total <= 0.) return;
+
+    // scale so the average column holds exactly 1, then pair every small column with a large one
+    vector<double> scaled(n);
+    vector<UL> small, large;
+    small.reserve(n);
+    large.reserve(n);
+    for(UL i = 0; i < n; i++){
+        scaled[i] = (weights[i] > 0. ? weights[i] : 0.) * n / this->total;
+        this->alias[i] = i;
+        if(scaled[i] < 1.) small.push_back(i);
+        else large.push_back(i);
+    }
+    while(!small.empty() && !large.empty()){
+        const UL s = small.back(), l = large.back();
+        small.pop_back();
+        this->prob[s] = scaled[s];
+        this->alias[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.;
+        if(scaled[l] < 1.){
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // whatever is left is 1 up to rounding
+    for(const UL i : small) this->prob[i] = 1.;
+    for(const UL i : large) this->prob[i] = 1.;
+}
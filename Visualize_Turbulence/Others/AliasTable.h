@@ -0,0 +1,38 @@
+#ifndef ALIASTABLE_H
+#define ALIASTABLE_H
+
+#include <vector>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+// Walker/Vose alias table: after an O(n) build, an index is drawn with probability weights[i] / sum in O(1)
+// from two uniform numbers in [0, 1)
+class AliasTable{
+public:
+    vector<double> prob;  // chance of keeping the column, otherwise take its alias
+    vector<UL> alias;
+    double total;         // sum of the weights, 0 if nothing can be drawn
+
+    AliasTable();
+
+    inline UL size() const;
+    void build(const vector<double>& weights);
+    inline UL sample(const double u1, const double u2) const;
+};
+
+
+inline UL AliasTable::size() const
+{
+    return this->prob.size();
+}
+
+
+inline UL AliasTable::sample(const double u1, const double u2) const
+{
+    UL column = (UL) (u1 * this->size());
+    if(column >= this->size()) column = this->size() - 1;
+    return u2 < this->prob[column] ? column : this->alias[column];
+}
+
+#endif // ALIASTABLE_H
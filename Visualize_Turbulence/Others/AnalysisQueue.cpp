@@ -0,0 +1,549 @@
+#include "Others/AnalysisQueue.h"
+#include "Others/Utilities.h"
+#include "Geometry/Mesh.h"
+#include "Surfaces/Isosurface.h"
+#include "Surfaces/SpanSpace.h"
+#include "Lines/StreamLine.h"
+#include "Lines/FlowSampler.h"
+#include "Lines/Seeding.h"
+#include "Lines/Termination.h"
+#include "FileLoader/ProductCache.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+static const char* product_names[NUM_FRAME_PRODUCTS] = {"isosurface", "ECG", "streamlines"};
+
+
+FrameResult::FrameResult(Mesh* mesh, const double time, const FrameProduct product)
+{
+    this->mesh = mesh;
+    this->time = time;
+    this->product = product;
+    this->span = nullptr;
+    this->isosurface = nullptr;
+    this->iso_val = 0.;
+    this->ecg = nullptr;
+}
+
+
+FrameResult::~FrameResult()
+{
+    if(this->span != nullptr) delete this->span;
+    if(this->isosurface != nullptr) delete this->isosurface;
+    if(this->ecg != nullptr) delete this->ecg;
+    for(StreamLine* sl : this->sls) delete sl;
+    this->sls.clear();
+    this->tets_with_fixed_pt.clear();
+}
+
+
+// estimated heap size of an interpolated vertex: the vertex, its vel and vor and an entry in each of its 3 time maps
+static const UL vertex_bytes = sizeof(Vertex) + 2 * sizeof(Vector3d) + 3 * (sizeof(double) + 3 * sizeof(void*));
+
+
+static UL streamline_bytes(const vector<StreamLine*>& sls)
+{
+    UL bytes = 0;
+    for(const StreamLine* sl : sls){
+        // the vertices and the float copy of their points and speeds in the LOD
+        bytes += sizeof(StreamLine) + sl->num_verts() * (vertex_bytes + sizeof(Vertex*) + 4 * sizeof(float));
+    }
+    return bytes;
+}
+
+
+// estimated heap size of one product of one frame in the mesh
+static UL frame_bytes(Mesh* mesh, const FrameProduct product, const double time)
+{
+    if(product == PRODUCT_ISOSURFACE){
+        const Isosurface* isosurf = mesh->isosurfaces_for_all_t.at(time);
+        UL bytes = sizeof(Isosurface) + isosurf->verts.size() * (vertex_bytes + sizeof(Vertex*))
+                 + isosurf->num_tris() * (sizeof(Triangle) + sizeof(Triangle*));
+        auto it = mesh->span_spaces_for_all_t.find(time);
+        if(it != mesh->span_spaces_for_all_t.end()){
+            const SpanSpace* span = it->second;
+            bytes += sizeof(SpanSpace) + (span->vert_vals.size() + span->tet_mins.size() + span->tet_maxs.size()) * sizeof(double)
+                   + (span->tet_ids.size() + span->bucket_starts.size()) * sizeof(UL);
+        }
+        return bytes;
+    }
+    if(product == PRODUCT_ECG){
+        const ECG* ecg = mesh->ECG_for_all_t.at(time);
+        UL bytes = sizeof(ECG) + ecg->num_sings() * sizeof(Singularity) + ecg->num_nodes() * sizeof(ECG_NODE)
+                 + ecg->num_edges() * sizeof(ECG_EDGE) + streamline_bytes(ecg->sls);
+        auto it = mesh->tet_with_fixed_pt_for_all_t.find(time);
+        if(it != mesh->tet_with_fixed_pt_for_all_t.end()) bytes += it->second.size() * sizeof(Tet*);
+        return bytes;
+    }
+    return streamline_bytes(mesh->streamlines_for_all_t.at(time));
+}
+
+
+AnalysisQueue::AnalysisQueue(function<void()> notify, function<void(Mesh*, const double)> forget)
+{
+    this->notify = notify;
+    this->forget = forget;
+    this->stopping = false;
+    this->busy = false;
+    this->num_uses = 0;
+    this->resident_bytes = 0;
+}
+
+
+AnalysisQueue::~AnalysisQueue()
+{
+    this->stop();
+
+    for(FrameResult* result : this->results) delete result;
+    this->results.clear();
+
+    for(auto& pair : this->work){
+        if(pair.second.sampler != nullptr) delete pair.second.sampler;
+        if(pair.second.empty_grid != nullptr) delete pair.second.empty_grid;
+    }
+    this->work.clear();
+}
+
+
+// the slots of every time of mesh, made the first time, call it with lock held
+vector<AnalysisQueue::FrameSlot>& AnalysisQueue::slots_of(Mesh* mesh, const FrameProduct product)
+{
+    vector<FrameSlot>& slots = this->slots[product][mesh];
+    if(this->frame_times.find(mesh) == this->frame_times.end()){
+        vector<double>& times = this->frame_times[mesh];
+        double time = 0.;
+        while(time < mesh->num_time_steps - 1.){
+            times.push_back(time);
+            time += time_step_size;
+        }
+    }
+    if(slots.empty()) slots.assign(this->frame_times.at(mesh).size(), {SLOT_MISSING, 0, 0});
+    return slots;
+}
+
+
+// true if the mesh has the product at time, an isosurface only counts for the current ratio and field
+bool AnalysisQueue::is_resident(Mesh* mesh, const FrameProduct product, const double time) const
+{
+    if(product == PRODUCT_ISOSURFACE){
+        auto it = mesh->isosurfaces_for_all_t.find(time);
+        return it != mesh->isosurfaces_for_all_t.end() && it->second->level_ratio == surface_level_ratio
+                && it->second->field == isosurface_field;
+    }
+    if(product == PRODUCT_ECG) return mesh->ECG_for_all_t.count(time);
+    return mesh->streamlines_for_all_t.count(time);
+}
+
+
+// how many frames frame is after the focus frame of its mesh in the direction of the animation,
+// ULONG_MAX for meshes that aren't in view
+UL AnalysisQueue::ahead_of_focus(Mesh* mesh, const UL frame) const
+{
+    auto it = this->focus.find(mesh);
+    if(it == this->focus.end()) return ULONG_MAX;
+    const Focus& at = it->second;
+    const UL n = this->frame_times.at(mesh).size();
+    return at.direction > 0 ? (frame + n - at.frame) % n : (at.frame + n - frame) % n;
+}
+
+
+// register the frames a mesh has already, e.g. from the product cache, so they count against the budget
+void AnalysisQueue::track(Mesh* mesh)
+{
+    {
+        lock_guard<mutex> guard(this->lock);
+        for(unsigned char p = 0; p < NUM_FRAME_PRODUCTS; p++){
+            const FrameProduct product = (FrameProduct) p;
+            vector<FrameSlot>& slots = this->slots_of(mesh, product);
+            const vector<double>& times = this->frame_times.at(mesh);
+            bool all = true;
+            for(UL f = 0; f < slots.size(); f++){
+                if(this->is_resident(mesh, product, times[f])) this->make_resident(mesh, product, times[f]);
+                else all = false;
+            }
+            // loaded from the cache, no need to write it again
+            this->saved[product][mesh] = all;
+        }
+        for(const auto& pair : mesh->ECG_for_all_t) this->ecgs[mesh][pair.first] = pair.second;
+    }
+    this->evict_over_budget();
+}
+
+
+// the meshes the view draws, e.g. the datasets of the compare view. the others lose their focus, so their queued
+// frames are dropped and their resident ones are the first to be evicted
+void AnalysisQueue::focus_on(const vector<Mesh*>& in_view)
+{
+    lock_guard<mutex> guard(this->lock);
+    for(auto it = this->focus.begin(); it != this->focus.end(); ){
+        if(find(in_view.begin(), in_view.end(), it->first) == in_view.end()) it = this->focus.erase(it);
+        else it++;
+    }
+}
+
+
+// the view draws product at time, queue it and the frames after it if they're missing
+// the view extracts the isosurface on screen itself, see update_isosurface, so only the ones after it are queued
+void AnalysisQueue::request(Mesh* mesh, const FrameProduct product, const double time)
+{
+    {
+        lock_guard<mutex> guard(this->lock);
+        vector<FrameSlot>& slots = this->slots_of(mesh, product);
+        const vector<double>& times = this->frame_times.at(mesh);
+        const UL n = slots.size();
+        const UL frame = (UL) llround(time / time_step_size);
+        if(frame >= n) return;
+
+        // the direction is taken from the step between two frames of the mesh on screen
+        auto it = this->focus.find(mesh);
+        if(it == this->focus.end()) it = this->focus.insert({mesh, {frame, 1}}).first;
+        Focus& at = it->second;
+        if(frame != at.frame){
+            if(frame == (at.frame + 1) % n) at.direction = 1;
+            else if(frame == (at.frame + n - 1) % n) at.direction = -1;
+        }
+        at.frame = frame;
+        this->num_uses++;
+
+        for(UL k = product == PRODUCT_ISOSURFACE ? 1 : 0; k <= prefetch_frames && k < n; k++){
+            const UL f = at.direction > 0 ? (frame + k) % n : (frame + n - k % n) % n;
+            FrameSlot& slot = slots[f];
+            if(this->is_resident(mesh, product, times[f])){
+                // the view may have replaced it, e.g. an isosurface after the slider moved
+                this->make_resident(mesh, product, times[f]);
+                slot.last_use = this->num_uses;
+                continue;
+            }
+            // an isosurface of an older ratio or field
+            if(slot.state == SLOT_RESIDENT) this->evict(mesh, product, times[f]);
+            if(slot.state == SLOT_MISSING) this->queue(mesh, product, f);
+            slot.last_use = this->num_uses;
+        }
+    }
+    this->wake.notify_one();
+    this->evict_over_budget();
+}
+
+
+// call it with lock held
+void AnalysisQueue::queue(Mesh* mesh, const FrameProduct product, const UL frame)
+{
+    this->slots_of(mesh, product)[frame].state = SLOT_QUEUED;
+    this->tasks.push_back({mesh, this->frame_times.at(mesh)[frame], frame, product, isosurface_field, surface_level_ratio});
+}
+
+
+// the product at time is in the mesh, its size is estimated again. call it with lock held
+void AnalysisQueue::make_resident(Mesh* mesh, const FrameProduct product, const double time)
+{
+    FrameSlot& slot = this->slots_of(mesh, product)[(UL) llround(time / time_step_size)];
+    if(slot.state == SLOT_RESIDENT) this->resident_bytes -= slot.bytes;
+    slot.state = SLOT_RESIDENT;
+    slot.bytes = frame_bytes(mesh, product, time);
+    this->resident_bytes += slot.bytes;
+}
+
+
+// delete the product at time from the mesh, call it with lock held
+// forget is called first, while the product is still there
+void AnalysisQueue::evict(Mesh* mesh, const FrameProduct product, const double time)
+{
+    FrameSlot& slot = this->slots_of(mesh, product)[(UL) llround(time / time_step_size)];
+    if(slot.state == SLOT_RESIDENT) this->resident_bytes -= slot.bytes;
+    slot.state = SLOT_MISSING;
+    slot.bytes = 0;
+    this->forget(mesh, time);
+
+    if(product == PRODUCT_ISOSURFACE){
+        auto it = mesh->isosurfaces_for_all_t.find(time);
+        if(it != mesh->isosurfaces_for_all_t.end()){
+            delete it->second;
+            mesh->isosurfaces_for_all_t.erase(it);
+        }
+        auto span = mesh->span_spaces_for_all_t.find(time);
+        if(span != mesh->span_spaces_for_all_t.end()){
+            delete span->second;
+            mesh->span_spaces_for_all_t.erase(span);
+        }
+    }
+    else if(product == PRODUCT_ECG){
+        this->ecgs[mesh].erase(time);
+        auto it = mesh->ECG_for_all_t.find(time);
+        if(it != mesh->ECG_for_all_t.end()){
+            delete it->second;
+            mesh->ECG_for_all_t.erase(it);
+        }
+        mesh->tet_with_fixed_pt_for_all_t.erase(time);
+    }
+    else{
+        auto it = mesh->streamlines_for_all_t.find(time);
+        if(it != mesh->streamlines_for_all_t.end()){
+            for(StreamLine* sl : it->second) delete sl;
+            mesh->streamlines_for_all_t.erase(it);
+        }
+    }
+}
+
+
+// delete the least recently requested frames until the rest fits into frame_memory_budget
+// the frames the view asks for next and the ECG the worker is seeding from are kept
+void AnalysisQueue::evict_over_budget()
+{
+    lock_guard<mutex> guard(this->lock);
+    UL num_evicted = 0;
+    while(this->resident_bytes > frame_memory_budget){
+        Mesh* victim = nullptr;
+        FrameProduct victim_product = PRODUCT_ISOSURFACE;
+        UL victim_frame = 0, oldest = ULONG_MAX;
+        for(unsigned char p = 0; p < NUM_FRAME_PRODUCTS; p++){
+            for(auto& pair : this->slots[p]){
+                for(UL f = 0; f < pair.second.size(); f++){
+                    const FrameSlot& slot = pair.second[f];
+                    if(slot.state != SLOT_RESIDENT || slot.last_use >= oldest) continue;
+                    if(this->ahead_of_focus(pair.first, f) <= prefetch_frames) continue;
+                    if(p == PRODUCT_ECG && this->busy && this->current.mesh == pair.first
+                            && this->current.product == PRODUCT_STREAMLINES && this->current.frame == f) continue;
+                    victim = pair.first;
+                    victim_product = (FrameProduct) p;
+                    victim_frame = f;
+                    oldest = slot.last_use;
+                }
+            }
+        }
+        if(victim == nullptr) break;
+        this->evict(victim, victim_product, this->frame_times.at(victim)[victim_frame]);
+        num_evicted++;
+    }
+    if(num_evicted > 0){
+        qDebug() << "Background analysis: evicted" << num_evicted << "frames," << this->resident_bytes / (1 << 20)
+                 << "MB of" << frame_memory_budget / (1 << 20) << "MB in use";
+    }
+}
+
+
+UL AnalysisQueue::num_queued() const
+{
+    lock_guard<mutex> guard(this->lock);
+    return this->tasks.size() + (this->busy ? 1 : 0);
+}
+
+
+void AnalysisQueue::start()
+{
+    if(this->worker.joinable()) return;
+    this->stopping = false;
+    this->worker = thread(&AnalysisQueue::run, this);
+}
+
+
+// the frame in progress is finished first, the queued ones stay queued
+void AnalysisQueue::stop()
+{
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    if(this->worker.joinable()) this->worker.join();
+}
+
+
+// move the finished frames into their meshes, returns how many there were
+// a frame that was made on the GUI thread in the meantime (an isosurface the view asked for) is kept
+// and the background one deleted. a product is written to the cache once all of its frames are in memory
+UL AnalysisQueue::publish()
+{
+    vector<FrameResult*> done;
+    vector<pair<Mesh*, FrameProduct>> finished;
+    {
+        lock_guard<mutex> guard(this->lock);
+        done.swap(this->results);
+
+        for(FrameResult* result : done){
+            Mesh* mesh = result->mesh;
+            const double time = result->time;
+            const FrameProduct product = result->product;
+            if(product == PRODUCT_ISOSURFACE){
+                auto span = mesh->span_spaces_for_all_t.find(time);
+                if(span == mesh->span_spaces_for_all_t.end() || span->second->field != result->span->field){
+                    if(span != mesh->span_spaces_for_all_t.end()) delete span->second;
+                    mesh->span_spaces_for_all_t[time] = result->span;
+                    result->span = nullptr;
+                }
+                auto it = mesh->isosurfaces_for_all_t.find(time);
+                if(it == mesh->isosurfaces_for_all_t.end() || !this->is_resident(mesh, product, time)){
+                    if(it != mesh->isosurfaces_for_all_t.end()){
+                        delete it->second;
+                        this->forget(mesh, time);
+                    }
+                    mesh->isosurfaces_for_all_t[time] = result->isosurface;
+                    surface_level_vals[time] = result->iso_val;
+                    result->isosurface = nullptr;
+                }
+            }
+            else if(product == PRODUCT_ECG){
+                if(!mesh->ECG_for_all_t.count(time)){
+                    mesh->ECG_for_all_t[time] = result->ecg;
+                    mesh->tet_with_fixed_pt_for_all_t[time] = result->tets_with_fixed_pt;
+                    result->ecg = nullptr;
+                }
+                this->ecgs[mesh][time] = mesh->ECG_for_all_t.at(time);
+            }
+            else if(!mesh->streamlines_for_all_t.count(time)){
+                mesh->streamlines_for_all_t[time] = result->sls;
+                result->sls.clear();
+            }
+            delete result;
+
+            this->make_resident(mesh, product, time);
+            this->slots_of(mesh, product)[(UL) llround(time / time_step_size)].last_use = this->num_uses;
+
+            bool all = !this->saved[product][mesh];
+            for(const FrameSlot& slot : this->slots_of(mesh, product)) all = all && slot.state == SLOT_RESIDENT;
+            if(all){
+                this->saved[product][mesh] = true;
+                finished.push_back({mesh, product});
+            }
+        }
+    }
+
+    for(const auto& pair : finished) this->finish(pair.first, pair.second);
+    this->evict_over_budget();
+    return done.size();
+}
+
+
+// every frame of a product is in memory at once
+void AnalysisQueue::finish(Mesh* mesh, const FrameProduct product)
+{
+    qDebug() << "Background analysis:" << product_names[product] << "done for all" << mesh->num_time_steps - 1 << "times";
+    if(product == PRODUCT_ISOSURFACE){
+        // the slider or the field may have changed while they were made, the cache key only has the current ones
+        for(const auto& pair : mesh->isosurfaces_for_all_t){
+            if(pair.second->level_ratio != surface_level_ratio || pair.second->field != isosurface_field) return;
+        }
+        // FTLE is only there for the frames it was computed for, the other frames have empty surfaces
+        if(isosurface_field == FIELD_FTLE) return;
+        save_cached_isosurfaces(mesh);
+    }
+    else if(product == PRODUCT_ECG) save_cached_ECGs(mesh);
+    else save_cached_streamlines(mesh);
+}
+
+
+void AnalysisQueue::run()
+{
+    while(true){
+        Task task;
+        {
+            unique_lock<mutex> guard(this->lock);
+            this->wake.wait(guard, [this](){ return this->stopping || !this->tasks.empty(); });
+            if(this->stopping) return;
+            if(!this->take_next(task)) continue;
+            this->busy = true;
+            this->current = task;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        FrameResult* result = this->compute(task);
+        qDebug() << "Background analysis:" << product_names[task.product] << "of time" << task.time << "in"
+                 << timer.nsecsElapsed() / 1e9 << "secs";
+
+        {
+            lock_guard<mutex> guard(this->lock);
+            this->busy = false;
+            // the streamlines of this time may be seeded from it before it is published
+            if(task.product == PRODUCT_ECG) this->ecgs[task.mesh][task.time] = result->ecg;
+            this->results.push_back(result);
+        }
+        this->notify();
+    }
+}
+
+
+// remove the task closest ahead of the focus from the queue, call it with lock held
+// tasks that have fallen out of the prefetch window are dropped, they are queued again when asked for,
+// so are the ones the view has made itself in the meantime
+bool AnalysisQueue::take_next(Task& task)
+{
+    UL best = ULONG_MAX, best_key = ULONG_MAX;
+    for(UL i = 0; i < this->tasks.size(); ){
+        const Task& t = this->tasks[i];
+        const UL ahead = this->ahead_of_focus(t.mesh, t.frame);
+        FrameSlot& slot = this->slots_of(t.mesh, t.product)[t.frame];
+        if(ahead > prefetch_frames || slot.state == SLOT_RESIDENT){
+            if(slot.state == SLOT_QUEUED) slot.state = SLOT_MISSING;
+            this->tasks[i] = this->tasks.back();
+            this->tasks.pop_back();
+            continue;
+        }
+        const UL key = ahead * NUM_FRAME_PRODUCTS + t.product;
+        if(key < best_key){
+            best = i;
+            best_key = key;
+        }
+        i++;
+    }
+    if(best == ULONG_MAX) return false;
+    task = this->tasks[best];
+    this->tasks[best] = this->tasks.back();
+    this->tasks.pop_back();
+    return true;
+}
+
+
+// the flow sampler, empty grid and random seeds of a mesh are made the first time the worker needs them
+AnalysisQueue::MeshWork& AnalysisQueue::work_of(Mesh* mesh)
+{
+    auto it = this->work.find(mesh);
+    if(it != this->work.end()) return it->second;
+    MeshWork& w = this->work[mesh];
+    w.sampler = new FlowSampler(mesh);
+    w.empty_grid = streamline_seeding == SEED_EVENLY_SPACED ? new OccupancyGrid(*w.sampler, evenly_spaced_separation) : nullptr;
+    if(streamline_seeding == SEED_RANDOM) w.random_seeds = Utility::generate_unique_random_Tet_idx(mesh);
+    return w;
+}
+
+
+// runs on the worker, the same per-time steps main() used to run for all times
+FrameResult* AnalysisQueue::compute(const Task& task)
+{
+    Mesh* mesh = task.mesh;
+    const double time = task.time;
+    FrameResult* result = new FrameResult(mesh, time, task.product);
+    const FrameHandle frame = mesh->field_store.pin(mesh, time);
+
+    if(task.product == PRODUCT_ISOSURFACE){
+        result->span = new SpanSpace(mesh, time, task.field);
+        result->iso_val = task.level_ratio * (result->span->max_val - result->span->min_val) + result->span->min_val;
+        result->isosurface = extract_isosurface(mesh, result->span, result->iso_val, task.level_ratio);
+    }
+    else if(task.product == PRODUCT_ECG){
+        result->tets_with_fixed_pt = mesh->find_tets_with_fixedPts_at(time);
+        result->ecg = mesh->build_ECG_at(time, mesh->detect_sings_at(time));
+    }
+    else{
+        MeshWork& w = this->work_of(mesh);
+        if(streamline_seeding == SEED_EVENLY_SPACED){
+            result->sls = evenly_spaced_streamlines_at(mesh, *w.sampler, *w.empty_grid, time);
+        }
+        else{
+            if(streamline_seeding == SEED_IMPORTANCE){
+                const ECG* ecg = nullptr;
+                {
+                    lock_guard<mutex> guard(this->lock);
+                    auto it = this->ecgs[mesh].find(time);
+                    if(it != this->ecgs[mesh].end()) ecg = it->second;
+                }
+                result->sls = place_importance_seeds_at(mesh, time, ecg);
+            }
+            else result->sls = place_seeds_at(mesh, w.random_seeds, time);
+            TerminationStats stats;
+            trace_streamlines_at(mesh, *w.sampler, time, result->sls, stats);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,158 @@
+#ifndef ANALYSISQUEUE_H
+#define ANALYSISQUEUE_H
+
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "Analysis/ScalarFields.h"
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+class ECG;
+class Tet;
+class StreamLine;
+class Isosurface;
+class SpanSpace;
+class FlowSampler;
+class OccupancyGrid;
+
+// the per-frame products computed in the background, frames of one time are done in this order
+enum FrameProduct : unsigned char{
+    PRODUCT_ISOSURFACE = 0,
+    PRODUCT_ECG,            // singularities, tets with fixed points and the ECG
+    PRODUCT_STREAMLINES,
+    NUM_FRAME_PRODUCTS
+};
+
+
+// one product of one frame, made by the worker and moved into the mesh on the GUI thread
+class FrameResult{
+public:
+    Mesh* mesh;
+    double time;
+    FrameProduct product;
+
+    SpanSpace* span;
+    Isosurface* isosurface;
+    double iso_val;
+    ECG* ecg;
+    vector<Tet*> tets_with_fixed_pt;
+    vector<StreamLine*> sls;
+
+    FrameResult(Mesh* mesh, const double time, const FrameProduct product);
+    ~FrameResult(); // deletes whatever hasn't been moved into the mesh
+};
+
+
+// computes the frames of isosurfaces, ECGs and streamlines the view asks for on a background thread
+// request() is called for every product drawn at the frame on screen. a missing frame is queued together with
+// the next prefetch_frames frames in the direction the animation runs, queued frames that have fallen out of that
+// window are dropped again. every mesh in view has its own window, focus_on() tells which meshes the view draws. once the frames in memory add up to more than frame_memory_budget bytes, the least
+// recently requested ones outside the window are deleted, they are computed again if they are asked for.
+// the worker only reads the mesh and pins the field frame of the time it computes, the vertex maps have to be
+// interpolated for every time before start() unless the field data of the mesh is paged.
+// everything it makes is handed over in publish(), which has to be called on the GUI thread like every other
+// function here, it is the only place the per-time maps of the meshes are written besides the view itself.
+// notify is called on the worker thread after every frame and should queue a call of publish() on the GUI thread,
+// forget is called for every frame deleted from a mesh.
+class AnalysisQueue{
+public:
+    AnalysisQueue(function<void()> notify, function<void(Mesh*, const double)> forget);
+    ~AnalysisQueue(); // waits for the frame in progress, unpublished frames are deleted
+
+    void track(Mesh* mesh);
+    void focus_on(const vector<Mesh*>& in_view);
+    void request(Mesh* mesh, const FrameProduct product, const double time);
+    void start();
+    void stop();
+    UL publish();
+    UL num_queued() const;
+    inline UL num_resident_bytes() const;
+
+private:
+    enum SlotState : unsigned char{
+        SLOT_MISSING = 0,
+        SLOT_QUEUED,        // waiting or in progress
+        SLOT_RESIDENT       // in the mesh map
+    };
+
+    // what the queue knows about one product of one frame
+    struct FrameSlot{
+        SlotState state;
+        UL bytes;       // estimated heap size while resident
+        UL last_use;    // request count when it was last asked for
+    };
+
+    struct Task{
+        Mesh* mesh;
+        double time;
+        UL frame;
+        FrameProduct product;
+        ScalarFieldType field;  // of isosurfaces, taken when the task is queued
+        double level_ratio;
+    };
+
+    // the frame on screen of a mesh in view
+    struct Focus{
+        UL frame;
+        int direction;      // +1 or -1, the way the animation went last
+    };
+
+    struct MeshWork{
+        FlowSampler* sampler;
+        OccupancyGrid* empty_grid;
+        vector<UL> random_seeds;
+    };
+
+    thread worker;
+    mutable mutex lock;
+    condition_variable wake;
+    bool stopping;
+    function<void()> notify;
+    function<void(Mesh*, const double)> forget;
+
+    // guarded by lock
+    vector<Task> tasks;
+    vector<FrameResult*> results;
+    unordered_map<Mesh*, unordered_map<double, const ECG*>> ecgs; // for IMPORTANCE_SINGULARITIES seeding
+    unordered_map<Mesh*, vector<FrameSlot>> slots[NUM_FRAME_PRODUCTS];
+    unordered_map<Mesh*, vector<double>> frame_times; // the time of every frame
+    unordered_map<Mesh*, Focus> focus; // of every mesh in view
+    bool busy;
+    Task current;       // the task in progress if busy
+
+    // only touched by the GUI thread
+    UL num_uses;
+    UL resident_bytes;
+    unordered_map<Mesh*, bool> saved[NUM_FRAME_PRODUCTS];
+
+    // only touched by the worker
+    unordered_map<Mesh*, MeshWork> work;
+
+    vector<FrameSlot>& slots_of(Mesh* mesh, const FrameProduct product);
+    bool is_resident(Mesh* mesh, const FrameProduct product, const double time) const;
+    UL ahead_of_focus(Mesh* mesh, const UL frame) const;
+    void queue(Mesh* mesh, const FrameProduct product, const UL frame);
+    void make_resident(Mesh* mesh, const FrameProduct product, const double time);
+    void evict(Mesh* mesh, const FrameProduct product, const double time);
+    void evict_over_budget();
+    void finish(Mesh* mesh, const FrameProduct product);
+
+    void run();
+    bool take_next(Task& task);
+    FrameResult* compute(const Task& task);
+    MeshWork& work_of(Mesh* mesh);
+};
+
+
+inline UL AnalysisQueue::num_resident_bytes() const
+{
+    return this->resident_bytes;
+}
+
+#endif // ANALYSISQUEUE_H
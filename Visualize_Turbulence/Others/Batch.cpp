@@ -0,0 +1,361 @@
+#include "Others/Batch.h"
+#include "Others/Utilities.h"
+#include "Others/Parallel.h"
+#include "FileLoader/ReadFile.h"
+#include "Geometry/Mesh.h"
+#include "Surfaces/Isosurface.h"
+#include "Surfaces/SpanSpace.h"
+#include "Lines/StreamLine.h"
+#include "Lines/StreamLineLOD.h"
+#include "Lines/FlowSampler.h"
+#include "Lines/Seeding.h"
+#include "Lines/Termination.h"
+#include "Analysis/ECG.h"
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+// one result file, frames are written as they are produced
+class BatchWriter{
+public:
+    QFile file;
+
+    bool open(const QString& path, const BatchProduct product, const UL num_frames);
+    template<class T>
+    inline void put(const T& val);
+    inline void put_floats(const float* vals, const UL n);
+};
+
+
+bool BatchWriter::open(const QString& path, const BatchProduct product, const UL num_frames)
+{
+    this->file.setFileName(path);
+    if(!this->file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        qCritical() << "Batch: couldn't open" << path << "for writing";
+        return false;
+    }
+    BatchFileHeader header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, "VTBATCH");
+    header.version = batch_file_version;
+    header.product = product;
+    header.num_frames = num_frames;
+    this->put(header);
+    return true;
+}
+
+
+template<class T>
+inline void BatchWriter::put(const T& val)
+{
+    this->file.write((const char*) &val, sizeof(T));
+}
+
+
+inline void BatchWriter::put_floats(const float* vals, const UL n)
+{
+    this->file.write((const char*) vals, n * sizeof(float));
+}
+
+
+// the times of a per-time product that are in [time_begin, time_end], sorted
+template<class Map>
+static vector<double> times_in_range(const Map& map, const BatchParams& params)
+{
+    vector<double> times;
+    for(const auto& pair : map){
+        if(pair.first < params.time_begin) continue;
+        if(params.time_end >= 0. && pair.first > params.time_end) continue;
+        times.push_back(pair.first);
+    }
+    sort(times.begin(), times.end());
+    return times;
+}
+
+
+static void put_singularities(BatchWriter& out, const vector<Singularity*>& sings)
+{
+    out.put((UL) sings.size());
+    for(const Singularity* sing : sings){
+        const float p[3] = {(float) sing->x(), (float) sing->y(), (float) sing->z()};
+        out.put_floats(p, 3);
+        out.put((UI) sing->type);
+    }
+}
+
+
+static bool write_isosurfaces(Mesh* mesh, const BatchParams& params)
+{
+    const vector<double> times = times_in_range(mesh->isosurfaces_for_all_t, params);
+    BatchWriter out;
+    if(!out.open(params.out_dir + "/isosurfaces.bin", BATCH_ISOSURFACES, times.size())) return false;
+
+    for(const double time : times){
+        const Isosurface* isosurf = mesh->isosurfaces_for_all_t.at(time);
+        out.put(time);
+        out.put(surface_level_vals.at(time));
+        out.put((UL) isosurf->num_tris());
+        vector<float> pts(9 * isosurf->num_tris());
+        for(UL i = 0; i < isosurf->num_tris(); i++){
+            for(unsigned char k = 0; k < 3; k++){
+                const Vector3d& p = isosurf->tris[i]->verts[k]->cords;
+                for(unsigned char d = 0; d < 3; d++) pts[9*i + 3*k + d] = (float) p.entry[d];
+            }
+        }
+        out.put_floats(pts.data(), pts.size());
+    }
+    return true;
+}
+
+
+// every traced point, the level 0 of the streamline's LOD
+static bool write_streamlines(Mesh* mesh, const BatchParams& params)
+{
+    const vector<double> times = times_in_range(mesh->streamlines_for_all_t, params);
+    BatchWriter out;
+    if(!out.open(params.out_dir + "/streamlines.bin", BATCH_STREAMLINES, times.size())) return false;
+
+    for(const double time : times){
+        const vector<StreamLine*>& sls = mesh->streamlines_for_all_t.at(time);
+        out.put(time);
+        out.put((UL) sls.size());
+        for(StreamLine* sl : sls){
+            const StreamLineLOD* lod = sl->get_lod();
+            vector<float> pts(4 * lod->num_pts());
+            for(UL i = 0; i < lod->num_pts(); i++){
+                for(unsigned char d = 0; d < 3; d++) pts[4*i + d] = lod->pts[3*i + d];
+                pts[4*i + 3] = lod->speeds[i];
+            }
+            out.put((UL) lod->num_pts());
+            out.put_floats(pts.data(), pts.size());
+        }
+    }
+    return true;
+}
+
+
+// singularities.bin and ecg.bin, an edge whose node is missing has the index UINT_MAX
+static bool write_ecgs(Mesh* mesh, const BatchParams& params)
+{
+    const vector<double> times = times_in_range(mesh->ECG_for_all_t, params);
+    BatchWriter sings_out, ecg_out;
+    if(!sings_out.open(params.out_dir + "/singularities.bin", BATCH_SINGULARITIES, times.size())) return false;
+    if(!ecg_out.open(params.out_dir + "/ecg.bin", BATCH_ECG, times.size())) return false;
+
+    for(const double time : times){
+        ECG* ecg = mesh->ECG_for_all_t.at(time);
+        sings_out.put(time);
+        put_singularities(sings_out, ecg->get_sings());
+
+        const vector<ECG_NODE*> nodes = ecg->get_nodes();
+        unordered_map<const ECG_NODE*, UI> idx_of;
+        vector<Singularity*> node_sings;
+        for(UI i = 0; i < nodes.size(); i++){
+            idx_of[nodes[i]] = i;
+            node_sings.push_back(nodes[i]->sing);
+        }
+        ecg_out.put(time);
+        put_singularities(ecg_out, node_sings);
+
+        const vector<ECG_EDGE*> edges = ecg->get_edges();
+        ecg_out.put((UL) edges.size());
+        for(const ECG_EDGE* edge : edges){
+            for(unsigned char k = 0; k < 2; k++){
+                auto it = idx_of.find(edge->nodes[k]);
+                ecg_out.put(it != idx_of.end() ? it->second : (UI) UINT_MAX);
+            }
+        }
+    }
+    return true;
+}
+
+
+// the times of the data from time_begin on, counted up the way the stages count them so they are the same keys
+static vector<double> times_from(const Mesh* mesh, const BatchParams& params)
+{
+    vector<double> times;
+    double time = 0.;
+    while(time < mesh->num_time_steps - 1.){
+        if(time >= params.time_begin) times.push_back(time);
+        time += time_step_size;
+    }
+    return times;
+}
+
+
+// the per-frame steps of the background analysis, for a run that doesn't start at 0
+// the whole-run stages and their product cache only know runs from time 0
+static void compute_isosurfaces_at(Mesh* mesh, const vector<double>& times)
+{
+    mesh->interpolate_vertices_for_all_t();
+    for(const double time : times){
+        const FrameHandle frame = mesh->field_store.pin(mesh, time);
+        const SpanSpace* span = get_span_space(mesh, time);
+        surface_level_vals[time] = surface_level_ratio * (span->max_val - span->min_val) + span->min_val;
+        mesh->isosurfaces_for_all_t[time] = extract_isosurface(mesh, time, surface_level_vals.at(time));
+    }
+}
+
+
+static void compute_ECGs_at(Mesh* mesh, const vector<double>& times)
+{
+    mesh->interpolate_vertices_for_all_t();
+    for(const double time : times){
+        const FrameHandle frame = mesh->field_store.pin(mesh, time);
+        mesh->ECG_for_all_t[time] = mesh->build_ECG_at(time, mesh->detect_sings_at(time));
+    }
+}
+
+
+// IMPORTANCE_SINGULARITIES seeding uses the ECGs if they were computed
+static void compute_streamlines_at(Mesh* mesh, const vector<double>& times)
+{
+    mesh->interpolate_vertices_for_all_t();
+    const FlowSampler sampler(mesh);
+    const OccupancyGrid* empty_grid = streamline_seeding == SEED_EVENLY_SPACED ? new OccupancyGrid(sampler, evenly_spaced_separation) : nullptr;
+    const vector<UL> random_seeds = streamline_seeding == SEED_RANDOM ? Utility::generate_unique_random_Tet_idx(mesh) : vector<UL>();
+    TerminationStats stats;
+
+    for(const double time : times){
+        const FrameHandle frame = mesh->field_store.pin(mesh, time);
+        vector<StreamLine*> sls;
+        if(streamline_seeding == SEED_EVENLY_SPACED){
+            sls = evenly_spaced_streamlines_at(mesh, sampler, *empty_grid, time);
+        }
+        else{
+            if(streamline_seeding == SEED_IMPORTANCE){
+                auto it = mesh->ECG_for_all_t.find(time);
+                sls = place_importance_seeds_at(mesh, time, it != mesh->ECG_for_all_t.end() ? it->second : nullptr);
+            }
+            else sls = place_seeds_at(mesh, random_seeds, time);
+            trace_streamlines_at(mesh, sampler, time, sls, stats);
+        }
+        mesh->streamlines_for_all_t[time] = sls;
+    }
+    stats.log("Streamline termination");
+    delete empty_grid;
+}
+
+
+bool is_batch_run(int argc, char* argv[])
+{
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--batch") == 0) return true;
+    }
+    return false;
+}
+
+
+static void print_batch_usage()
+{
+    fprintf(stderr, "usage: Visualize_Turbulence_batch --mesh <mesh file> --data <data file> --out <dir>\n"
+                    "       [--from <time>] [--to <time>] [--no-isosurfaces] [--no-ecg] [--no-streamlines]\n"
+                    "   or: Visualize_Turbulence --batch ... with the same arguments\n"
+                    "only the frames from --from to --to are computed. a run from 0 reuses and fills the product cache,\n"
+                    "a later --from computes its frames one by one without it\n");
+}
+
+
+// false if an argument is unknown or a required one is missing
+bool parse_batch_args(int argc, char* argv[], BatchParams& params)
+{
+    params.time_begin = 0.;
+    params.time_end = -1.;
+    params.isosurfaces = params.ecg = params.streamlines = true;
+
+    for(int i = 1; i < argc; i++){
+        const QString arg = argv[i];
+        const bool has_val = i + 1 < argc;
+        if(arg == "--batch") continue;
+        else if(arg == "--mesh" && has_val) params.mesh_path = argv[++i];
+        else if(arg == "--data" && has_val) params.data_path = argv[++i];
+        else if(arg == "--out" && has_val) params.out_dir = argv[++i];
+        else if(arg == "--from" && has_val) params.time_begin = atof(argv[++i]);
+        else if(arg == "--to" && has_val) params.time_end = atof(argv[++i]);
+        else if(arg == "--no-isosurfaces") params.isosurfaces = false;
+        else if(arg == "--no-ecg") params.ecg = false;
+        else if(arg == "--no-streamlines") params.streamlines = false;
+        else{
+            fprintf(stderr, "unknown or incomplete argument %s\n", argv[i]);
+            print_batch_usage();
+            return false;
+        }
+    }
+
+    if(params.mesh_path.isEmpty() || params.data_path.isEmpty() || params.out_dir.isEmpty()){
+        print_batch_usage();
+        return false;
+    }
+    return true;
+}
+
+
+// load, compute and write without a QApplication, so no display or windowing system is touched
+// the stages are the ones main() runs before opening the window and use all cores where they are parallel
+int run_batch(const BatchParams& params)
+{
+    batch_mode = true;
+    vector<pair<const char*, double>> stages;
+    QElapsedTimer total, timer;
+    total.start();
+
+    if(!QDir().mkpath(params.out_dir)){
+        qCritical() << "Batch: couldn't create" << params.out_dir;
+        return 1;
+    }
+
+    timer.start();
+    ReadFile* file = new ReadFile(params.mesh_path, params.data_path);
+    Mesh* mesh = file->mesh;
+    meshes.push_back(mesh);
+    delete file;
+    // nothing past time_end is computed
+    if(params.time_end >= 0. && params.time_end + 2. < mesh->num_time_steps){
+        mesh->num_time_steps = (UI) floor(params.time_end) + 2;
+    }
+    stages.push_back({"load", timer.nsecsElapsed() / 1e9});
+    const bool from_start = params.time_begin <= 0.;
+    const vector<double> times = times_from(mesh, params);
+
+    if(params.isosurfaces){
+        timer.restart();
+        if(from_start) construct_isosurfaces();
+        else compute_isosurfaces_at(mesh, times);
+        stages.push_back({"isosurfaces", timer.nsecsElapsed() / 1e9});
+    }
+
+    if(params.ecg){
+        timer.restart();
+        if(from_start) build_ECGs(meshes);
+        else compute_ECGs_at(mesh, times);
+        stages.push_back({"singularities + ECG", timer.nsecsElapsed() / 1e9});
+    }
+
+    if(params.streamlines){
+        timer.restart();
+        if(from_start) tracing_streamlines();
+        else compute_streamlines_at(mesh, times);
+        stages.push_back({"streamlines", timer.nsecsElapsed() / 1e9});
+    }
+
+    timer.restart();
+    bool ok = true;
+    if(params.isosurfaces) ok = write_isosurfaces(mesh, params) && ok;
+    if(params.ecg) ok = write_ecgs(mesh, params) && ok;
+    if(params.streamlines) ok = write_streamlines(mesh, params) && ok;
+    stages.push_back({"write", timer.nsecsElapsed() / 1e9});
+
+    printf("\n%-24s %12s\n", "stage", "secs");
+    for(const auto& stage : stages) printf("%-24s %12.3f\n", stage.first, stage.second);
+    printf("%-24s %12.3f\n", "total", total.nsecsElapsed() / 1e9);
+    printf("%u threads, results in %s\n", Utility::num_threads(), params.out_dir.toLocal8Bit().constData());
+
+    meshes.clear();
+    delete mesh;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <QString>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+// what a headless run computes and where it writes it
+// only the times in [time_begin, time_end] are computed and written
+struct BatchParams{
+    QString mesh_path;
+    QString data_path;
+    QString out_dir;
+    double time_begin;
+    double time_end;    // negative for the last time step of the data
+    bool isosurfaces;
+    bool ecg;           // ECGs and their singularities
+    bool streamlines;
+};
+
+
+// every result file starts with this header, all numbers are in the byte order of the machine that wrote it
+// then for each frame: double time, followed by the frame of the product
+//   BATCH_ISOSURFACES:   double level, UL num_tris, num_tris * 9 floats
+//   BATCH_STREAMLINES:   UL num_lines, then per line UL num_pts, num_pts * (x, y, z, speed) floats
+//   BATCH_SINGULARITIES: UL num_sings, then per singularity x, y, z floats and UI type
+//   BATCH_ECG:           the singularities as above, then UL num_edges and 2 UI node indices per edge
+enum BatchProduct : UI{
+    BATCH_ISOSURFACES = 1,
+    BATCH_STREAMLINES,
+    BATCH_SINGULARITIES,
+    BATCH_ECG
+};
+
+struct BatchFileHeader{
+    char magic[8];      // "VTBATCH", zero terminated
+    UI version;
+    UI product;         // a BatchProduct
+    UL num_frames;
+};
+
+static const UI batch_file_version = 1;
+
+bool is_batch_run(int argc, char* argv[]);
+bool parse_batch_args(int argc, char* argv[], BatchParams& params);
+int run_batch(const BatchParams& params);
+
+#endif // BATCH_H
@@ -12,8 +12,11 @@
 #include "Others/Predefined.h"
 #include "Geometry/Triangle.h"
 #include "Geometry/Vertex.h"
+#include "Lines/ParticleCloud.h"
 #include "Lines/PathLine.h"
 #include "Lines/StreamLine.h"
+#include "Lines/StreamLineLOD.h"
+#include "Lines/VortexCore.h"
 #include "Analysis/FixedPtDetect.h"
 
 // function prototypes
@@ -24,9 +27,11 @@ inline void draw_cylinder(
 inline void draw_axis();
 inline void draw_arrow();
 inline void draw_arrow(PathLine* pl);
-inline void draw_pathlines(PathLine* pl, const double min_vel_mag, const double max_vel_mag);
+inline void draw_pathlines(const PathLine* pl, const double time, const double min_vel_mag, const double max_vel_mag);
 inline void draw_triangles(vector<Triangle*>& tris);
 inline void draw_isosurfaces(const Isosurface* isosurface, const double min, const double max);
+inline void draw_vortex_core(const VortexCore* core, const double min, const double max);
+inline void draw_particle_cloud(ParticleCloud* cloud);
 
 /*---------------------------------------------------------------------*/
 
@@ -173,18 +178,22 @@ inline void draw_arrow(const Vector3d& pos, const Vector3d& vel)
 }
 
 
-inline void draw_pathlines(PathLine* pl, const double min_vel_mag, const double max_vel_mag)
+// draw the part of the pathline that the particle has travelled by time
+inline void draw_pathlines(const PathLine* pl, const double time, const double min_vel_mag, const double max_vel_mag)
 {
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+
     glLineWidth(4);
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
     glBegin(GL_LINE_STRIP);
-    for(const Vertex* v : pl->verts){
-        const Vector3d& p = v->cords;
-        const Vector3d& vel = v->vels.begin()->second;
-        double vel_mag = length(vel);
-        //const RGB color = CT.lookUp((vel_mag - min_vel_mag) / (max_vel_mag-min_vel_mag));
-        glColor3f(1, 0, 0);
+    const double dmag = max_vel_mag - min_vel_mag;
+    for(UL i = 0; i < pl->num_verts(); i++){
+        if(pl->times[i] > time) break;
+        const Vector3d& p = pl->pts[i];
+        const Vector3d color = CT.lookUp((pl->speeds[i] - min_vel_mag) / dmag);
+        glColor3f(color.x(), color.y(), color.z());
         glVertex3f(p.x(), p.y(), p.z());
     }
     glEnd();
@@ -192,7 +201,7 @@ inline void draw_pathlines(PathLine* pl, const double min_vel_mag, const double
 }
 
 
-inline void draw_streamline(const StreamLine* sl, const double min, const double max)
+inline void draw_vortex_core(const VortexCore* core, const double min, const double max)
 {
     glDisable(GL_LIGHTING);
     glDisable(GL_LIGHT0);
@@ -200,44 +209,69 @@ inline void draw_streamline(const StreamLine* sl, const double min, const double
     glLineWidth(4);
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
-    glBegin(GL_LINE_STRIP);
+    glBegin(core->is_closed ? GL_LINE_LOOP : GL_LINE_STRIP);
 
     const double dmag = max - min;
-
-    long int i;
-    // draw back_ward vertices in reverse order
-    for(i = sl->num_bw_verts() - 1; i >= 0; i--){
-        Vertex* vert = sl->bw_verts[i];
+    for(const Vertex* vert : core->verts){
         const Vector3d& p = vert->cords;
-        const Vector3d& vel = vert->vels.begin()->second;
-        const double vel_mag = length(vel);
+        const double vel_mag = length(vert->vels.begin()->second);
         const Vector3d color = CT.lookUp((vel_mag - min) / dmag);
         glColor3f(color.x(), color.y(), color.z());
-//        glColor3f(0, 0, 1);
         glVertex3f(p.x(), p.y(), p.z());
     }
+    glEnd();
 
-    {
-        // draw seed
-        const Vertex* seed = sl->seed;
-        const Vector3d seed_cord = seed->cords;
-        const double vel_mag = length(seed->vels.begin()->second);
-        const Vector3d color = CT.lookUp((vel_mag - min) / dmag);
-        glColor3f(color.x(), color.y(), color.z());
-//         glColor3f(0, 0, 1);
-        glVertex3f(seed_cord.x(), seed_cord.y(), seed_cord.z());
-    }
+    glPopMatrix();
+}
 
-    // draw fw vertices in order
-    for(i = 0; i < sl->num_fw_verts() ; i++){
-        Vertex* vert = sl->fw_verts[i];
-        const Vector3d& p = vert->cords;
-        const Vector3d& vel = vert->vels.begin()->second;
-        const double vel_mag = length(vel);
-        const Vector3d color = CT.lookUp((vel_mag - min) / dmag);
+
+// one point per particle colored by speed, straight from the front frame of the cloud
+// the arrays are copied by glDrawArrays, so the frame is only locked while drawing
+inline void draw_particle_cloud(ParticleCloud* cloud)
+{
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+
+    glPointSize(1.5);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    const CloudFrame* frame = cloud->lock_front();
+    glVertexPointer(3, GL_FLOAT, 0, frame->pts.data());
+    glColorPointer(3, GL_UNSIGNED_BYTE, 0, frame->colors.data());
+    glDrawArrays(GL_POINTS, 0, frame->num_particles());
+    cloud->unlock_front();
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glPopMatrix();
+}
+
+
+// only the points of the level of detail that keeps the line within lod_pixel_error on screen are sent,
+// pixels_per_unit of 0 draws every point
+inline void draw_streamline(StreamLine* sl, const double min, const double max, const double pixels_per_unit = 0.)
+{
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+
+    glLineWidth(4);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glBegin(GL_LINE_STRIP);
+
+    const double dmag = max - min;
+
+    // backward vertices in reverse order, the seed, then forward vertices in order
+    const StreamLineLOD* lod = sl->get_lod();
+    const UI level = pixels_per_unit > 0. ? lod->pick_level(pixels_per_unit) : 0;
+    for(const UI i : lod->levels[level]){
+        const float* p = lod->pts.data() + 3*i;
+        const Vector3d color = CT.lookUp((lod->speeds[i] - min) / dmag);
         glColor3f(color.x(), color.y(), color.z());
-//        glColor3f(0, 0, 1);
-        glVertex3f(p.x(), p.y(), p.z());
+        glVertex3f(p[0], p[1], p[2]);
     }
     glEnd();
 
@@ -246,7 +280,6 @@ inline void draw_streamline(const StreamLine* sl, const double min, const double
         glBegin(GL_POINTS);
         glColor3f(1, 1, 1);
         const Vertex* seed = sl->seed;
-        const Vector3d seed_cord = seed->cords;
         glVertex3f(seed->x(), seed->y(), seed->z());
         glEnd();
     }
@@ -257,10 +290,8 @@ inline void draw_streamline(const StreamLine* sl, const double min, const double
 inline void draw_arrows( PathLine* pl )
 {
     glColor3f(arrow_color[0], arrow_color[1], arrow_color[2]);
-    for(const Vertex* v : pl->verts){
-        const Vector3d& p = v->cords;
-        const Vector3d& vel = v->vels.begin()->second;
-        draw_arrow(p, vel);
+    for(UL i = 1; i < pl->num_verts(); i++){
+        draw_arrow(pl->pts[i], pl->pts[i] - pl->pts[i-1]);
     }
 }
 
@@ -317,28 +348,36 @@ inline void draw_isosurfaces(const Isosurface* isosurface, const double min, con
 }
 
 
-inline void decide_color(unsigned short type){
+// color of a singularity by its type, shared with Others/Renderer
+inline void singularity_color(const unsigned short type, float rgb[3]){
+    rgb[0] = rgb[1] = rgb[2] = 0.; // weird criticle points
     switch(type){
     case 1: // source node
     case 5: // repelling focus source
-        glColor3f(1, 0, 0); // source-like red
+        rgb[0] = 1.; // source-like red
         break;
     case 2: // sink node
     case 6: // repelling saddle focus
-        glColor3f(0, 0, 1); // sink-like blue
+        rgb[2] = 1.; // sink-like blue
         break;
     case 3:
     case 4:
     case 7:
     case 8:
-        glColor3f(1, 1, 0); // saddle-like
+        rgb[0] = rgb[1] = 1.; // saddle-like
         break;
     default:
-        glColor3f(0, 0, 0); // weird criticle points
         break;
     }
 }
 
+
+inline void decide_color(unsigned short type){
+    float rgb[3];
+    singularity_color(type, rgb);
+    glColor3f(rgb[0], rgb[1], rgb[2]);
+}
+
 inline void draw_singularities(const vector<Singularity*> fixed_pts)
 {
     glDisable(GL_LIGHTING);
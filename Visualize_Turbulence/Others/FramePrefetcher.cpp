@@ -0,0 +1,208 @@
+#include "Others/FramePrefetcher.h"
+#include "Others/Utilities.h"
+#include "Geometry/Mesh.h"
+#include "FileLoader/FrameCache.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+
+
+FramePrefetcher::FramePrefetcher()
+{
+    this->stopping = false;
+    this->mesh = NULL;
+    this->window_mesh = NULL;
+    this->focus = 0.;
+    this->interval = 0.;
+    this->generation = 0;
+    this->counters.frames_shown = 0;
+    this->counters.stalls = 0;
+    this->counters.stall_secs = 0.;
+    this->counters.frames_loaded = 0;
+    this->counters.load_secs = 0.;
+    this->counters.depth = 1;
+}
+
+
+FramePrefetcher::~FramePrefetcher()
+{
+    this->stop();
+}
+
+
+void FramePrefetcher::start()
+{
+    if(this->loader.joinable()) return;
+    this->stopping = false;
+    this->loader = thread(&FramePrefetcher::run, this);
+}
+
+
+// the frame being read is finished first, then every frame is unpinned
+void FramePrefetcher::stop()
+{
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    this->ready.notify_all();
+    if(this->loader.joinable()) this->loader.join();
+    this->window.clear();
+}
+
+
+// the animation stepped to time of mesh, frame_interval secs after the last frame
+// returns once the frame is loaded, the time it waits for that is counted as a stall
+void FramePrefetcher::playing(Mesh* mesh, const double time, const double frame_interval)
+{
+    if(!mesh->field_store.is_paged() || !mesh->field_store.has_frame(time)) return;
+
+    unique_lock<mutex> guard(this->lock);
+    this->mesh = mesh;
+    this->focus = time;
+    this->interval = frame_interval;
+    this->generation++;
+    this->counters.frames_shown++;
+    this->wake.notify_all();
+    if(!this->loader.joinable() || this->window.find(time) != this->window.end()) return;
+
+    // a frame loaded some other way, e.g. by the background analysis, needs no waiting either
+    guard.unlock();
+    const bool loaded = mesh->field_store.is_loaded(time);
+    guard.lock();
+    if(!loaded){
+        this->counters.stalls++;
+        QElapsedTimer timer;
+        timer.start();
+        const UL generation = this->generation;
+        this->ready.wait(guard, [&](){
+            return this->stopping || this->generation != generation || this->window.find(time) != this->window.end();
+        });
+        this->counters.stall_secs += timer.nsecsElapsed() / 1e9;
+    }
+
+    if(this->counters.frames_shown % 100 == 0) this->log();
+}
+
+
+// the animation stopped, the frames are unpinned and stay loaded until the budget of the store needs their memory
+void FramePrefetcher::pause()
+{
+    lock_guard<mutex> guard(this->lock);
+    this->mesh = NULL;
+    this->generation++;
+    this->wake.notify_all();
+    if(this->counters.frames_shown > 0) this->log();
+}
+
+
+PrefetchStats FramePrefetcher::stats() const
+{
+    lock_guard<mutex> guard(this->lock);
+    return this->counters;
+}
+
+
+// frames to keep loaded after the one on screen, call it with lock held
+UL FramePrefetcher::depth_of(const Mesh* mesh) const
+{
+    UL depth = 1;
+    if(this->interval > 0.) depth = (UL) ceil(this->counters.load_secs / this->interval) + 1;
+
+    // every frame of the window pins itself and the raw frames it lies between, those are shared by its neighbours
+    const double frame_bytes = mesh->field_store.cache->frame_bytes();
+    const double fit = (field_memory_budget / 2. / frame_bytes - 2.) / (1. + time_step_size) - 1.;
+    return min(depth, min((UL) playback_prefetch_frames, (UL) max(1., fit)));
+}
+
+
+// the frame on screen and the next depth ones in the order they are shown, call it with lock held
+vector<double> FramePrefetcher::window_times() const
+{
+    vector<double> times;
+    if(this->mesh == NULL) return times;
+    const FieldStore& store = this->mesh->field_store;
+    double time = this->focus;
+    for(UL i = 0; i <= this->counters.depth; i++){
+        if(store.has_frame(time)) times.push_back(time);
+        // the animation starts over at the last frame, see MainWindow::increment_time()
+        time += time_step_size;
+        if(time >= this->mesh->num_time_steps - 1.) time = 0.;
+    }
+    return times;
+}
+
+
+// call it with lock held
+void FramePrefetcher::log() const
+{
+    const PrefetchStats& c = this->counters;
+    qDebug() << "Frame prefetch:" << c.stalls << "stalls in" << c.frames_shown << "frames," << c.stall_secs
+             << "secs waited. depth" << c.depth << "," << c.load_secs << "secs to read a frame," << this->interval
+             << "secs between frames";
+}
+
+
+void FramePrefetcher::run()
+{
+    unique_lock<mutex> guard(this->lock);
+    while(!this->stopping){
+        if(this->mesh != NULL) this->counters.depth = this->depth_of(this->mesh);
+        const vector<double> times = this->window_times();
+
+        // unpin the frames left behind first, without the lock since unpinning takes the lock of the store
+        vector<FrameHandle> behind;
+        for(auto it = this->window.begin(); it != this->window.end(); ){
+            if(this->window_mesh != this->mesh || find(times.begin(), times.end(), it->first) == times.end()){
+                behind.push_back(move(it->second));
+                it = this->window.erase(it);
+            }
+            else it++;
+        }
+        if(!behind.empty()){
+            guard.unlock();
+            behind.clear();
+            guard.lock();
+            continue;
+        }
+        this->window_mesh = this->mesh;
+
+        // the first frame of the window that isn't pinned yet
+        auto next = find_if(times.begin(), times.end(), [this](const double t){
+            return this->window.find(t) == this->window.end();
+        });
+        if(next == times.end()){
+            const UL generation = this->generation;
+            this->wake.wait(guard, [&](){ return this->stopping || this->generation != generation; });
+            continue;
+        }
+
+        Mesh* mesh = this->mesh;
+        const double time = *next;
+        guard.unlock();
+        QElapsedTimer timer;
+        timer.start();
+        const bool was_loaded = mesh->field_store.is_loaded(time);
+        FrameHandle handle = mesh->field_store.pin(mesh, time);
+        const double secs = timer.nsecsElapsed() / 1e9;
+        guard.lock();
+
+        if(!was_loaded){
+            // mean of the last few reads, so depth follows a disk that gets slower or faster
+            PrefetchStats& c = this->counters;
+            c.load_secs = c.frames_loaded == 0 ? secs : 0.8 * c.load_secs + 0.2 * secs;
+            c.frames_loaded++;
+        }
+        if(mesh == this->mesh){
+            this->window[time] = move(handle);
+            this->ready.notify_all();
+        }
+        else{
+            // paused or switched to another mesh while it was read
+            guard.unlock();
+            handle.release();
+            guard.lock();
+        }
+    }
+}
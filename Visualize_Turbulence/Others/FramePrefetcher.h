@@ -0,0 +1,66 @@
+#ifndef FRAMEPREFETCHER_H
+#define FRAMEPREFETCHER_H
+
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Analysis/FieldStore.h"
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+
+// how playback of paged field data went so far
+struct PrefetchStats{
+    UL frames_shown;    // frames the animation stepped to
+    UL stalls;          // of them, the ones that weren't loaded yet when it got there
+    double stall_secs;  // time the animation waited for them
+    UL frames_loaded;   // frames read by the prefetcher
+    double load_secs;   // mean time it took to read one
+    UL depth;           // frames kept loaded after the one on screen
+};
+
+
+// reads the field frames of a paged mesh the animation is about to show on an I/O thread, so the timer doesn't
+// wait for the disk. playing() is called on the GUI thread for every frame the animation steps to, the thread then
+// pins that frame and the next depth ones in the order the animation shows them and unpins those left behind.
+// depth is the number of frames it takes to read one at the measured load time and the interval of the timer,
+// plus one, at most playback_prefetch_frames and what fits into half of field_memory_budget.
+// a frame that isn't loaded when the animation gets there is a stall, playing() waits until the thread has it.
+// meshes whose field data isn't paged are ignored
+class FramePrefetcher{
+public:
+    FramePrefetcher();
+    ~FramePrefetcher(); // waits for the frame being read and unpins everything
+
+    void start();
+    void stop();
+    void playing(Mesh* mesh, const double time, const double frame_interval);
+    void pause();
+    PrefetchStats stats() const;
+
+private:
+    thread loader;
+    mutable mutex lock;
+    condition_variable wake;    // a new frame is on screen or stop() was called
+    condition_variable ready;   // a frame was pinned
+    bool stopping;
+
+    // guarded by lock
+    Mesh* mesh;                 // NULL while paused
+    double focus;               // the frame on screen
+    double interval;            // secs between two frames of the animation
+    UL generation;              // counts the calls of playing() and pause()
+    map<double, FrameHandle> window; // the pinned frames of window_mesh
+    Mesh* window_mesh;
+    PrefetchStats counters;
+
+    UL depth_of(const Mesh* mesh) const;
+    vector<double> window_times() const;
+    void log() const;
+    void run();
+};
+
+#endif // FRAMEPREFETCHER_H
@@ -0,0 +1,53 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+namespace Utility
+{
+    inline UI num_threads();
+    template<class Func>
+    inline void parallel_for(const UL begin, const UL end, Func func, const UL min_chunk_size = 1024);
+}
+
+
+// number of worker threads used by the parallel loops
+inline UI Utility::num_threads()
+{
+    const UI n = thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+
+// split [begin, end) into contiguous chunks, one per thread, and call func(chunk_begin, chunk_end) on each
+// small ranges run on the calling thread. func must only write to data owned by its own chunk.
+template<class Func>
+inline void Utility::parallel_for(const UL begin, const UL end, Func func, const UL min_chunk_size)
+{
+    if(end <= begin) return;
+    const UL size = end - begin;
+    UL num_chunks = Utility::num_threads();
+    if(size / num_chunks < min_chunk_size) num_chunks = size / min_chunk_size;
+    if(num_chunks <= 1){
+        func(begin, end);
+        return;
+    }
+
+    const UL chunk_size = (size + num_chunks - 1) / num_chunks;
+    vector<thread> workers;
+    workers.reserve(num_chunks - 1);
+    for(UL c = 1; c < num_chunks; c++){
+        const UL b = begin + c * chunk_size;
+        if(b >= end) break;
+        const UL e = b + chunk_size < end ? b + chunk_size : end;
+        workers.emplace_back(func, b, e);
+    }
+    func(begin, begin + chunk_size); // the calling thread does the first chunk
+    for(thread& t : workers) t.join();
+}
+
+#endif // PARALLEL_H
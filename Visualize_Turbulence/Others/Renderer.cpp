@@ -0,0 +1,821 @@
+#include "Others/Renderer.h"
+#include "Others/Draw.h"
+#include "Geometry/Mesh.h"
+#include "Lines/StreamLineLOD.h"
+#include "Surfaces/Isosurface.h"
+#include <cfloat>
+#include <unordered_set>
+
+// the colormap and color programs pass the attribute through, the surface program turns it into an eye space normal
+static const char* vertex_shader =
+    "#version 120\n"
+    "attribute vec3 a_pos;\n"
+    "attribute vec3 a_attr;\n"
+    "varying vec3 v_attr;\n"
+    "void main()\n"
+    "{\n"
+    "    v_attr = a_attr;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(a_pos, 1.0);\n"
+    "}\n";
+
+static const char* surface_vertex_shader =
+    "#version 120\n"
+    "attribute vec3 a_pos;\n"
+    "attribute vec3 a_attr;\n"
+    "varying vec3 v_attr;\n"
+    "void main()\n"
+    "{\n"
+    "    v_attr = gl_NormalMatrix * a_attr;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(a_pos, 1.0);\n"
+    "}\n";
+
+// the color map has 256 texels, s is mapped onto the texel centers
+static const char* colormap_fragment_shader =
+    "#version 120\n"
+    "uniform sampler2D u_colormap;\n"
+    "uniform float u_min;\n"
+    "uniform float u_range;\n"
+    "uniform float u_time;\n"
+    "varying vec3 v_attr;\n"
+    "void main()\n"
+    "{\n"
+    "    if(v_attr.y > u_time) discard;\n"
+    "    float s = clamp((v_attr.x - u_min) / u_range, 0.0, 1.0);\n"
+    "    gl_FragColor = vec4(texture2D(u_colormap, vec2((s * 255.0 + 0.5) / 256.0, 0.5)).rgb, 1.0);\n"
+    "}\n";
+
+// two sided head light
+static const char* surface_fragment_shader =
+    "#version 120\n"
+    "uniform vec4 u_color;\n"
+    "uniform float u_lighting;\n"
+    "varying vec3 v_attr;\n"
+    "void main()\n"
+    "{\n"
+    "    float shade = 1.0;\n"
+    "    if(u_lighting > 0.5) shade = 0.3 + 0.7 * abs(normalize(v_attr).z);\n"
+    "    gl_FragColor = vec4(u_color.rgb * shade, u_color.a);\n"
+    "}\n";
+
+static const char* color_fragment_shader =
+    "#version 120\n"
+    "varying vec3 v_attr;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4(v_attr, 1.0);\n"
+    "}\n";
+
+static const UI colormap_size = 256;
+
+// passed as the cut off time of layers that aren't cut
+static const double no_time_cut = 1e30;
+
+
+GLLayer::GLLayer()
+{
+    this->vbo = this->ibo = 0;
+    this->vao = NULL;
+    this->mode = GL_LINES;
+    this->num_indices = 0;
+    this->uploaded = false;
+}
+
+
+FrameLayers::FrameLayers()
+{
+    this->min_speed = this->max_speed = 0.;
+    this->has_speed_range = false;
+    this->streamline_ppu = -1.;
+    this->isosurface_serial = 0;
+}
+
+
+MeshLayers::MeshLayers()
+{
+    this->num_pathlines = 0;
+}
+
+
+Renderer::Renderer()
+{
+    this->ready = false;
+    for(UI i = 0; i < NUM_PROGRAMS; i++) this->programs[i] = 0;
+    this->uniform_min = this->uniform_range = this->uniform_time = this->uniform_colormap = -1;
+    this->uniform_color = this->uniform_lighting = -1;
+    this->colormap_tex = 0;
+}
+
+
+// the GL context has to be current
+Renderer::~Renderer()
+{
+    for(auto& pair : this->meshes){
+        this->release(pair.second);
+        delete pair.second;
+    }
+    this->meshes.clear();
+    if(!this->ready) return;
+
+    for(UI i = 0; i < NUM_PROGRAMS; i++) glDeleteProgram(this->programs[i]);
+    glDeleteTextures(1, &this->colormap_tex);
+}
+
+
+// call from initializeGL
+void Renderer::init()
+{
+    this->initializeOpenGLFunctions();
+    for(UI i = 0; i < NUM_PROGRAMS; i++){
+        this->programs[i] = this->compile_program((RenderProgram) i);
+        if(this->programs[i] == 0){
+            qDebug() << "Renderer: shaders are not supported, drawing in immediate mode";
+            return;
+        }
+    }
+
+    const GLuint colormap = this->programs[PROGRAM_COLORMAP];
+    this->uniform_min = glGetUniformLocation(colormap, "u_min");
+    this->uniform_range = glGetUniformLocation(colormap, "u_range");
+    this->uniform_time = glGetUniformLocation(colormap, "u_time");
+    this->uniform_colormap = glGetUniformLocation(colormap, "u_colormap");
+    this->uniform_color = glGetUniformLocation(this->programs[PROGRAM_SURFACE], "u_color");
+    this->uniform_lighting = glGetUniformLocation(this->programs[PROGRAM_SURFACE], "u_lighting");
+
+    this->build_colormap();
+    this->ready = true;
+}
+
+
+// 0 if the program doesn't compile or link, the log is printed
+GLuint Renderer::compile_program(const RenderProgram program)
+{
+    const char* sources[2] = {vertex_shader, NULL};
+    if(program == PROGRAM_COLORMAP) sources[1] = colormap_fragment_shader;
+    else if(program == PROGRAM_SURFACE){
+        sources[0] = surface_vertex_shader;
+        sources[1] = surface_fragment_shader;
+    }
+    else sources[1] = color_fragment_shader;
+
+    const GLuint prog = glCreateProgram();
+    for(unsigned char i = 0; i < 2; i++){
+        const GLuint shader = glCreateShader(i == 0 ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER);
+        glShaderSource(shader, 1, &sources[i], NULL);
+        glCompileShader(shader);
+        GLint ok = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if(!ok){
+            char log[1024];
+            glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+            qDebug() << "Renderer: shader" << (int) program << "doesn't compile:" << log;
+            glDeleteShader(shader);
+            glDeleteProgram(prog);
+            return 0;
+        }
+        glAttachShader(prog, shader);
+        glDeleteShader(shader); // freed with the program
+    }
+    glBindAttribLocation(prog, 0, "a_pos");
+    glBindAttribLocation(prog, 1, "a_attr");
+    glLinkProgram(prog);
+
+    GLint ok = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if(!ok){
+        char log[1024];
+        glGetProgramInfoLog(prog, sizeof(log), NULL, log);
+        qDebug() << "Renderer: program" << (int) program << "doesn't link:" << log;
+        glDeleteProgram(prog);
+        return 0;
+    }
+    return prog;
+}
+
+
+// sample CT once into a 256 x 1 texture, a 2D texture so it also works where 1D textures don't exist
+void Renderer::build_colormap()
+{
+    vector<unsigned char> texels(3 * colormap_size);
+    for(UI i = 0; i < colormap_size; i++){
+        const Vector3d color = CT.lookUp((double) i / (colormap_size - 1));
+        for(unsigned char d = 0; d < 3; d++){
+            const double c = color.entry[d] < 0. ? 0. : (color.entry[d] > 1. ? 1. : color.entry[d]);
+            texels[3*i + d] = (unsigned char) (c * 255. + 0.5);
+        }
+    }
+
+    glGenTextures(1, &this->colormap_tex);
+    glBindTexture(GL_TEXTURE_2D, this->colormap_tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, colormap_size, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+MeshLayers* Renderer::layers_of(Mesh* mesh)
+{
+    auto it = this->meshes.find(mesh);
+    if(it != this->meshes.end()) return it->second;
+    MeshLayers* layers = new MeshLayers();
+    this->meshes[mesh] = layers;
+    return layers;
+}
+
+
+FrameLayers* Renderer::layers_of(Mesh* mesh, const double time)
+{
+    MeshLayers* layers = this->layers_of(mesh);
+    auto it = layers->frames.find(time);
+    if(it != layers->frames.end()) return it->second;
+    FrameLayers* frame = new FrameLayers();
+    layers->frames[time] = frame;
+    return frame;
+}
+
+
+// the products of a frame were deleted, its layers are dropped the next time the view draws
+// may be called without a current context, a later product at the same address is never drawn from old buffers
+void Renderer::forget(Mesh* mesh, const double time)
+{
+    this->forgotten.push_back({mesh, time});
+}
+
+
+// the GL context has to be current
+void Renderer::release_forgotten()
+{
+    for(const auto& pair : this->forgotten){
+        auto layers = this->meshes.find(pair.first);
+        if(layers == this->meshes.end()) continue;
+        auto it = layers->second->frames.find(pair.second);
+        if(it == layers->second->frames.end()) continue;
+        this->release(it->second);
+        delete it->second;
+        layers->second->frames.erase(it);
+    }
+    this->forgotten.clear();
+}
+
+
+// the speed range of the frame is looked up once instead of on every redraw
+void Renderer::speed_range(Mesh* mesh, const double time, FrameLayers* frame)
+{
+    if(frame->has_speed_range) return;
+    double max = DBL_MIN, min = DBL_MAX;
+    mesh->max_vel_mag(time, min, max);
+    frame->min_speed = min;
+    frame->max_speed = max;
+    frame->has_speed_range = true;
+}
+
+
+void Renderer::upload(GLLayer& layer, const GLenum mode, const vector<LayerVertex>& verts, const vector<UI>& indices)
+{
+    if(layer.vbo == 0){
+        glGenBuffers(1, &layer.vbo);
+        glGenBuffers(1, &layer.ibo);
+
+        layer.vao = new QOpenGLVertexArrayObject();
+        if(layer.vao->create()){
+            layer.vao->bind();
+            glBindBuffer(GL_ARRAY_BUFFER, layer.vbo);
+            this->bind_attributes();
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, layer.ibo);
+            layer.vao->release();
+        }
+        else{
+            delete layer.vao;
+            layer.vao = NULL;
+        }
+    }
+    layer.mode = mode;
+    glBindBuffer(GL_ARRAY_BUFFER, layer.vbo);
+    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(LayerVertex), verts.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    this->upload_indices(layer, indices);
+    layer.uploaded = true;
+}
+
+
+void Renderer::upload_indices(GLLayer& layer, const vector<UI>& indices)
+{
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, layer.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(UI), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    layer.num_indices = indices.size();
+}
+
+
+// attribute pointers into the vertex buffer bound to GL_ARRAY_BUFFER
+void Renderer::bind_attributes()
+{
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LayerVertex), (const void*) 0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(LayerVertex), (const void*) (3 * sizeof(float)));
+}
+
+
+void Renderer::release(GLLayer& layer)
+{
+    if(layer.vbo == 0) return;
+    if(layer.vao != NULL){
+        layer.vao->destroy();
+        delete layer.vao;
+        layer.vao = NULL;
+    }
+    glDeleteBuffers(1, &layer.vbo);
+    glDeleteBuffers(1, &layer.ibo);
+    layer.vbo = layer.ibo = 0;
+    layer.num_indices = 0;
+    layer.uploaded = false;
+}
+
+
+void Renderer::release(MeshLayers* layers)
+{
+    this->release(layers->boundary_tris);
+    this->release(layers->wireframe);
+    this->release(layers->pathlines);
+    for(auto& pair : layers->frames){
+        this->release(pair.second);
+        delete pair.second;
+    }
+    layers->frames.clear();
+}
+
+
+void Renderer::release(FrameLayers* frame)
+{
+    GLLayer* all[] = {&frame->streamlines, &frame->seeds, &frame->vortex_cores, &frame->isosurface,
+                      &frame->tets_with_fixed_pts, &frame->singularities, &frame->ecg_constructions,
+                      &frame->ecg_construction_seeds, &frame->ecg_connections, &frame->ecg_connection_seeds};
+    for(GLLayer* layer : all) this->release(*layer);
+}
+
+
+// the one draw call of a layer, with whatever program is in use
+void Renderer::draw(GLLayer& layer)
+{
+    if(layer.is_empty()) return;
+    if(layer.vao != NULL){
+        layer.vao->bind();
+        glDrawElements(layer.mode, layer.num_indices, GL_UNSIGNED_INT, (const void*) 0);
+        layer.vao->release();
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, layer.vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, layer.ibo);
+    this->bind_attributes();
+    glDrawElements(layer.mode, layer.num_indices, GL_UNSIGNED_INT, (const void*) 0);
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+// a zero range maps everything below min to the first color and the rest to the last, like CT.lookUp did
+void Renderer::use_colormap(const double min, const double max, const double time)
+{
+    const double range = max - min;
+    glUseProgram(this->programs[PROGRAM_COLORMAP]);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, this->colormap_tex);
+    glUniform1i(this->uniform_colormap, 0);
+    glUniform1f(this->uniform_min, min);
+    glUniform1f(this->uniform_range, range != 0. ? range : FLT_MIN);
+    glUniform1f(this->uniform_time, time);
+}
+
+
+void Renderer::use_surface(const float r, const float g, const float b, const float a, const bool lighting)
+{
+    glUseProgram(this->programs[PROGRAM_SURFACE]);
+    glUniform4f(this->uniform_color, r, g, b, a);
+    glUniform1f(this->uniform_lighting, lighting ? 1.f : 0.f);
+}
+
+
+void Renderer::use_color()
+{
+    glUseProgram(this->programs[PROGRAM_COLOR]);
+}
+
+
+void Renderer::unuse()
+{
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
+
+
+// every traced point of every line goes into the vertex buffer once, the level of detail only changes the indices
+void Renderer::draw_streamlines(Mesh* mesh, const double time, const double pixels_per_unit)
+{
+    if(mesh->streamlines_for_all_t.find(time) == mesh->streamlines_for_all_t.end()) return;
+    const vector<StreamLine*>& sls = mesh->streamlines_for_all_t.at(time);
+    FrameLayers* frame = this->layers_of(mesh, time);
+    this->speed_range(mesh, time, frame);
+
+    if(!this->ready){
+        for(StreamLine* sl : sls) draw_streamline(sl, frame->min_speed, frame->max_speed, pixels_per_unit);
+        return;
+    }
+
+    if(!frame->streamlines.uploaded || frame->streamline_srcs != sls){
+        vector<LayerVertex> verts, seed_verts;
+        frame->streamline_srcs = sls;
+        frame->streamline_bases.clear();
+        for(StreamLine* sl : sls){
+            const StreamLineLOD* lod = sl->get_lod();
+            frame->streamline_bases.push_back(verts.size());
+            for(UL i = 0; i < lod->num_pts(); i++){
+                const float* p = lod->pts.data() + 3*i;
+                verts.push_back({p[0], p[1], p[2], lod->speeds[i], 0.f, 0.f});
+            }
+            const Vertex* seed = sl->seed;
+            seed_verts.push_back({(float) seed->x(), (float) seed->y(), (float) seed->z(), 1.f, 1.f, 1.f});
+        }
+        vector<UI> seed_indices(seed_verts.size());
+        for(UI i = 0; i < seed_indices.size(); i++) seed_indices[i] = i;
+        this->upload(frame->streamlines, GL_LINES, verts, vector<UI>());
+        this->upload(frame->seeds, GL_POINTS, seed_verts, seed_indices);
+        frame->streamline_ppu = -1.;
+    }
+    if(frame->streamline_ppu != pixels_per_unit) this->build_streamline_indices(frame, pixels_per_unit);
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+    glLineWidth(4);
+    this->use_colormap(frame->min_speed, frame->max_speed, no_time_cut);
+    this->draw(frame->streamlines);
+    if(show_seeds){
+        glPointSize(15);
+        this->use_color();
+        this->draw(frame->seeds);
+    }
+    this->unuse();
+}
+
+
+// segments between the consecutive points of the level each line picks at this zoom
+void Renderer::build_streamline_indices(FrameLayers* frame, const double pixels_per_unit)
+{
+    vector<UI> indices;
+    for(UL j = 0; j < frame->streamline_srcs.size(); j++){
+        const StreamLineLOD* lod = frame->streamline_srcs[j]->get_lod();
+        const vector<UI>& level = lod->levels[lod->pick_level(pixels_per_unit)];
+        const UI base = frame->streamline_bases[j];
+        for(UL i = 1; i < level.size(); i++){
+            indices.push_back(base + level[i - 1]);
+            indices.push_back(base + level[i]);
+        }
+    }
+    this->upload_indices(frame->streamlines, indices);
+    frame->streamline_ppu = pixels_per_unit;
+}
+
+
+// every point of sls as line segments, and their seeds as white points
+void Renderer::build_line_layers(GLLayer& lines, GLLayer& seeds, const vector<StreamLine*>& sls)
+{
+    vector<LayerVertex> verts, seed_verts;
+    vector<UI> indices, seed_indices;
+    for(StreamLine* sl : sls){
+        const StreamLineLOD* lod = sl->get_lod();
+        const UI base = verts.size();
+        for(UL i = 0; i < lod->num_pts(); i++){
+            const float* p = lod->pts.data() + 3*i;
+            verts.push_back({p[0], p[1], p[2], lod->speeds[i], 0.f, 0.f});
+            if(i == 0) continue;
+            indices.push_back(base + i - 1);
+            indices.push_back(base + i);
+        }
+        const Vertex* seed = sl->seed;
+        seed_indices.push_back(seed_verts.size());
+        seed_verts.push_back({(float) seed->x(), (float) seed->y(), (float) seed->z(), 1.f, 1.f, 1.f});
+    }
+    this->upload(lines, GL_LINES, verts, indices);
+    this->upload(seeds, GL_POINTS, seed_verts, seed_indices);
+}
+
+
+// all points of every pathline are uploaded once, the shader cuts each line at the current time
+void Renderer::draw_pathlines(Mesh* mesh, const double time)
+{
+    FrameLayers* frame = this->layers_of(mesh, time);
+    this->speed_range(mesh, time, frame);
+
+    if(!this->ready){
+        for(const PathLine* pl : mesh->pathlines) ::draw_pathlines(pl, time, frame->min_speed, frame->max_speed);
+        return;
+    }
+
+    MeshLayers* layers = this->layers_of(mesh);
+    if(!layers->pathlines.uploaded || layers->num_pathlines != mesh->pathlines.size()){
+        vector<LayerVertex> verts;
+        vector<UI> indices;
+        for(const PathLine* pl : mesh->pathlines){
+            const UI base = verts.size();
+            for(UL i = 0; i < pl->num_verts(); i++){
+                const Vector3d& p = pl->pts[i];
+                verts.push_back({(float) p.x(), (float) p.y(), (float) p.z(), (float) pl->speeds[i], (float) pl->times[i], 0.f});
+                if(i == 0) continue;
+                indices.push_back(base + i - 1);
+                indices.push_back(base + i);
+            }
+        }
+        this->upload(layers->pathlines, GL_LINES, verts, indices);
+        layers->num_pathlines = mesh->pathlines.size();
+    }
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+    glLineWidth(4);
+    this->use_colormap(frame->min_speed, frame->max_speed, time);
+    this->draw(layers->pathlines);
+    this->unuse();
+}
+
+
+void Renderer::draw_vortex_cores(Mesh* mesh, const double time)
+{
+    FrameLayers* frame = this->layers_of(mesh, time);
+    this->speed_range(mesh, time, frame);
+    const vector<VortexCore*>& cores = get_vortex_cores(mesh, time);
+
+    if(!this->ready){
+        for(const VortexCore* core : cores) draw_vortex_core(core, frame->min_speed, frame->max_speed);
+        return;
+    }
+
+    if(!frame->vortex_cores.uploaded){
+        vector<LayerVertex> verts;
+        vector<UI> indices;
+        for(const VortexCore* core : cores){
+            const UI base = verts.size();
+            for(UL i = 0; i < core->verts.size(); i++){
+                const Vertex* vert = core->verts[i];
+                verts.push_back({(float) vert->x(), (float) vert->y(), (float) vert->z(),
+                                 (float) length(vert->vels.begin()->second), 0.f, 0.f});
+                if(i == 0) continue;
+                indices.push_back(base + i - 1);
+                indices.push_back(base + i);
+            }
+            if(core->is_closed && core->verts.size() > 2){
+                indices.push_back(verts.size() - 1);
+                indices.push_back(base);
+            }
+        }
+        this->upload(frame->vortex_cores, GL_LINES, verts, indices);
+    }
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+    glLineWidth(4);
+    this->use_colormap(frame->min_speed, frame->max_speed, no_time_cut);
+    this->draw(frame->vortex_cores);
+    this->unuse();
+}
+
+
+// flat shaded triangles, 3 vertices each with the face normal
+static void add_flat_tri(Triangle* tri, vector<LayerVertex>& verts, vector<UI>& indices)
+{
+    const Vector3d normal = tri->cal_normal();
+    for(unsigned char k = 0; k < 3; k++){
+        const Vector3d& p = tri->verts[k]->cords;
+        indices.push_back(verts.size());
+        verts.push_back({(float) p.x(), (float) p.y(), (float) p.z(),
+                         (float) normal.x(), (float) normal.y(), (float) normal.z()});
+    }
+}
+
+
+// uploaded again whenever update_isosurface has extracted a new surface
+void Renderer::draw_isosurface(Mesh* mesh, const double time, const Isosurface* isosurface)
+{
+    if(!this->ready){
+        double max = DBL_MIN, min = DBL_MAX;
+        draw_isosurfaces(isosurface, min, max);
+        return;
+    }
+    if(isosurface == NULL) return;
+
+    FrameLayers* frame = this->layers_of(mesh, time);
+    if(!frame->isosurface.uploaded || frame->isosurface_serial != isosurface->serial){
+        vector<LayerVertex> verts;
+        vector<UI> indices;
+        verts.reserve(3 * isosurface->num_tris());
+        for(Triangle* tri : isosurface->tris) add_flat_tri(tri, verts, indices);
+        this->upload(frame->isosurface, GL_TRIANGLES, verts, indices);
+        frame->isosurface_serial = isosurface->serial;
+    }
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+    this->use_surface(1., 0., 0., 1., true);
+    this->draw(frame->isosurface);
+    this->unuse();
+}
+
+
+void Renderer::draw_tets_with_fixed_pts(Mesh* mesh, const double time)
+{
+    // the frame may still be computed in the background
+    if(mesh->tet_with_fixed_pt_for_all_t.find(time) == mesh->tet_with_fixed_pt_for_all_t.end()) return;
+    const vector<Tet*>& tets = mesh->tet_with_fixed_pt_for_all_t.at(time);
+    if(!this->ready){
+        color_tets_with_fixedPts(tets);
+        return;
+    }
+
+    FrameLayers* frame = this->layers_of(mesh, time);
+    if(!frame->tets_with_fixed_pts.uploaded){
+        vector<LayerVertex> verts;
+        vector<UI> indices;
+        for(const Tet* tet : tets){
+            for(Triangle* tri : tet->tris) add_flat_tri(tri, verts, indices);
+        }
+        this->upload(frame->tets_with_fixed_pts, GL_TRIANGLES, verts, indices);
+    }
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+    this->use_surface(0., 0., 0., 1., true);
+    this->draw(frame->tets_with_fixed_pts);
+    this->unuse();
+}
+
+
+void Renderer::draw_singularities(Mesh* mesh, const double time)
+{
+    if(mesh->ECG_for_all_t.find(time) == mesh->ECG_for_all_t.end()) return;
+    const vector<Singularity*> sings = mesh->ECG_for_all_t.at(time)->get_sings();
+    if(!this->ready){
+        ::draw_singularities(sings);
+        return;
+    }
+
+    FrameLayers* frame = this->layers_of(mesh, time);
+    if(!frame->singularities.uploaded){
+        vector<LayerVertex> verts;
+        vector<UI> indices;
+        for(const Singularity* pt : sings){
+            float rgb[3];
+            singularity_color(pt->type, rgb);
+            indices.push_back(verts.size());
+            verts.push_back({(float) pt->x(), (float) pt->y(), (float) pt->z(), rgb[0], rgb[1], rgb[2]});
+        }
+        this->upload(frame->singularities, GL_POINTS, verts, indices);
+    }
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+    glPointSize(15);
+    this->use_color();
+    this->draw(frame->singularities);
+    this->unuse();
+}
+
+
+// streamlines traced from every singularity while the ECG edges were built
+void Renderer::draw_ecg_constructions(Mesh* mesh, const double time)
+{
+    if(mesh->ECG_for_all_t.find(time) == mesh->ECG_for_all_t.end()) return;
+    const vector<StreamLine*>& sls = mesh->ECG_for_all_t.at(time)->sls;
+    if(!this->ready){
+        for(StreamLine* sl : sls) draw_streamline(sl, 1000, 1000);
+        return;
+    }
+
+    FrameLayers* frame = this->layers_of(mesh, time);
+    if(!frame->ecg_constructions.uploaded){
+        this->build_line_layers(frame->ecg_constructions, frame->ecg_construction_seeds, sls);
+    }
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+    glLineWidth(4);
+    this->use_colormap(1000, 1000, no_time_cut);
+    this->draw(frame->ecg_constructions);
+    if(show_seeds){
+        glPointSize(15);
+        this->use_color();
+        this->draw(frame->ecg_construction_seeds);
+    }
+    this->unuse();
+}
+
+
+// the streamline of every ECG edge, once per edge
+void Renderer::draw_ecg_connections(Mesh* mesh, const double time)
+{
+    if(mesh->ECG_for_all_t.find(time) == mesh->ECG_for_all_t.end()) return;
+    ECG* ecg = mesh->ECG_for_all_t.at(time);
+    if(!this->ready){
+        ::draw_ECG_connections(ecg);
+        return;
+    }
+
+    FrameLayers* frame = this->layers_of(mesh, time);
+    if(!frame->ecg_connections.uploaded){
+        vector<StreamLine*> sls;
+        for(const ECG_EDGE* edge : ecg->get_edges()) sls.push_back(edge->sl);
+        this->build_line_layers(frame->ecg_connections, frame->ecg_connection_seeds, sls);
+    }
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_LIGHT0);
+    glLineWidth(4);
+    this->use_colormap(0, 0, no_time_cut);
+    this->draw(frame->ecg_connections);
+    if(show_seeds){
+        glPointSize(15);
+        this->use_color();
+        this->draw(frame->ecg_connection_seeds);
+    }
+    this->unuse();
+}
+
+
+// boundary vertices are shared by the triangles, key of a vertex pointer in the vertex buffer
+static UI boundary_vert(const Vertex* vert, unordered_map<const Vertex*, UI>& idx_of, vector<LayerVertex>& verts)
+{
+    auto it = idx_of.find(vert);
+    if(it != idx_of.end()) return it->second;
+    const UI idx = verts.size();
+    idx_of[vert] = idx;
+    verts.push_back({(float) vert->x(), (float) vert->y(), (float) vert->z(), 0.f, 0.f, 0.f});
+    return idx;
+}
+
+
+// each edge shared by two boundary triangles is drawn once
+void Renderer::draw_wireframe(Mesh* mesh)
+{
+    if(!this->ready){
+        ::draw_wireframe(mesh->boundary_tris);
+        return;
+    }
+
+    MeshLayers* layers = this->layers_of(mesh);
+    if(!layers->wireframe.uploaded){
+        vector<LayerVertex> verts;
+        vector<UI> indices;
+        unordered_map<const Vertex*, UI> idx_of;
+        unordered_set<unsigned long long> edges;
+        for(const Triangle* tri : mesh->boundary_tris){
+            UI idx[3];
+            for(unsigned char k = 0; k < 3; k++) idx[k] = boundary_vert(tri->verts[k], idx_of, verts);
+            for(unsigned char k = 0; k < 3; k++){
+                const UI a = idx[k] < idx[(k + 1) % 3] ? idx[k] : idx[(k + 1) % 3];
+                const UI b = idx[k] < idx[(k + 1) % 3] ? idx[(k + 1) % 3] : idx[k];
+                if(!edges.insert(((unsigned long long) a << 32) | b).second) continue;
+                indices.push_back(a);
+                indices.push_back(b);
+            }
+        }
+        this->upload(layers->wireframe, GL_LINES, verts, indices);
+    }
+
+    glLineWidth(2);
+    this->use_surface(0., 0., 1., 1., false);
+    this->draw(layers->wireframe);
+    this->unuse();
+}
+
+
+void Renderer::draw_boundary_tris(Mesh* mesh, const double alpha)
+{
+    if(!this->ready){
+        draw_opague_boundary_tris(alpha, mesh->boundary_tris);
+        return;
+    }
+
+    MeshLayers* layers = this->layers_of(mesh);
+    if(!layers->boundary_tris.uploaded){
+        vector<LayerVertex> verts;
+        vector<UI> indices;
+        unordered_map<const Vertex*, UI> idx_of;
+        indices.reserve(3 * mesh->boundary_tris.size());
+        for(const Triangle* tri : mesh->boundary_tris){
+            for(unsigned char k = 0; k < 3; k++) indices.push_back(boundary_vert(tri->verts[k], idx_of, verts));
+        }
+        this->upload(layers->boundary_tris, GL_TRIANGLES, verts, indices);
+    }
+
+    glEnable(GL_BLEND); //Enable blending.
+    glDepthMask( GL_FALSE );
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); //Set blending function.
+    this->use_surface(0., 0., 1., alpha, false);
+    this->draw(layers->boundary_tris);
+    this->unuse();
+    glDepthMask( GL_TRUE );
+    glDisable( GL_BLEND );
+}
@@ -0,0 +1,161 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <vector>
+#include <unordered_map>
+#include <QOpenGLFunctions>
+#include <QOpenGLVertexArrayObject>
+#include "Others/Predefined.h"
+
+using namespace std;
+
+class Mesh;
+class Isosurface;
+class StreamLine;
+
+// one vertex of every layer, a position and 3 floats whose meaning depends on the program drawing it
+// PROGRAM_COLORMAP: speed, time, unused. PROGRAM_SURFACE: normal. PROGRAM_COLOR: rgb
+struct LayerVertex{
+    float x, y, z;
+    float a, b, c;
+};
+
+
+enum RenderProgram : unsigned char{
+    PROGRAM_COLORMAP = 0,   // color from the 1D color map sampled by speed, points after the current time are cut
+    PROGRAM_SURFACE,        // uniform color, optionally lit by a head light
+    PROGRAM_COLOR,          // per vertex color
+    NUM_PROGRAMS
+};
+
+
+// geometry of one layer in a vertex buffer and an index buffer, drawn by a single glDrawElements
+class GLLayer{
+public:
+    GLuint vbo;
+    GLuint ibo;
+    QOpenGLVertexArrayObject* vao; // NULL if vertex array objects aren't supported, the attributes are bound per draw
+    GLenum mode;
+    GLsizei num_indices;
+    bool uploaded;
+
+    GLLayer();
+
+    inline bool is_empty() const;
+};
+
+
+// layers of one mesh at one time, uploaded the first time the time is drawn
+class FrameLayers{
+public:
+    double min_speed, max_speed;        // color range of the speed colored layers
+    bool has_speed_range;
+
+    GLLayer streamlines;
+    GLLayer seeds;
+    vector<StreamLine*> streamline_srcs;  // lines in the vertex buffer, the index buffer follows their LOD
+    vector<UL> streamline_bases;          // first vertex of each line
+    double streamline_ppu;                // pixels per unit the index buffer was built for
+
+    GLLayer vortex_cores;
+    GLLayer isosurface;
+    UL isosurface_serial;                 // Isosurface::serial of the extraction the layer was built from
+
+    GLLayer tets_with_fixed_pts;
+    GLLayer singularities;
+    GLLayer ecg_constructions;
+    GLLayer ecg_construction_seeds;
+    GLLayer ecg_connections;
+    GLLayer ecg_connection_seeds;
+
+    FrameLayers();
+};
+
+
+// layers that don't change with time
+class MeshLayers{
+public:
+    GLLayer boundary_tris;
+    GLLayer wireframe;
+    GLLayer pathlines;
+    UL num_pathlines;
+    unordered_map<double, FrameLayers*> frames;
+
+    MeshLayers();
+};
+
+
+// retained mode drawing of the openGLWindow
+// geometry is uploaded once per mesh and time into vertex buffers, colors come from a color map texture
+// sampled in the fragment shader, so a redraw costs one draw call per layer. the shaders are GLSL 1.20
+// and read the fixed function matrices, so they run on any compatibility context including Mesa's
+// software rasterizer. if they don't compile, every layer is drawn in immediate mode by Others/Draw.h
+class Renderer : protected QOpenGLFunctions
+{
+public:
+    Renderer();
+    ~Renderer();
+
+    void init();
+    inline bool is_ready() const;
+
+    void draw_streamlines(Mesh* mesh, const double time, const double pixels_per_unit);
+    void draw_pathlines(Mesh* mesh, const double time);
+    void draw_vortex_cores(Mesh* mesh, const double time);
+    void draw_isosurface(Mesh* mesh, const double time, const Isosurface* isosurface);
+    void draw_tets_with_fixed_pts(Mesh* mesh, const double time);
+    void draw_singularities(Mesh* mesh, const double time);
+    void draw_ecg_constructions(Mesh* mesh, const double time);
+    void draw_ecg_connections(Mesh* mesh, const double time);
+    void draw_wireframe(Mesh* mesh);
+    void draw_boundary_tris(Mesh* mesh, const double alpha);
+
+    void forget(Mesh* mesh, const double time);
+    void release_forgotten();
+
+private:
+    bool ready;
+    GLuint programs[NUM_PROGRAMS];
+    GLint uniform_min, uniform_range, uniform_time, uniform_colormap; // PROGRAM_COLORMAP
+    GLint uniform_color, uniform_lighting;                           // PROGRAM_SURFACE
+    GLuint colormap_tex;
+    unordered_map<Mesh*, MeshLayers*> meshes;
+    vector<pair<Mesh*, double>> forgotten; // frames whose products were deleted, released on the next draw
+
+    GLuint compile_program(const RenderProgram program);
+    void build_colormap();
+    MeshLayers* layers_of(Mesh* mesh);
+    FrameLayers* layers_of(Mesh* mesh, const double time);
+    void speed_range(Mesh* mesh, const double time, FrameLayers* frame);
+
+    void upload(GLLayer& layer, const GLenum mode, const vector<LayerVertex>& verts, const vector<UI>& indices);
+    void upload_indices(GLLayer& layer, const vector<UI>& indices);
+    void bind_attributes();
+    void release(GLLayer& layer);
+    void draw(GLLayer& layer);
+
+    void use_colormap(const double min, const double max, const double time);
+    void use_surface(const float r, const float g, const float b, const float a, const bool lighting);
+    void use_color();
+    void unuse();
+
+    void release(MeshLayers* layers);
+    void release(FrameLayers* frame);
+
+    void build_streamline_indices(FrameLayers* frame, const double pixels_per_unit);
+    void build_line_layers(GLLayer& lines, GLLayer& seeds, const vector<StreamLine*>& sls);
+};
+
+
+inline bool GLLayer::is_empty() const
+{
+    return this->num_indices == 0;
+}
+
+
+inline bool Renderer::is_ready() const
+{
+    return this->ready;
+}
+
+#endif // RENDERER_H
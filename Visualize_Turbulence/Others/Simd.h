@@ -0,0 +1,102 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+#include <cmath>
+#include "Others/Predefined.h"
+
+// the x86 kernels are built with target attributes instead of compiler flags, so the binary runs on any x86-64 cpu
+// and the widest one the cpu supports is picked at runtime, see flow_kernels() in Lines/FlowKernels.h
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_X86_TARGETS 1
+#include <immintrin.h>
+#else
+#define SIMD_X86_TARGETS 0
+#endif
+
+// a few packed double operations for the batched kernels, one register holds width lanes
+// the file that includes this defines SIMD_AVX512 or SIMD_AVX2 first, or neither for a single scalar lane.
+// every instruction set gets its own namespace, SIMD_NAMESPACE, so the differently built copies of the
+// kernels never get mixed up by the linker, and the functions using its registers are marked SIMD_TARGET.
+// masks are plain bit sets, bit l belongs to lane l.
+#if defined(SIMD_AVX512) && SIMD_X86_TARGETS
+#define SIMD_NAMESPACE SimdAvx512
+#define SIMD_TARGET __attribute__((target("avx512f")))
+namespace SIMD_NAMESPACE
+{
+    const UI width = 8;
+    const char* const isa_name = "AVX-512";
+    typedef __m512d vd;
+
+    SIMD_TARGET inline vd set1(const double a) { return _mm512_set1_pd(a); }
+    SIMD_TARGET inline vd load(const double* p) { return _mm512_loadu_pd(p); }
+    SIMD_TARGET inline void store(double* p, const vd a) { _mm512_storeu_pd(p, a); }
+    SIMD_TARGET inline vd add(const vd a, const vd b) { return _mm512_add_pd(a, b); }
+    SIMD_TARGET inline vd sub(const vd a, const vd b) { return _mm512_sub_pd(a, b); }
+    SIMD_TARGET inline vd mul(const vd a, const vd b) { return _mm512_mul_pd(a, b); }
+    SIMD_TARGET inline vd fmadd(const vd a, const vd b, const vd c) { return _mm512_fmadd_pd(a, b, c); }
+    SIMD_TARGET inline vd min(const vd a, const vd b) { return _mm512_min_pd(a, b); }
+    SIMD_TARGET inline vd sqrt(const vd a) { return _mm512_sqrt_pd(a); }
+    SIMD_TARGET inline UI less_than(const vd a, const vd b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    // base[idx[l]] for each lane
+    SIMD_TARGET inline vd gather(const double* base, const int64_t* idx)
+    {
+        return _mm512_i64gather_pd(_mm512_loadu_si512((const void*) idx), base, 8);
+    }
+}
+#elif defined(SIMD_AVX2) && SIMD_X86_TARGETS
+#define SIMD_NAMESPACE SimdAvx2
+#define SIMD_TARGET __attribute__((target("avx2,fma")))
+namespace SIMD_NAMESPACE
+{
+    const UI width = 4;
+    const char* const isa_name = "AVX2";
+    typedef __m256d vd;
+
+    SIMD_TARGET inline vd set1(const double a) { return _mm256_set1_pd(a); }
+    SIMD_TARGET inline vd load(const double* p) { return _mm256_loadu_pd(p); }
+    SIMD_TARGET inline void store(double* p, const vd a) { _mm256_storeu_pd(p, a); }
+    SIMD_TARGET inline vd add(const vd a, const vd b) { return _mm256_add_pd(a, b); }
+    SIMD_TARGET inline vd sub(const vd a, const vd b) { return _mm256_sub_pd(a, b); }
+    SIMD_TARGET inline vd mul(const vd a, const vd b) { return _mm256_mul_pd(a, b); }
+    SIMD_TARGET inline vd fmadd(const vd a, const vd b, const vd c) { return _mm256_fmadd_pd(a, b, c); }
+    SIMD_TARGET inline vd min(const vd a, const vd b) { return _mm256_min_pd(a, b); }
+    SIMD_TARGET inline vd sqrt(const vd a) { return _mm256_sqrt_pd(a); }
+    SIMD_TARGET inline UI less_than(const vd a, const vd b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+    SIMD_TARGET inline vd gather(const double* base, const int64_t* idx)
+    {
+        return _mm256_i64gather_pd(base, _mm256_loadu_si256((const __m256i*) idx), 8);
+    }
+}
+#elif !defined(SIMD_AVX512) && !defined(SIMD_AVX2)
+#define SIMD_NAMESPACE SimdScalar
+#define SIMD_TARGET
+namespace SIMD_NAMESPACE
+{
+    const UI width = 1;
+    const char* const isa_name = "scalar";
+    typedef double vd;
+
+    inline vd set1(const double a) { return a; }
+    inline vd load(const double* p) { return *p; }
+    inline void store(double* p, const vd a) { *p = a; }
+    inline vd add(const vd a, const vd b) { return a + b; }
+    inline vd sub(const vd a, const vd b) { return a - b; }
+    inline vd mul(const vd a, const vd b) { return a * b; }
+    inline vd fmadd(const vd a, const vd b, const vd c) { return a * b + c; }
+    inline vd min(const vd a, const vd b) { return a < b ? a : b; }
+    inline vd sqrt(const vd a) { return std::sqrt(a); }
+    inline UI less_than(const vd a, const vd b) { return a < b ? 1 : 0; }
+    inline vd gather(const double* base, const int64_t* idx) { return base[idx[0]]; }
+}
+#endif
+
+#ifdef SIMD_NAMESPACE
+namespace SIMD_NAMESPACE
+{
+    // all lanes set
+    const UI full_mask = width >= 32 ? ~0u : (1u << width) - 1u;
+}
+#endif
+
+#endif // SIMD_H
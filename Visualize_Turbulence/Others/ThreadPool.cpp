@@ -0,0 +1,65 @@
+#include "Others/ThreadPool.h"
+
+ThreadPool::ThreadPool(const UI num_threads)
+{
+    this->stopping = false;
+    const UI n = num_threads == 0 ? 1 : num_threads;
+    this->workers.reserve(n);
+    for(UI i = 0; i < n; i++){
+        this->workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+
+// the tasks still queued are finished before the workers are joined
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(this->tasks_mutex);
+        this->stopping = true;
+    }
+    this->tasks_cv.notify_all();
+    for(thread& t : this->workers) t.join();
+    this->workers.clear();
+}
+
+
+void ThreadPool::submit(function<void()> task)
+{
+    {
+        lock_guard<mutex> lock(this->tasks_mutex);
+        this->tasks.push_back(std::move(task));
+    }
+    this->tasks_cv.notify_one();
+}
+
+
+// run the oldest queued task on the calling thread, return false if the queue is empty
+bool ThreadPool::run_one()
+{
+    function<void()> task;
+    {
+        lock_guard<mutex> lock(this->tasks_mutex);
+        if(this->tasks.empty()) return false;
+        task = std::move(this->tasks.front());
+        this->tasks.pop_front();
+    }
+    task();
+    return true;
+}
+
+
+void ThreadPool::work()
+{
+    while(true){
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(this->tasks_mutex);
+            this->tasks_cv.wait(lock, [this](){ return this->stopping || !this->tasks.empty(); });
+            if(this->tasks.empty()) return; // stopping and nothing left
+            task = std::move(this->tasks.front());
+            this->tasks.pop_front();
+        }
+        task();
+    }
+}
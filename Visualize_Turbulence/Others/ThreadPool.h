@@ -0,0 +1,99 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include "Others/Predefined.h"
+#include "Others/Parallel.h"
+
+using namespace std;
+
+// a fixed set of worker threads that stay alive between jobs
+// use it instead of Utility::parallel_for for work that repeats every frame, so no threads are created per frame.
+// tasks run in submission order. the pool must outlive every task submitted to it.
+class ThreadPool{
+public:
+    ThreadPool(const UI num_threads = Utility::num_threads());
+    ~ThreadPool();
+
+    inline UI size() const;
+    void submit(function<void()> task);
+    bool run_one();
+
+    template<class Func>
+    void parallel_for(const UL begin, const UL end, Func func, const UL min_chunk_size = 1024);
+
+private:
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex tasks_mutex;
+    condition_variable tasks_cv;
+    bool stopping;
+
+    void work();
+};
+
+
+inline UI ThreadPool::size() const
+{
+    return this->workers.size();
+}
+
+
+// same splitting as Utility::parallel_for, the chunks run on the pool and the caller does the first one
+// while waiting the caller runs queued tasks itself, so calling it from inside a pool task can't deadlock
+template<class Func>
+void ThreadPool::parallel_for(const UL begin, const UL end, Func func, const UL min_chunk_size)
+{
+    if(end <= begin) return;
+    const UL size = end - begin;
+    UL num_chunks = this->size() + 1;
+    if(size / num_chunks < min_chunk_size) num_chunks = size / min_chunk_size;
+    if(num_chunks <= 1){
+        func(begin, end);
+        return;
+    }
+
+    struct Pending{
+        mutex m;
+        condition_variable cv;
+        UL remaining;
+    } pending;
+    pending.remaining = 0;
+
+    const UL chunk_size = (size + num_chunks - 1) / num_chunks;
+    for(UL c = 1; c < num_chunks; c++){
+        const UL b = begin + c * chunk_size;
+        if(b >= end) break;
+        const UL e = b + chunk_size < end ? b + chunk_size : end;
+        {
+            lock_guard<mutex> lock(pending.m);
+            pending.remaining++;
+        }
+        this->submit([&pending, &func, b, e](){
+            func(b, e);
+            lock_guard<mutex> lock(pending.m);
+            if(--pending.remaining == 0) pending.cv.notify_all();
+        });
+    }
+    func(begin, begin + chunk_size);
+
+    while(true){
+        {
+            lock_guard<mutex> lock(pending.m);
+            if(pending.remaining == 0) return;
+        }
+        // nothing left to help with means every chunk has been picked up, just wait for them
+        if(!this->run_one()){
+            unique_lock<mutex> lock(pending.m);
+            pending.cv.wait(lock, [&pending](){ return pending.remaining == 0; });
+            return;
+        }
+    }
+}
+
+#endif // THREADPOOL_H
@@ -5,17 +5,23 @@
 #define GL_SILENCE_DEPRECATION
 
 #include <QString>
-#include <QMessageBox>
 #include <set>
+// the headless build (Visualize_Turbulence_batch.pro) links QtCore only
+#ifndef HEADLESS_BUILD
+#include <QMessageBox>
 #include <OpenGL/gl.h>
 #include <OpenGL/gltypes.h>
 #include <QtGui/qgenericmatrix.h>
 #include <QtGui/qquaternion.h>
+#endif
 
 #include "Geometry/Mesh.h"
 #include "Geometry/Tet.h"
+#ifndef HEADLESS_BUILD
 #include "Others/TraceBall.h"
+#endif
 #include "Others/ColorTable.h"
+#include "Lines/Seeding.h"
 
 extern vector<Mesh*> meshes;
 extern bool LeftButtonDown, MiddleButtonDown, RightButtonDown;
@@ -32,27 +38,66 @@ extern const UI NUM_SEEDS_for_Limit;
 extern const UI max_num_steps_for_Limit;
 extern const UI frames_per_sec;
 extern const double time_step_size;
-extern const double surface_level_ratio;
+extern double surface_level_ratio;
+extern ScalarFieldType isosurface_field;
 extern unordered_map<double, double> surface_level_vals;
 extern const double dist_step_size;
+extern const double pathline_time_step;
+extern const double stagnation_speed_ratio;
+extern const double max_streamline_arc_length;
+extern const UI cycle_window;
+extern const UI num_lod_levels;
+extern const double lod_base_tolerance;
+extern const double lod_pixel_error;
+extern const double evenly_spaced_separation;
+extern const double evenly_spaced_test_ratio;
+extern const UI max_evenly_spaced_seeds;
+extern const double seed_importance_falloff;
+extern const double ftle_integration_time;
+extern const UI ftle_grid_res;
+extern const bool ftle_on_mesh_verts;
 extern const unsigned int max_num_recursion;
 extern const double zero_threshold;
+extern const UI min_vortex_core_verts;
+extern const UL num_cloud_particles;
+extern const UI prefetch_frames;
+extern const UL frame_memory_budget;
+extern const UI playback_prefetch_frames;
 extern const double h;
 
 extern bool show_streamlines;
 extern bool show_pathlines;
 extern bool show_isosurfaces;
+extern bool show_vortex_cores;
+extern bool show_particle_cloud;
 extern bool show_boundary_wireframe;
 extern bool show_opage_boundary_tris;
 extern bool show_axis;
+extern bool show_compare_view;
 extern bool build_ECG;
+extern bool build_derived_fields;
+extern bool run_advection_benchmark;
+extern bool run_vorticity_check;
 extern bool tracing_streamlines_from_seed;
+extern SeedingStrategy streamline_seeding;
+extern ImportanceField seed_importance;
 extern bool tracing_streamlines_from_critical_pts;
 extern bool show_ECG_connections;
 extern bool show_ECG_edge_constructions;
 extern bool show_fixedPts;
 extern bool show_tets_with_fixedPts;
 extern bool show_seeds;
+extern bool batch_mode;
+extern const unsigned rng_seed;
+extern const bool use_product_cache;
+extern const QString product_cache_dir;
+extern const bool page_field_data;
+extern const UL field_memory_budget;
+extern const bool compress_frame_cache;
+extern const unsigned char loaded_fields;
+extern const bool derive_vorticity;
+extern const unsigned char stored_fields;
+extern const bool quantize_frames;
 
 extern const double boundary_tri_alpha;
 
@@ -68,9 +113,11 @@ namespace Utility
             const double win_world_sizex, const double win_world_sizey,
             double &s, double &t
     );
+#ifndef HEADLESS_BUILD
     inline void Quanternion_to_Matrix4x4(const QQuaternion& q, Matrix& mat4x4);
     inline void multmatrix(const Matrix m);
     inline void mat_ident(Matrix m);
+#endif
     inline void mat_ident(float m[16]);
     inline vector<UL> generate_unique_random_Tet_idx(Mesh* mesh);
     inline bool is_in_set(set<Tet*> s, Tet* tet);
@@ -94,9 +141,16 @@ namespace Utility
 
 inline void Utility::throwErrorMessage( const QString message )
 {
+    // there is no QApplication to show a message box in batch mode
+    if(batch_mode){
+        qCritical() << "Error:" << message;
+        exit(-1);
+    }
+#ifndef HEADLESS_BUILD
     QMessageBox messageBox;
     messageBox.critical(0, "Error", message);
     messageBox.setFixedSize(500,200);
+#endif
     exit(-1);
 }
 
@@ -131,6 +185,7 @@ inline bool Utility::is_in_set(set<Edge*> s, Edge* e)
 }
 
 
+#ifndef HEADLESS_BUILD
 inline void Utility::Quanternion_to_Matrix4x4(const QQuaternion& q, Matrix& mat4x4)
 {
     QMatrix3x3 m3x3 = q.toRotationMatrix();
@@ -180,6 +235,7 @@ inline void Utility::mat_ident(Matrix m)
         m[i][i] = 1.0;
     }
 }
+#endif
 
 inline void Utility::mat_ident(float m[16])
 {
@@ -253,7 +309,7 @@ inline float * Utility::MulArray3( float factor, float array0[3] )
 
 inline vector<UL> Utility::generate_unique_random_Tet_idx(Mesh* mesh)
 {
-    srand((unsigned) time(NULL));
+    srand(rng_seed);
     set<UL> seeded_tets;
     unsigned int cur_num_seeds = 0;
     while(cur_num_seeds < NUM_SEEDS)
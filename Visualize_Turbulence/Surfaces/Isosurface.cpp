@@ -1,10 +1,20 @@
 #include "Surfaces/Isosurface.h"
 #include "Others/Utilities.h"
+#include "FileLoader/ProductCache.h"
+#include <QElapsedTimer>
+#include <atomic>
 
 
 Isosurface::Isosurface()
 {
     this->time = 0;
+    this->iso_val = 0;
+    this->level_ratio = 0;
+    this->field = FIELD_VOR_MAG;
+    this->num_active_tets = 0;
+    // isosurfaces are extracted on the analysis threads too
+    static atomic<UL> num_made(0);
+    this->serial = ++num_made;
 }
 
 Isosurface::~Isosurface()
@@ -19,6 +29,15 @@ Isosurface::~Isosurface()
     }
 
     tris.clear();
+
+    // vertices interpolated on the cut edges belong to this isosurface
+    for(i = 0; i < this->verts.size(); i++){
+        if(this->verts[i] != NULL){
+            delete this->verts[i];
+            this->verts[i] = NULL;
+        }
+    }
+    verts.clear();
 }
 
 
@@ -32,35 +51,33 @@ void construct_isosurfaces()
         // interpolate vertices at all t=n*0.1 and 0<t<num_time_steps
         mesh->interpolate_vertices_for_all_t();
 
-        // calculate actual surface level using surface_level_ratio
-        calc_actual_surface_levels_for_all_t(mesh);
+        if(load_cached_isosurfaces(mesh)) continue;
 
-        // for each vertex, check if it is above the surface level or below and mark them
-        classify_vertex_levels_for_all_t(mesh);
+        // index the (min, max) range of every tet so extraction only visits active tets
+        build_span_spaces_for_all_t(mesh);
 
-        // for each tet, calculate the marching tetrahedron index
-        calc_marching_indices_for_all_t(mesh);
+        // calculate actual surface level using surface_level_ratio
+        calc_actual_surface_levels_for_all_t(mesh);
 
-        // for each tet, create triangles based on the index
+        // for each active tet, create triangles based on the index
         create_isosurface_tris_for_all_t(mesh);
+        save_cached_isosurfaces(mesh);
     }
 }
 
 
-// needs to be called after mesh->interpolate_vertices()
-// we are currently using vorticity magnitude
-// so we calculate min and max vorticity magnitude at all vertices
+// needs to be called after build_span_spaces_for_all_t()
+// the span space of each time knows the min and max of isosurface_field at all vertices
 // using surface_level_ratio to calculate the actual levels we want for all t
 void calc_actual_surface_levels_for_all_t(Mesh * mesh)
 {
-    mesh->calc_vor_min_max_at_verts_for_all_t();
-
     double time = 0.;
     while(time < mesh->num_time_steps - 1.)
     {
-        pair<double, double> min_max = mesh->min_max_at_verts_for_all_t[time];
-        const double& min = min_max.first;
-        const double& max = min_max.second;
+        const FrameHandle frame = mesh->field_store.pin(mesh, time);
+        const SpanSpace* span = get_span_space(mesh, time);
+        const double& min = span->min_val;
+        const double& max = span->max_val;
 
         const double actual_surface_level = surface_level_ratio * (max-min) + min;
         surface_level_vals[time] = actual_surface_level;
@@ -70,49 +87,132 @@ void calc_actual_surface_levels_for_all_t(Mesh * mesh)
 }
 
 
-// assume all vertices are interpolated for all time levels
-void classify_vertex_levels_for_all_t(Mesh* mesh)
+// assume span spaces and surface levels are calculated
+void create_isosurface_tris_for_all_t( Mesh* mesh )
 {
+    QElapsedTimer timer;
+    timer.start();
+
+    UL num_tris = 0, num_actives = 0, max_actives = 0;
     double time = 0.;
     while(time < mesh->num_time_steps - 1.)
     {
-        // for each vert
-        for(Vertex* vert : mesh->verts){
-            // check if this vert is above the surface level (>=)
-            const double vert_vor_mag = length( vert->vors.at(time) );
-            if(vert_vor_mag >= surface_level_vals.at(time)){
-                vert->is_above_surface[time] = true;
-            }
-            else{
-                vert->is_above_surface[time] = false;
-            }
+        if(mesh->isosurfaces_for_all_t.find(time) != mesh->isosurfaces_for_all_t.end()){
+            delete mesh->isosurfaces_for_all_t.at(time);
         }
+        const FrameHandle frame = mesh->field_store.pin(mesh, time);
+        Isosurface* isosurf = extract_isosurface(mesh, time, surface_level_vals.at(time));
+        num_tris += isosurf->num_tris();
+        num_actives += isosurf->num_active_tets;
+        if(isosurf->num_active_tets > max_actives) max_actives = isosurf->num_active_tets;
+        mesh->isosurfaces_for_all_t[time] = isosurf;
+        time += time_step_size; // increment time
+    }
+
+    // the marching indices used to be kept in per-time hash maps on every tet and every vertex,
+    // each entry costs about a key, a value, a next pointer and a bucket slot.
+    const double secs = timer.nsecsElapsed() / 1e9;
+    const UL num_frames = mesh->isosurfaces_for_all_t.size();
+    const UL map_entry_size = sizeof(double) + 3 * sizeof(void*);
+    const UL hash_map_bytes = (mesh->num_tets() + mesh->num_verts()) * num_frames * map_entry_size;
+    qDebug() << "Isosurface extraction of" << scalar_field_name(isosurface_field) << ":" << num_tris << "triangles for" << num_frames << "frames in" << secs << "secs,"
+             << (secs > 0 ? num_actives / secs : 0.) << "active tets/sec";
+    qDebug() << "Isosurface classification: transient" << max_actives << "bytes per frame at most instead of about"
+             << hash_map_bytes << "bytes kept in per-time hash maps";
+}
 
+
+// build one span space for each time step
+void build_span_spaces_for_all_t(Mesh* mesh)
+{
+    double time = 0.;
+    while(time < mesh->num_time_steps - 1.)
+    {
+        const FrameHandle frame = mesh->field_store.pin(mesh, time);
+        get_span_space(mesh, time);
         time += time_step_size; // increment time
     }
 }
 
 
-void calc_marching_indices_for_all_t(Mesh* mesh)
+// return the span space of isosurface_field at time
+// it is (re)built if it doesn't exist yet or was built for another field
+SpanSpace* get_span_space(Mesh* mesh, const double time)
 {
-    for(Tet* tet : mesh->tets){
-        tet->calc_marching_indices(mesh->num_time_steps);
+    auto it = mesh->span_spaces_for_all_t.find(time);
+    if(it != mesh->span_spaces_for_all_t.end()){
+        if(it->second->field == isosurface_field) return it->second;
+        delete it->second;
+        mesh->span_spaces_for_all_t.erase(it);
     }
+
+    SpanSpace* span = new SpanSpace(mesh, time, isosurface_field);
+    mesh->span_spaces_for_all_t[time] = span;
+    return span;
 }
 
 
-void create_isosurface_tris_for_all_t( Mesh* mesh )
+// extract the isosurface at iso_val by only visiting the tets whose range contains iso_val
+// the span space of this time is built if it doesn't exist yet
+Isosurface* extract_isosurface(Mesh* mesh, const double time, const double iso_val)
 {
-    double time = 0.;
-    while(time < mesh->num_time_steps - 1.)
-    {
-        Isosurface* isosurf= new Isosurface();
-        for(Tet* tet:mesh->tets){
-            vector<Triangle*> new_tris = tet->create_isosurface_tris(time);
-            isosurf->add_tri(new_tris);
+    return extract_isosurface(mesh, get_span_space(mesh, time), iso_val, surface_level_ratio);
+}
+
+
+// same on a given span space, nothing of mesh is changed so it can run off the GUI thread
+Isosurface* extract_isosurface(Mesh* mesh, const SpanSpace* span, const double iso_val, const double level_ratio)
+{
+    const double time = span->time;
+    vector<UL> actives;
+    span->active_tets(iso_val, actives);
+
+    // classify the active tets into a transient byte array, discarded after extraction
+    const unsigned char one = 0b01;
+    vector<unsigned char> marching_idices(actives.size(), 0);
+    for(UL i = 0; i < actives.size(); i++){
+        const Tet* tet = mesh->tets[actives[i]];
+        unsigned char marching_idx = 0;
+        for(unsigned char j = 0; j < 4; j++){
+            if(span->vert_vals[tet->verts[j]->idx] >= iso_val) marching_idx |= (one << j);
         }
+        marching_idices[i] = marching_idx;
+    }
 
-        mesh->isosurfaces_for_all_t[time] = isosurf;
-        time += time_step_size; // increment time
+    Isosurface* isosurf = new Isosurface();
+    isosurf->time = time;
+    isosurf->iso_val = iso_val;
+    isosurf->level_ratio = level_ratio;
+    isosurf->field = span->field;
+    isosurf->num_active_tets = actives.size();
+    isosurf->tris.reserve(actives.size() * 2);
+    isosurf->verts.reserve(actives.size() * 4);
+
+    for(UL i = 0; i < actives.size(); i++){
+        Tet* tet = mesh->tets[actives[i]];
+        tet->create_isosurface_tris(time, &mesh->field_store, marching_idices[i], iso_val, span->vert_vals.data(), isosurf->verts, isosurf->tris);
+    }
+
+    return isosurf;
+}
+
+
+// return the isosurface at time for the current surface_level_ratio and isosurface_field
+// if either has changed since the isosurface was built, it is extracted again
+Isosurface* update_isosurface(Mesh* mesh, const double time)
+{
+    if(mesh->isosurfaces_for_all_t.find(time) != mesh->isosurfaces_for_all_t.end()){
+        Isosurface* isosurf = mesh->isosurfaces_for_all_t.at(time);
+        if(isosurf->level_ratio == surface_level_ratio && isosurf->field == isosurface_field) return isosurf;
+        delete isosurf;
+        mesh->isosurfaces_for_all_t.erase(time);
     }
+
+    const SpanSpace* span = get_span_space(mesh, time);
+    const double actual_surface_level = surface_level_ratio * (span->max_val - span->min_val) + span->min_val;
+    surface_level_vals[time] = actual_surface_level;
+
+    Isosurface* isosurf = extract_isosurface(mesh, time, actual_surface_level);
+    mesh->isosurfaces_for_all_t[time] = isosurf;
+    return isosurf;
 }
@@ -4,6 +4,8 @@
 #include <vector>
 #include "Others/Predefined.h"
 #include "Geometry/Triangle.h"
+#include "Geometry/Vertex.h"
+#include "Surfaces/SpanSpace.h"
 
 class Mesh;
 
@@ -11,7 +13,12 @@ class Isosurface{
 public:
     double time; // indicates which time this isosurface is for
     double iso_val; // value of the isosurface
+    double level_ratio; // surface_level_ratio used to build this isosurface
+    ScalarFieldType field; // scalar field this isosurface is extracted from
     vector<Triangle*> tris;
+    vector<Vertex*> verts; // vertices interpolated on the cut edges, owned by this isosurface
+    UL num_active_tets; // tets of the span space query that were classified to extract it
+    UL serial; // unique for every isosurface made, a replaced one may get the address of the one before
 
     Isosurface();
     ~Isosurface();
@@ -23,9 +30,12 @@ public:
 
 void construct_isosurfaces();
 void calc_actual_surface_levels_for_all_t(Mesh * mesh);
-void classify_vertex_levels_for_all_t(Mesh * mesh);
-void calc_marching_indices_for_all_t(Mesh * mesh);
 void create_isosurface_tris_for_all_t(Mesh * mesh);
+void build_span_spaces_for_all_t(Mesh * mesh);
+SpanSpace* get_span_space(Mesh * mesh, const double time);
+Isosurface* extract_isosurface(Mesh * mesh, const double time, const double iso_val);
+Isosurface* extract_isosurface(Mesh * mesh, const SpanSpace* span, const double iso_val, const double level_ratio);
+Isosurface* update_isosurface(Mesh * mesh, const double time);
 
 inline unsigned long Isosurface::num_tris() const
 {
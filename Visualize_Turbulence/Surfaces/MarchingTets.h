@@ -0,0 +1,43 @@
+#ifndef MARCHINGTETS_H
+#define MARCHINGTETS_H
+
+// lookup tables for marching tetrahedra
+// http://paulbourke.net/geometry/polygonise/
+// a marching index has bit i set if verts[i] of the tet is above the surface level
+
+// the 6 edges of a tet as pairs of local vertex indices
+constexpr unsigned char tet_edge_verts[6][2] = {
+    {0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}
+};
+
+struct MarchingCase{
+    unsigned char num_tris;
+    unsigned char tri_edges[2][3]; // local edge indices of each triangle
+};
+
+// 16 cases, complementary indices produce the same triangles
+// one vertex different: one triangle through the 3 edges of that vertex
+// two vertices different: a quad through the 4 cut edges, split into two triangles
+constexpr MarchingCase marching_cases[16] = {
+    {0, {{0, 0, 0}, {0, 0, 0}}}, // 0b0000
+    {1, {{0, 1, 2}, {0, 0, 0}}}, // 0b0001, vert 0 is different
+    {1, {{0, 3, 4}, {0, 0, 0}}}, // 0b0010, vert 1 is different
+    {2, {{1, 2, 4}, {1, 4, 3}}}, // 0b0011, cut between 01 and 23
+    {1, {{1, 3, 5}, {0, 0, 0}}}, // 0b0100, vert 2 is different
+    {2, {{0, 2, 5}, {0, 5, 3}}}, // 0b0101, cut between 02 and 13
+    {2, {{0, 1, 5}, {0, 5, 4}}}, // 0b0110, cut between 03 and 12
+    {1, {{2, 4, 5}, {0, 0, 0}}}, // 0b0111, vert 3 is different
+    {1, {{2, 4, 5}, {0, 0, 0}}}, // 0b1000, vert 3 is different
+    {2, {{0, 1, 5}, {0, 5, 4}}}, // 0b1001, cut between 03 and 12
+    {2, {{0, 2, 5}, {0, 5, 3}}}, // 0b1010, cut between 02 and 13
+    {1, {{1, 3, 5}, {0, 0, 0}}}, // 0b1011, vert 2 is different
+    {2, {{1, 2, 4}, {1, 4, 3}}}, // 0b1100, cut between 01 and 23
+    {1, {{0, 3, 4}, {0, 0, 0}}}, // 0b1101, vert 1 is different
+    {1, {{0, 1, 2}, {0, 0, 0}}}, // 0b1110, vert 0 is different
+    {0, {{0, 0, 0}, {0, 0, 0}}}  // 0b1111
+};
+
+static_assert(marching_cases[0b0011].num_tris == 2 && marching_cases[0b1000].num_tris == 1,
+              "marching_cases: wrong number of triangles");
+
+#endif // MARCHINGTETS_H
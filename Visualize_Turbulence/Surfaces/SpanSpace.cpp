@@ -0,0 +1,128 @@
+#include "Surfaces/SpanSpace.h"
+#include "Others/Utilities.h"
+#include <algorithm>
+#include <float.h>
+
+SpanSpace::SpanSpace()
+{
+    this->time = 0.;
+    this->field = FIELD_VOR_MAG;
+    this->min_val = this->max_val = 0.;
+    this->bucket_width = 0.;
+}
+
+
+SpanSpace::SpanSpace(Mesh* mesh, const double time, const ScalarFieldType field)
+{
+    this->build(mesh, time, field);
+}
+
+
+SpanSpace::~SpanSpace()
+{
+    this->vert_vals.clear();
+    this->tet_ids.clear();
+    this->tet_mins.clear();
+    this->tet_maxs.clear();
+    this->bucket_starts.clear();
+}
+
+
+// build the index for the scalar field at time
+// the vertex values are copied from the field store once here so queries don't touch the vertex maps again
+void SpanSpace::build(Mesh* mesh, const double time, const ScalarFieldType field)
+{
+    this->time = time;
+    this->field = field;
+
+    // step 1: scalar value at every vertex
+    this->vert_vals = mesh->field_store.vert_vals(mesh, time, field);
+    const UL num_verts = this->vert_vals.size();
+    // FTLE of a frame it wasn't computed for, the index is empty and no tet is ever active
+    if(num_verts != mesh->num_verts()){
+        this->min_val = this->max_val = 0.;
+        this->bucket_width = 0.;
+        return;
+    }
+    this->min_val = DBL_MAX;
+    this->max_val = -DBL_MAX;
+    for(UL i = 0; i < num_verts; i++){
+        const double val = this->vert_vals[i];
+        if(val < this->min_val) this->min_val = val;
+        if(val > this->max_val) this->max_val = val;
+    }
+
+    // step 2: (min, max) range of every tet
+    const UL num_tets = mesh->num_tets();
+    vector<double> mins(num_tets), maxs(num_tets);
+    for(UL i = 0; i < num_tets; i++){
+        const Tet* tet = mesh->tets[i];
+        double tet_min = DBL_MAX, tet_max = -DBL_MAX;
+        for(const Vertex* v : tet->verts){
+            const double val = this->vert_vals[v->idx];
+            if(val < tet_min) tet_min = val;
+            if(val > tet_max) tet_max = val;
+        }
+        mins[i] = tet_min;
+        maxs[i] = tet_max;
+    }
+
+    // step 3: bucket the tets by their min value, about sqrt(num_tets) tets in each bucket
+    UL num_buckets = (UL) sqrt((double) num_tets);
+    if(num_buckets == 0) num_buckets = 1;
+    this->bucket_width = (this->max_val - this->min_val) / num_buckets;
+    this->bucket_starts.assign(num_buckets + 1, 0);
+
+    vector<UL> tet_bucket(num_tets);
+    for(UL i = 0; i < num_tets; i++){
+        const UL b = this->bucket_of(mins[i]);
+        tet_bucket[i] = b;
+        this->bucket_starts[b + 1]++;
+    }
+    for(UL b = 0; b < num_buckets; b++){
+        this->bucket_starts[b + 1] += this->bucket_starts[b];
+    }
+
+    // counting sort into buckets
+    this->tet_ids.resize(num_tets);
+    vector<UL> fill = this->bucket_starts;
+    for(UL i = 0; i < num_tets; i++){
+        this->tet_ids[ fill[tet_bucket[i]]++ ] = i;
+    }
+
+    // step 4: inside each bucket, sort by max value in descending order
+    for(UL b = 0; b < num_buckets; b++){
+        auto first = this->tet_ids.begin() + this->bucket_starts[b];
+        auto last = this->tet_ids.begin() + this->bucket_starts[b + 1];
+        std::sort(first, last, [&maxs](const UL a, const UL c){ return maxs[a] > maxs[c]; });
+    }
+
+    this->tet_mins.resize(num_tets);
+    this->tet_maxs.resize(num_tets);
+    for(UL i = 0; i < num_tets; i++){
+        this->tet_mins[i] = mins[ this->tet_ids[i] ];
+        this->tet_maxs[i] = maxs[ this->tet_ids[i] ];
+    }
+}
+
+
+// collect the tets whose range contains iso_val
+// buckets below the bucket of iso_val only hold tets with min <= iso_val, so we can stop scanning
+// a bucket at the first tet whose max is below iso_val.
+// buckets above it only hold tets with min > iso_val and are skipped entirely.
+void SpanSpace::active_tets(const double iso_val, vector<UL>& actives) const
+{
+    actives.clear();
+    if(this->num_tets() == 0) return;
+    if(iso_val < this->min_val || iso_val > this->max_val) return;
+
+    const UL iso_bucket = this->bucket_of(iso_val);
+    for(UL b = 0; b <= iso_bucket; b++){
+        const UL end = this->bucket_starts[b + 1];
+        for(UL i = this->bucket_starts[b]; i < end; i++){
+            if(this->tet_maxs[i] < iso_val) break; // the rest of this bucket is below iso_val
+            if(b == iso_bucket && this->tet_mins[i] > iso_val) continue;
+            actives.push_back(this->tet_ids[i]);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef SPANSPACE_H
+#define SPANSPACE_H
+
+#include <vector>
+#include "Others/Predefined.h"
+#include "Analysis/ScalarFields.h"
+
+using namespace std;
+
+class Mesh;
+
+// span-space index over the (min, max) scalar range of every tet at one time step.
+// tets are bucketed by their min value and each bucket is sorted by max value in descending order,
+// so a query for an isovalue only walks the tets whose range contains it.
+// http://www.sci.utah.edu/~hansen/papers/spanspace.pdf
+class SpanSpace{
+public:
+    double time; // indicates which time this index is for
+    ScalarFieldType field; // indicates which scalar field this index is for
+    double min_val; // min scalar value over all vertices
+    double max_val; // max scalar value over all vertices
+    double bucket_width;
+
+    vector<double> vert_vals;   // scalar value of each mesh vertex, indexed by Vertex::idx
+    vector<UL> tet_ids;         // tet indices grouped by bucket
+    vector<double> tet_mins;    // min scalar value of tet_ids[i]
+    vector<double> tet_maxs;    // max scalar value of tet_ids[i]
+    vector<UL> bucket_starts;   // bucket b owns tet_ids[ bucket_starts[b], bucket_starts[b+1] )
+
+    SpanSpace();
+    SpanSpace(Mesh* mesh, const double time, const ScalarFieldType field);
+    ~SpanSpace();
+
+    void build(Mesh* mesh, const double time, const ScalarFieldType field);
+    void active_tets(const double iso_val, vector<UL>& actives) const;
+
+    inline UL num_buckets() const;
+    inline UL num_tets() const;
+    inline UL bucket_of(const double val) const;
+};
+
+
+inline UL SpanSpace::num_buckets() const
+{
+    if(this->bucket_starts.empty()) return 0;
+    return this->bucket_starts.size() - 1;
+}
+
+
+inline UL SpanSpace::num_tets() const
+{
+    return this->tet_ids.size();
+}
+
+
+// assume min_val <= val <= max_val
+inline UL SpanSpace::bucket_of(const double val) const
+{
+    if(this->bucket_width <= 0.) return 0;
+    UL b = (UL) ((val - this->min_val) / this->bucket_width);
+    if(b >= this->num_buckets()) b = this->num_buckets() - 1;
+    return b;
+}
+
+#endif // SPANSPACE_H
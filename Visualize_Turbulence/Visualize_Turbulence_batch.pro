@@ -0,0 +1,25 @@
+# the headless batch run of Others/Batch.h as its own executable for machines without a display
+# only QtCore is linked, no QtGui, QtWidgets, OpenGL or windowing system. same arguments as Visualize_Turbulence --batch
+QT       -= gui widgets opengl
+QT       += core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = Visualize_Turbulence_batch
+
+# keeps main.cpp and Others/Utilities.h to their non GUI parts
+DEFINES += HEADLESS_BUILD
+
+# the objects differ from the ones of the GUI build, so they don't share a directory when built in the source tree
+OBJECTS_DIR = batch_obj
+
+include(Visualize_Turbulence.pri)
+
+SOURCES += \
+    main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
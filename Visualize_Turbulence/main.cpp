@@ -1,5 +1,7 @@
 #include <queue>
+#ifndef HEADLESS_BUILD
 #include <QApplication>
+#endif
 #include <cstdlib>
 #include <set>
 #include <iostream>
@@ -10,8 +12,13 @@
 #include "Geometry/Mesh.h"
 #include "Surfaces/Isosurface.h"
 #include "Lines/StreamLine.h"
+#include "Lines/FlowSampler.h"
+#include "Lines/ParticleCloud.h"
 #include "Others/ColorTable.h"
+#include "Others/Batch.h"
+#ifndef HEADLESS_BUILD
 #include "mainwindow.h"
+#endif
 
 typedef pair<double, Tet*> qPair;
 
@@ -47,6 +54,22 @@ const QString dataFilePath6 = filePathPrefix + "with_boundary_fast_data.txt";
 const QString meshFilePath7 = filePathPrefix + "mesh.txt";
 const QString dataFilePath7 = filePathPrefix + "data.txt";
 
+// streamlines, isosurfaces and ECGs of earlier launches, see FileLoader/ProductCache.h
+const bool use_product_cache = true;
+const QString product_cache_dir = filePathPrefix + "cache/";
+// field data read one frame at a time from a binary copy of the data file in product_cache_dir, see FileLoader/FrameCache.h
+const bool page_field_data = true;
+const UL field_memory_budget = 4096UL << 20; // bytes of raw and derived field frames kept loaded per mesh
+// frames are stored losslessly compressed, about half the bytes to read per frame for smooth fields
+const bool compress_frame_cache = true;
+// columns of the data file that are read, the others are skipped and stay empty, see RawField in Analysis/ScalarFields.h
+const unsigned char loaded_fields = ALL_RAW_FIELDS;
+// vorticity is not read but computed from the velocity gradient, as the mean curl of the tets around a vertex
+const bool derive_vorticity = false;
+const unsigned char stored_fields = derive_vorticity ? loaded_fields & ~RAW_VORTICITY : loaded_fields; // columns kept
+// paged raw frames are kept in memory with 16 bits per value, see Analysis/QuantizedFrame.h for the error bound
+const bool quantize_frames = false;
+
 
 // boolean variables used to enable orbit control
 bool LeftButtonDown = false;
@@ -56,35 +79,76 @@ bool RightButtonDown = false;
 // streamlines
 bool show_streamlines = true;
 bool tracing_streamlines_from_seed = true;
+SeedingStrategy streamline_seeding = SEED_RANDOM;
+ImportanceField seed_importance = IMPORTANCE_VOR_MAG;
 
 bool show_pathlines = false;
 bool show_isosurfaces = false;
+bool show_vortex_cores = false;
+bool show_particle_cloud = false;
 
 bool show_boundary_wireframe = false;
 bool show_axis = true;
 bool show_opage_boundary_tris = true;
+bool show_compare_view = false; // the datasets on the mesh of the current one side by side
 bool build_ECG = true;
+bool build_derived_fields = false; // Q, lambda2 and helicity for all frames up front, otherwise on demand
+bool run_advection_benchmark = false; // log scalar vs batched particle-steps/sec at startup
+bool run_vorticity_check = false; // log the error of vorticity derived from velocity against the data file at startup
 bool show_ECG_connections = false;
 bool show_ECG_edge_constructions = false;
 bool show_seeds = true;
 bool show_fixedPts = true;
 bool show_tets_with_fixedPts = true;
+bool batch_mode = false; // set by --batch, nothing may show a window
 
 const double h = 1e-3;
+const unsigned rng_seed = 1; // seeds every random seed placement, part of the product cache key
 const UI NUM_SEEDS = 50;
 const UI max_num_steps = 500;
 //const UI NUM_SEEDS_for_Limit = 10;
 //const UI max_num_steps_for_Limit = 100;
 const double dist_step_size = 1e-2;
+const double pathline_time_step = 5e-2; // time advanced by each RK4 step of a pathline
+
+// streamline termination, see Lines/Termination.h
+const double stagnation_speed_ratio = 1e-3; // a line slower than this fraction of the frame's top speed stops
+const double max_streamline_arc_length = 4.; // per half, max_num_steps * dist_step_size is 5
+const UI cycle_window = 64; // a line re-entering one of the last cycle_window tets it entered stops
+
+// streamline levels of detail, see Lines/StreamLineLOD.h
+const UI num_lod_levels = 8; // level 0 is the full line
+const double lod_base_tolerance = 5e-4; // Douglas-Peucker tolerance of level 1, doubled per level
+const double lod_pixel_error = 1.; // largest deviation from the full line allowed on screen, in pixels
+
+// evenly spaced seeding, see Lines/Seeding.h
+const double evenly_spaced_separation = 5e-2; // distance kept between streamlines, also the occupancy cell size
+const double evenly_spaced_test_ratio = 0.5; // a line stops this fraction of the separation away from another
+const UI max_evenly_spaced_seeds = 2000; // per time step
+const double seed_importance_falloff = 0.1; // IMPORTANCE_SINGULARITIES: distance at which the weight is halved
+
+// FTLE parameters, see Analysis/FTLE.h
+const double ftle_integration_time = 1.; // negative for backward FTLE
+const UI ftle_grid_res = 64; // grid samples along the longest side of the bounding box
+const bool ftle_on_mesh_verts = true; // sample the flow map at the mesh vertices instead of a grid
 const UI frames_per_sec = 1; // frames per sec
 const double time_step_size = ((double)1.)/(double)frames_per_sec; // sec for each frame
 //const double time_step_size = 0.1;
 const UI max_num_recursion = 4;
 const double zero_threshold = 1e-15;
+const UI min_vortex_core_verts = 3; // shorter core lines are dropped as noise
+const UL num_cloud_particles = 1000000; // particles in the animated cloud, 1 to 10 million
+
+// frames computed on demand, see Others/AnalysisQueue.h
+const UI prefetch_frames = 4; // frames after the one on screen that are computed ahead
+const UL frame_memory_budget = 2048UL << 20; // bytes of isosurfaces, ECGs and streamlines kept in memory
+const UI playback_prefetch_frames = 16; // most field frames read ahead of the animation if paged, see Others/FramePrefetcher.h
 
 
-// surface_level is defined to be the voriticity
-const double surface_level_ratio = 0.02;
+// surface_level is defined on isosurface_field, vorticity magnitude by default
+// the ratio can be changed at runtime by the isovalue slider, the field by the F key
+double surface_level_ratio = 0.02;
+ScalarFieldType isosurface_field = FIELD_VOR_MAG;
 unordered_map<double, double> surface_level_vals;
 
 // arrow parameters
@@ -189,7 +253,7 @@ void testing_DetectfixedPt_subd(){
         qDebug() << sing.x() << sing.y() << sing.z();
         // calculate the jacobian matrix
         Singularity* singularity = new Singularity();
-        singularity->Jacobian = tet->calc_Jacobian(sing, 0); // calculate the jacobian for this sing
+        singularity->Jacobian = tet->calc_Jacobian(sing, 0, &mesh->field_store); // calculate the jacobian for this sing
         singularity->classify_this(); // classify the type of the singularity
         qDebug() << singularity->get_type();
     }
@@ -200,6 +264,20 @@ void testing_DetectfixedPt_subd(){
 
 int main(int argc, char *argv[])
 {
+    // headless run for machines without a display, see Others/Batch.h
+    // the build of Visualize_Turbulence_batch.pro has no GUI linked, every run of it is a batch run
+#ifdef HEADLESS_BUILD
+    BatchParams params;
+    if(!parse_batch_args(argc, argv, params)) return 2;
+    return run_batch(params);
+#else
+    // here it returns before anything of the GUI is constructed
+    if(is_batch_run(argc, argv)){
+        BatchParams params;
+        if(!parse_batch_args(argc, argv, params)) return 2;
+        return run_batch(params);
+    }
+
     QApplication a(argc, argv);
 
     // read files and build mesh
@@ -213,20 +291,36 @@ int main(int argc, char *argv[])
 //    test_fixedPtDetection_Robust();
 
     // constucting the data for rendering
-    if(show_isosurfaces)
-        construct_isosurfaces();
+    // isosurfaces, ECGs and streamlines are computed in the background for the frames the window shows,
+    // see MainWindow::start_background_analysis(). the worker needs the vertices of every time,
+    // a paged mesh interpolates them whenever a frame is loaded
+    for(Mesh* mesh : meshes) mesh->interpolate_vertices_for_all_t();
+
+    if(build_derived_fields)
+        for(Mesh* mesh : meshes) compute_derived_fields_for_all_t(mesh);
+
+    if(show_pathlines)
+        tracing_pathlines();
+
+    if(show_vortex_cores)
+        for(Mesh* mesh : meshes) extract_vortex_cores_for_all_t(mesh);
+
+    if(show_particle_cloud)
+        for(Mesh* mesh : meshes) mesh->particle_cloud = new ParticleCloud(mesh, num_cloud_particles);
 
-    if(build_ECG)
-        build_ECGs(meshes);
+    if(run_advection_benchmark)
+        for(Mesh* mesh : meshes) benchmark_advection(mesh);
 
-    if(show_streamlines)
-        tracing_streamlines();
+    if(run_vorticity_check)
+        for(Mesh* mesh : meshes) report_vorticity_error(mesh);
 
 
     MainWindow w;
     w.show();
+    w.start_background_analysis();
 
     return a.exec();
+#endif
 }
 
 
@@ -1,14 +1,24 @@
 #include "mainwindow.h"
 #include "Others/Utilities.h"
 #include "QtCore/qtimer.h"
+#include "Analysis/FTLE.h"
+#include "Lines/ParticleCloud.h"
+#include "FileLoader/ProductCache.h"
+#include <QProgressDialog>
+#include <QStatusBar>
+#include <QApplication>
 #include "ui_mainwindow.h"
 
+// the isovalue slider goes from 0 to iso_slider_resolution
+const int iso_slider_resolution = 1000;
+
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
+    this->ui->isoSlider->setValue(surface_level_ratio * iso_slider_resolution);
 
     this->total_time = this->model_time = 0.;
 
@@ -20,11 +30,32 @@ MainWindow::MainWindow(QWidget *parent)
     this->timer = new QTimer(this);
     connect(this->timer, SIGNAL(timeout()), this, SLOT(increment_time()));
     this->timer->start(time_step_size * MSECS_PER_SEC);
+
+    // a finished frame is published on this thread, the call is dropped if the window is gone by then
+    // a frame deleted to stay in the memory budget is dropped from the views
+    this->analysis = new AnalysisQueue([this](){
+        QMetaObject::invokeMethod(this, [this](){ this->publish_analysis(); }, Qt::QueuedConnection);
+    }, [this](Mesh* mesh, const double time){
+        this->ui->modelWindow->renderer->forget(mesh, time);
+        if(mesh->ECG_for_all_t.count(time) && this->ui->graphWindow->ecg == mesh->ECG_for_all_t.at(time))
+            this->update_ecg_for_graphWin(nullptr);
+    });
+    this->ui->modelWindow->analysis = this->analysis;
+
+    this->prefetch = new FramePrefetcher();
+    this->prefetch->start();
 }
 
 
 MainWindow::~MainWindow()
 {
+    // the worker reads the meshes, it has to stop before the model window deletes them
+    this->ui->modelWindow->analysis = NULL;
+    delete this->analysis;
+    this->analysis = NULL;
+    delete this->prefetch;
+    this->prefetch = NULL;
+
     delete ui;
 
     if(this->timer){
@@ -77,12 +108,51 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
             // reset the scene
             this->ui->modelWindow->reset_scene(); break;
         case Qt::Key_Space:
-            if(animation_on) this->timer->stop();
+            if(animation_on){
+                this->timer->stop();
+                this->prefetch->pause();
+            }
             else {
                 this->timer->start(time_step_size * MSECS_PER_SEC);
             }
             animation_on = !animation_on;
             break;
+        case Qt::Key_P:
+            // show or hide pathlines, they are traced the first time
+            show_pathlines = !show_pathlines;
+            if(show_pathlines && this->cur_mesh->pathlines.empty()) build_pathlines_from_seeds(this->cur_mesh);
+            this->ui->modelWindow->update();
+            break;
+        case Qt::Key_V:
+            // show or hide vortex core lines
+            show_vortex_cores = !show_vortex_cores;
+            this->ui->modelWindow->update();
+            break;
+        case Qt::Key_C:
+            // show or hide the animated particle cloud, it is seeded the first time
+            show_particle_cloud = !show_particle_cloud;
+            if(show_particle_cloud && this->cur_mesh->particle_cloud == NULL)
+                this->cur_mesh->particle_cloud = new ParticleCloud(this->cur_mesh, num_cloud_particles);
+            if(show_particle_cloud) this->cur_mesh->particle_cloud->request_time(this->model_time);
+            this->ui->modelWindow->update();
+            break;
+        case Qt::Key_M:
+            // show the datasets read on the same mesh next to each other, or only the current one
+            show_compare_view = !show_compare_view;
+            this->ui->modelWindow->update();
+            break;
+        case Qt::Key_L:
+            // FTLE of the current frame, cancelable from the progress dialog
+            this->compute_ftle_at_cur_time();
+            break;
+        case Qt::Key_F:
+            // switch to the next scalar field for isosurfaces, FTLE takes minutes so it is only picked by L
+            do{
+                isosurface_field = (ScalarFieldType) ((isosurface_field + 1) % NUM_SCALAR_FIELDS);
+            } while(isosurface_field == FIELD_FTLE);
+            qDebug() << "Isosurface field:" << scalar_field_name(isosurface_field);
+            this->ui->modelWindow->update();
+            break;
 
         default:
             return;
@@ -116,9 +186,55 @@ void MainWindow::increment_time( ) {
     // update time, then ecg
     this->update_time(this->model_time);
 
+    // the cloud advects in the background, the frame it finishes shows up on a later redraw
+    if(show_particle_cloud && this->cur_mesh->particle_cloud != NULL)
+        this->cur_mesh->particle_cloud->request_time(this->model_time);
+
+    // the graph shows nothing until the ECG of this frame is there
     if(this->cur_mesh->ECG_for_all_t.find(model_time) != this->cur_mesh->ECG_for_all_t.end())
         this->update_ecg_for_graphWin(this->cur_mesh->ECG_for_all_t.at(model_time));
+    else
+        this->update_ecg_for_graphWin(nullptr);
+
+    // ask for the new frame before it is drawn, so the worker starts on it and the ones after it at once
+    if(build_ECG) this->analysis->request(this->cur_mesh, PRODUCT_ECG, this->model_time);
+    if(show_streamlines && tracing_streamlines_from_seed)
+        this->analysis->request(this->cur_mesh, PRODUCT_STREAMLINES, this->model_time);
 
+    // paged field data is read ahead of the animation, this waits if the frame isn't there yet
+    this->prefetch->playing(this->cur_mesh, this->model_time, this->timer->interval() / (double) MSECS_PER_SEC);
+
+    this->redraw();
+}
+
+
+// products of earlier launches are loaded here, the frames that are missing are computed in the background
+// when the view first asks for them and show up once they are done. until then a frame is drawn without them
+void MainWindow::start_background_analysis()
+{
+    for(Mesh* mesh : meshes){
+        if(show_isosurfaces) load_cached_isosurfaces(mesh);
+        if(build_ECG) load_cached_ECGs(mesh);
+        if(show_streamlines && tracing_streamlines_from_seed) load_cached_streamlines(mesh);
+        this->analysis->track(mesh);
+    }
+    this->analysis->start();
+    this->redraw();
+}
+
+
+// move the finished frames into the meshes and redraw
+void MainWindow::publish_analysis()
+{
+    if(this->analysis->publish() == 0) return;
+
+    const UL queued = this->analysis->num_queued();
+    if(queued > 0) this->statusBar()->showMessage(QString("Computing %1 frames in the background, %2 MB in memory")
+                                                  .arg(queued).arg(this->analysis->num_resident_bytes() >> 20));
+    else this->statusBar()->clearMessage();
+
+    if(this->cur_mesh->ECG_for_all_t.find(model_time) != this->cur_mesh->ECG_for_all_t.end())
+        this->update_ecg_for_graphWin(this->cur_mesh->ECG_for_all_t.at(model_time));
     this->redraw();
 }
 
@@ -164,3 +280,69 @@ void MainWindow::on_showTetsWithFPs_triggered()
     this->redraw();
 }
 
+
+
+void MainWindow::on_showIsosurfaces_triggered()
+{
+    show_isosurfaces = !show_isosurfaces;
+    this->redraw();
+}
+
+
+// the slider changes surface_level_ratio, the isosurface of the displayed frame is
+// re-extracted from its span space on the next redraw
+void MainWindow::on_isoSlider_valueChanged(int value)
+{
+    surface_level_ratio = (double) value / iso_slider_resolution;
+    this->redraw();
+}
+
+
+// run FTLE for the current frame with a progress dialog and show its isosurface
+// the animation is paused while it runs
+void MainWindow::compute_ftle_at_cur_time()
+{
+    const bool was_animating = animation_on;
+    if(animation_on){
+        this->timer->stop();
+        this->prefetch->pause();
+        animation_on = false;
+    }
+
+    QProgressDialog dialog("Computing FTLE...", "Cancel", 0, 100, this);
+    dialog.setWindowModality(Qt::WindowModal);
+    dialog.setMinimumDuration(0);
+
+    const double time = this->model_time;
+    vector<double> ftle;
+    const bool done = compute_ftle(this->cur_mesh, default_ftle_params(time), ftle, nullptr, [&dialog](const double fraction){
+        dialog.setValue((int) (fraction * 100));
+        QApplication::processEvents();
+        return !dialog.wasCanceled();
+    });
+    dialog.setValue(100);
+
+    if(done){
+        // the worker may read the frame, it is published under the store lock
+        const FrameHandle frame = this->cur_mesh->field_store.pin(this->cur_mesh, time);
+        this->cur_mesh->field_store.set_vert_vals(this->cur_mesh, time, FIELD_FTLE, ftle);
+        // the span space and isosurface of this frame may hold an older FTLE run
+        if(this->cur_mesh->span_spaces_for_all_t.count(time) && this->cur_mesh->span_spaces_for_all_t.at(time)->field == FIELD_FTLE){
+            delete this->cur_mesh->span_spaces_for_all_t.at(time);
+            this->cur_mesh->span_spaces_for_all_t.erase(time);
+        }
+        if(this->cur_mesh->isosurfaces_for_all_t.count(time)){
+            delete this->cur_mesh->isosurfaces_for_all_t.at(time);
+            this->cur_mesh->isosurfaces_for_all_t.erase(time);
+        }
+        isosurface_field = FIELD_FTLE;
+        show_isosurfaces = true;
+        qDebug() << "Isosurface field:" << scalar_field_name(isosurface_field);
+    }
+
+    if(was_animating){
+        this->timer->start(time_step_size * MSECS_PER_SEC);
+        animation_on = true;
+    }
+    this->ui->modelWindow->update();
+}
@@ -2,6 +2,8 @@
 #define MAINWINDOW_H
 
 #include "Analysis/ECG.h"
+#include "Others/AnalysisQueue.h"
+#include "Others/FramePrefetcher.h"
 #include <QMainWindow>
 #include <QKeyEvent>
 
@@ -21,12 +23,17 @@ public:
     double total_time;
     double model_time;
     Mesh* cur_mesh;
+    AnalysisQueue* analysis; // computes the frames that weren't cached while the window is open
+    FramePrefetcher* prefetch; // reads the paged field frames ahead of the animation
 
     void update_time(const double time) const;
     void redraw() const;
     void update_ecg_for_graphWin(ECG* ) const;
     void update_mesh_for_modelWin(Mesh*) const;
     void switch_cur_mesh(Mesh *mesh);
+    void compute_ftle_at_cur_time();
+    void start_background_analysis();
+    void publish_analysis();
 
 
     void keyPressEvent(QKeyEvent *event) override;
@@ -43,5 +50,7 @@ private slots:
     void on_showAxis_triggered();
     void on_showBoundaryTriangles_triggered();
     void on_showTetsWithFPs_triggered();
+    void on_showIsosurfaces_triggered();
+    void on_isoSlider_valueChanged(int value);
 };
 #endif // MAINWINDOW_H
@@ -8,6 +8,8 @@
 #include "openglwindow.h"
 #include "Others/Utilities.h"
 #include "Others/Draw.h"
+#include "Others/Renderer.h"
+#include "Others/AnalysisQueue.h"
 #include "Geometry/Mesh.h"
 
 openGLWindow::openGLWindow(QWidget *parent) : QOpenGLWidget(parent)
@@ -20,6 +22,8 @@ openGLWindow::openGLWindow(QWidget *parent) : QOpenGLWidget(parent)
     this->trans_x = 0.;
     this->trans_y = 0.;
     this->cur_mesh = NULL;
+    this->renderer = new Renderer();
+    this->analysis = NULL;
 
     // init matrices
     Utility::mat_ident( this->rotmat );
@@ -37,6 +41,12 @@ openGLWindow::openGLWindow(QWidget *parent) : QOpenGLWidget(parent)
 
 openGLWindow::~openGLWindow()
 {
+    // the buffers of the renderer belong to the context
+    this->makeCurrent();
+    delete this->renderer;
+    this->renderer = NULL;
+    this->doneCurrent();
+
     for(Mesh* mesh : meshes){
         if(mesh != NULL)
             delete mesh;
@@ -51,6 +61,7 @@ openGLWindow::~openGLWindow()
 void openGLWindow::initializeGL()
 {
     this->initializeOpenGLFunctions();
+    this->renderer->init();
     if( meshes.size() == 0 ) return;
 
     this->cur_mesh = meshes[0];
@@ -107,34 +118,29 @@ void openGLWindow::paintGL()
     glClearColor (0.7, 0.7, 0.7, 1.0);  // grey background for rendering color coding and lighting
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    main_routine(this->cur_mesh);
-
-//    if(cur_mesh == meshes[1]){
-//        glPushMatrix();
-//        glTranslatef(-1.3, 0, 0);
-//        main_routine(meshes[0]);
-//        glPopMatrix();
-
-//        main_routine(meshes[1]);
-
-//        glPushMatrix();
-//        glTranslatef(1.3, 0, 0);
-//        main_routine(meshes[2]);
-//        glPopMatrix();
-//    }
-//    else{
-//        glPushMatrix();
-//        glTranslatef(-1.3, 0, 0);
-//        main_routine(meshes[3]);
-//        glPopMatrix();
-
-//        main_routine(meshes[4]);
+    // the compare view draws the datasets on the mesh of cur_mesh in the order they were read,
+    // each one 1.3 to the right of the one before
+    vector<Mesh*> group;
+    if(!show_compare_view) group.push_back(this->cur_mesh);
+    else{
+        for(Mesh* mesh : meshes){
+            if(mesh == this->cur_mesh || mesh->same_topology(this->cur_mesh)) group.push_back(mesh);
+        }
+    }
+    // every dataset drawn keeps its own prefetch window in the background analysis
+    if(this->analysis != NULL) this->analysis->focus_on(group);
 
-//        glPushMatrix();
-//        glTranslatef(1.3, 0, 0);
-//        main_routine(meshes[5]);
-//        glPopMatrix();
-//    }
+    if(!show_compare_view){
+        main_routine(this->cur_mesh);
+    }
+    else{
+        for(UL i = 0; i < group.size(); i++){
+            glPushMatrix();
+            glTranslatef((i - (group.size() - 1) / 2.) * 1.3, 0, 0);
+            main_routine(group[i]);
+            glPopMatrix();
+        }
+    }
 
     glMatrixMode(GL_MODELVIEW);
     glPopMatrix(); // pop 1st modelView matrix
@@ -146,15 +152,31 @@ void openGLWindow::paintGL()
 
 void openGLWindow::main_routine(Mesh * mesh) const
 {
+    this->renderer->release_forgotten();
+    // the field data drawn and the isosurface extracted below are read from this frame
+    const FrameHandle frame = mesh->field_store.pin(mesh, time);
+
+    // a product that isn't there yet is computed in the background and drawn once it is
+    if(this->analysis != NULL){
+        if(show_streamlines && tracing_streamlines_from_seed) this->analysis->request(mesh, PRODUCT_STREAMLINES, time);
+        if(show_isosurfaces) this->analysis->request(mesh, PRODUCT_ISOSURFACE, time);
+        if(build_ECG) this->analysis->request(mesh, PRODUCT_ECG, time);
+    }
+
     if(show_streamlines){
-        double max = DBL_MIN, min = DBL_MAX;
-        mesh->max_vel_mag(time, min, max);
-        if(mesh->streamlines_for_all_t.find(time) != mesh->streamlines_for_all_t.end() ){
-            const auto& sls = mesh->streamlines_for_all_t.at(time);
-            for(StreamLine* sl:sls){
-                draw_streamline(sl, min, max);
-            }
-        }
+        this->renderer->draw_streamlines(mesh, time, this->pixels_per_unit());
+    }
+
+    if(show_pathlines){
+        this->renderer->draw_pathlines(mesh, time);
+    }
+
+    if(show_particle_cloud && mesh->particle_cloud != NULL){
+        draw_particle_cloud(mesh->particle_cloud);
+    }
+
+    if(show_vortex_cores){
+        this->renderer->draw_vortex_cores(mesh, time);
     }
 
     if(show_axis){
@@ -162,41 +184,46 @@ void openGLWindow::main_routine(Mesh * mesh) const
     }
 
     if(show_isosurfaces){
-        double max = DBL_MIN, min = DBL_MAX;
-        const auto& isosurface = mesh->isosurfaces_for_all_t.at(time);
-        draw_isosurfaces(isosurface, min, max);
+        // re-extracts only the active tets if the isovalue slider has moved
+        const auto& isosurface = update_isosurface(mesh, time);
+        this->renderer->draw_isosurface(mesh, time, isosurface);
     }
 
     if(show_tets_with_fixedPts){
-        color_tets_with_fixedPts(mesh->tet_with_fixed_pt_for_all_t.at(this->time));
+        this->renderer->draw_tets_with_fixed_pts(mesh, this->time);
     }
 
 
     if(build_ECG && show_fixedPts){
-        draw_singularities(mesh->ECG_for_all_t.at(this->time)->get_sings());
+        this->renderer->draw_singularities(mesh, this->time);
     }
 
     if(build_ECG && show_ECG_edge_constructions){
-        vector<StreamLine*> sls = mesh->ECG_for_all_t.at(this->time)->sls;
-        for(StreamLine* sl : sls){
-            draw_streamline(sl, 1000, 1000);
-        }
+        this->renderer->draw_ecg_constructions(mesh, this->time);
     }
 
     if(build_ECG && show_ECG_connections){
-        draw_ECG_connections(mesh->ECG_for_all_t.at(this->time));
+        this->renderer->draw_ecg_connections(mesh, this->time);
     }
 
     if(show_boundary_wireframe)
-        draw_wireframe(mesh->boundary_tris);
+        this->renderer->draw_wireframe(mesh);
 
 
     if(show_opage_boundary_tris){
-        draw_opague_boundary_tris(boundary_tri_alpha, mesh->boundary_tris);
+        this->renderer->draw_boundary_tris(mesh, boundary_tri_alpha);
     }
 }
 
 
+// screen pixels per model unit for the current zoom, matches the glOrtho box set in paintGL
+double openGLWindow::pixels_per_unit() const
+{
+    const double x = this->width() / 3., y = this->height() / 2.;
+    return (x < y ? x : y) * this->zoom_factor;
+}
+
+
 void openGLWindow::set_scene() const
 {
     // translate the scene
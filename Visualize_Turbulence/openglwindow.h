@@ -9,6 +9,9 @@
 #include "Others/TraceBall.h"
 #include "Others/Vector3d.h"
 
+class Renderer;
+class AnalysisQueue;
+
 
 class openGLWindow : public QOpenGLWidget, public QOpenGLFunctions
 {
@@ -36,6 +39,8 @@ public:
     double trans_y;
     Vector3d rot_center;
     Mesh* cur_mesh;
+    Renderer* renderer; // layers uploaded to the GPU, see Others/Renderer.h
+    AnalysisQueue* analysis; // asked for the frames drawn, set by the MainWindow, may be NULL
 
 protected:
     void initializeGL() override;
@@ -46,6 +51,7 @@ protected:
 public:
     void redraw();
     void set_scene() const;
+    double pixels_per_unit() const;
     void set_mesh(Mesh*);
     void reset_scene();
 